@@ -1,6 +1,7 @@
 #pragma once
 #include "cbor.h"
 #include "sensor_header_msg.h"
+#include "sensor_stats_msg.h"
 
 // For the Aanderaa 5990 Conductivity Sensor
 
@@ -19,6 +20,18 @@ namespace AanderaaConductivityMsg {
         float depth_m;
     };
 
+    // Fields summarized by SensorStatsMsg::Accumulator
+    inline constexpr SensorStatsMsg::Field<Data> STATS_FIELDS[] = {
+        SENSOR_STATS_FIELD(Data, conductivity_ms_cm),
+        SENSOR_STATS_FIELD(Data, temperature_deg_c),
+        SENSOR_STATS_FIELD(Data, salinity_psu),
+        SENSOR_STATS_FIELD(Data, water_density_kg_m3),
+        SENSOR_STATS_FIELD(Data, sound_speed_m_s),
+        SENSOR_STATS_FIELD(Data, depth_m),
+    };
+    using StatsAccumulator =
+        SensorStatsMsg::Accumulator<Data, sizeof(STATS_FIELDS) / sizeof(STATS_FIELDS[0])>;
+
     CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
                      size_t *encoded_len);
 
@@ -0,0 +1,68 @@
+#include "aanderaa_current_meter_averager.h"
+#include <math.h>
+#include <string.h>
+
+namespace AanderaaCurrentMeterMsg {
+
+static constexpr double PI = 3.14159265358979323846;
+static constexpr double DEG_TO_RAD = PI / 180.0;
+static constexpr double RAD_TO_DEG = 180.0 / PI;
+
+// atan2 result in degrees, normalized to [0, 360)
+static double bearing_deg(double y, double x) {
+  double deg = atan2(y, x) * RAD_TO_DEG;
+  if (deg < 0.0) {
+    deg += 360.0;
+  }
+  return deg >= 360.0 ? 0.0 : deg;
+}
+
+void averager_reset(Averager &a) {
+  memset(&a, 0, sizeof(a));
+  a.max_tilt_deg = -INFINITY;
+}
+
+void averager_add(Averager &a, const Data &d) {
+  a.num_samples++;
+  a.last_header = d.header;
+  a.sum_north_cm_s += d.north_cm_s;
+  a.sum_east_cm_s += d.east_cm_s;
+  a.sum_heading_sin += sin(d.heading_deg_m * DEG_TO_RAD);
+  a.sum_heading_cos += cos(d.heading_deg_m * DEG_TO_RAD);
+  a.sum_tilt_x_deg += d.tilt_x_deg;
+  a.sum_tilt_y_deg += d.tilt_y_deg;
+  a.sum_single_ping_var += d.single_ping_std_cm_s * d.single_ping_std_cm_s;
+  a.sum_transducer_strength_db += d.transducer_strength_db;
+  a.sum_ping_count += d.ping_count;
+  a.sum_abs_tilt_deg += d.abs_tilt_deg;
+  a.max_tilt_deg = d.max_tilt_deg > a.max_tilt_deg ? d.max_tilt_deg : a.max_tilt_deg;
+  a.sum_std_tilt_var += d.std_tilt_deg * d.std_tilt_deg;
+  a.sum_temperature_deg_c += d.temperature_deg_c;
+}
+
+bool averager_result(const Averager &a, Data &d) {
+  if (a.num_samples == 0) {
+    return false;
+  }
+  const double n = a.num_samples;
+
+  d.header = a.last_header;
+  d.north_cm_s = a.sum_north_cm_s / n;
+  d.east_cm_s = a.sum_east_cm_s / n;
+  d.abs_speed_cm_s = hypot(d.north_cm_s, d.east_cm_s);
+  d.direction_deg_m = bearing_deg(d.east_cm_s, d.north_cm_s);
+  d.heading_deg_m = bearing_deg(a.sum_heading_sin, a.sum_heading_cos);
+  d.tilt_x_deg = a.sum_tilt_x_deg / n;
+  d.tilt_y_deg = a.sum_tilt_y_deg / n;
+  d.single_ping_std_cm_s = sqrt(a.sum_single_ping_var / n);
+  d.transducer_strength_db = a.sum_transducer_strength_db / n;
+  d.ping_count = a.sum_ping_count;
+  d.abs_tilt_deg = a.sum_abs_tilt_deg / n;
+  d.max_tilt_deg = a.max_tilt_deg;
+  d.std_tilt_deg = sqrt(a.sum_std_tilt_var / n);
+  d.temperature_deg_c = a.sum_temperature_deg_c / n;
+
+  return true;
+}
+
+} // namespace AanderaaCurrentMeterMsg
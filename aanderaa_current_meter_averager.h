@@ -0,0 +1,42 @@
+#pragma once
+#include "aanderaa_current_meter_msg.h"
+
+// Streaming ensemble averaging of Aanderaa current meter readings in O(1)
+// memory.
+//
+// Currents are averaged as vectors: north_cm_s and east_cm_s are averaged
+// in component space and abs_speed_cm_s/direction_deg_m are derived from
+// the mean vector. heading_deg_m uses the circular mean. Standard deviation
+// fields are pooled as the RMS of the per-reading values, max_tilt_deg keeps
+// the maximum, ping_count is summed and the remaining fields are averaged.
+// The result carries the header of the last reading added.
+
+namespace AanderaaCurrentMeterMsg {
+
+struct Averager {
+  uint32_t num_samples;
+  SensorHeaderMsg::Data last_header;
+  double sum_north_cm_s;
+  double sum_east_cm_s;
+  double sum_heading_sin;
+  double sum_heading_cos;
+  double sum_tilt_x_deg;
+  double sum_tilt_y_deg;
+  double sum_single_ping_var;
+  double sum_transducer_strength_db;
+  double sum_ping_count;
+  double sum_abs_tilt_deg;
+  double max_tilt_deg;
+  double sum_std_tilt_var;
+  double sum_temperature_deg_c;
+};
+
+void averager_reset(Averager &a);
+
+void averager_add(Averager &a, const Data &d);
+
+// Fills d with the ensemble average of the readings added since the last
+// reset. Returns false, leaving d untouched, if there are none.
+bool averager_result(const Averager &a, Data &d);
+
+} // namespace AanderaaCurrentMeterMsg
@@ -1,6 +1,24 @@
 #include "aanderaa_current_meter_msg.h"
 #include "bm_config.h"
 
+const BmTemplateField AanderaaCurrentMeterMsg::TEMPLATE_FIELDS[NUM_FIELDS] = {
+    SENSOR_HEADER_FIELD_OFFSETS(Data),
+    {"abs_speed_cm_s", BM_FIELD_DOUBLE, offsetof(Data, abs_speed_cm_s)},
+    {"direction_deg_m", BM_FIELD_DOUBLE, offsetof(Data, direction_deg_m)},
+    {"north_cm_s", BM_FIELD_DOUBLE, offsetof(Data, north_cm_s)},
+    {"east_cm_s", BM_FIELD_DOUBLE, offsetof(Data, east_cm_s)},
+    {"heading_deg_m", BM_FIELD_DOUBLE, offsetof(Data, heading_deg_m)},
+    {"tilt_x_deg", BM_FIELD_DOUBLE, offsetof(Data, tilt_x_deg)},
+    {"tilt_y_deg", BM_FIELD_DOUBLE, offsetof(Data, tilt_y_deg)},
+    {"single_ping_std_cm_s", BM_FIELD_DOUBLE, offsetof(Data, single_ping_std_cm_s)},
+    {"transducer_strength_db", BM_FIELD_DOUBLE, offsetof(Data, transducer_strength_db)},
+    {"ping_count", BM_FIELD_DOUBLE, offsetof(Data, ping_count)},
+    {"abs_tilt_deg", BM_FIELD_DOUBLE, offsetof(Data, abs_tilt_deg)},
+    {"max_tilt_deg", BM_FIELD_DOUBLE, offsetof(Data, max_tilt_deg)},
+    {"std_tilt_deg", BM_FIELD_DOUBLE, offsetof(Data, std_tilt_deg)},
+    {"temperature_deg_c", BM_FIELD_DOUBLE, offsetof(Data, temperature_deg_c)},
+};
+
 CborError AanderaaCurrentMeterMsg::encode(Data &d, uint8_t *cbor_buffer, size_t size,
                                   size_t *encoded_len) {
   CborError err;
@@ -1,5 +1,6 @@
 #pragma once
 #include "cbor.h"
+#include "bm_template_encoder.h"
 #include "sensor_header_msg.h"
 
 namespace AanderaaCurrentMeterMsg {
@@ -25,6 +26,9 @@ struct Data {
   double temperature_deg_c;
 };
 
+// Field table for bm_template_encoder, in encode order.
+extern const BmTemplateField TEMPLATE_FIELDS[NUM_FIELDS];
+
 CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
                  size_t *encoded_len);
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "cbor.h"
 #include "sensor_header_msg.h"
+#include "sensor_stats_msg.h"
 
 namespace BarometricPressureDataMsg
 {
@@ -14,6 +15,13 @@ namespace BarometricPressureDataMsg
     double barometric_pressure_mbar;
   };
 
+  // Fields summarized by SensorStatsMsg::Accumulator
+  inline constexpr SensorStatsMsg::Field<Data> STATS_FIELDS[] = {
+      SENSOR_STATS_FIELD(Data, barometric_pressure_mbar),
+  };
+  using StatsAccumulator =
+      SensorStatsMsg::Accumulator<Data, sizeof(STATS_FIELDS) / sizeof(STATS_FIELDS[0])>;
+
   CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
                    size_t *encoded_len);
 
@@ -0,0 +1,301 @@
+#include "bm_base64.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+static const char encode_table[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 0xff marks characters outside the alphabet
+static const uint8_t decode_table[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+#if defined(__SSSE3__)
+/*
+ * SIMD kernels after W. Mula and D. Lemire, "Faster Base64 Encoding and
+ * Decoding Using AVX2 Instructions" (2018). Each 32 bit lane holds one
+ * group of 3 bytes / 4 characters.
+ */
+
+// 12 bytes in the low bytes of each 16 byte lane -> 16 6-bit indices
+static inline __m128i enc_reshuffle(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4,
+                                         1, 2, 0, 1));
+  const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+// 6-bit indices -> ASCII
+static inline __m128i enc_translate(__m128i in) {
+  const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4,
+                                    -4, -19, -16, 0, 0);
+  __m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+  const __m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+  indices = _mm_sub_epi8(indices, mask);
+  return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+// ASCII -> 6-bit values, false if any byte is outside the alphabet
+static inline bool dec_translate(__m128i *str) {
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b,
+                                       0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04,
+                                       0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                       0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0,
+                                         0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+  const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(*str, 4), mask_2f);
+  const __m128i lo_nibbles = _mm_and_si128(*str, mask_2f);
+  const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+  const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+  const __m128i invalid = _mm_and_si128(lo, hi);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xffff) {
+    return false;
+  }
+  const __m128i eq_2f = _mm_cmpeq_epi8(*str, mask_2f);
+  const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+  *str = _mm_add_epi8(*str, roll);
+  return true;
+}
+
+// 16 6-bit values -> 12 bytes in the low bytes of the lane
+static inline __m128i dec_reshuffle(__m128i in) {
+  const __m128i merge_ab_and_bc =
+      _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+  const __m128i out = _mm_madd_epi16(merge_ab_and_bc, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13,
+                                             12, -1, -1, -1, -1));
+}
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i enc_reshuffle_256(__m256i in) {
+  in = _mm256_shuffle_epi8(
+      in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 10,
+                          11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+  const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+  const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+  const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(t1, t3);
+}
+
+static inline __m256i enc_translate_256(__m256i in) {
+  const __m256i lut = _mm256_setr_epi8(
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0, 65, 71,
+      -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  __m256i indices = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+  const __m256i mask = _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25));
+  indices = _mm256_sub_epi8(indices, mask);
+  return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, indices));
+}
+
+static inline bool dec_translate_256(__m256i *str) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a,
+      0x1b, 0x1b, 0x1b, 0x1a, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4,
+      -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+  const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(*str, 4), mask_2f);
+  const __m256i lo_nibbles = _mm256_and_si256(*str, mask_2f);
+  const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+  const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+  if (!_mm256_testz_si256(lo, hi)) {
+    return false;
+  }
+  const __m256i eq_2f = _mm256_cmpeq_epi8(*str, mask_2f);
+  const __m256i roll =
+      _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+  *str = _mm256_add_epi8(*str, roll);
+  return true;
+}
+
+static inline __m256i dec_reshuffle_256(__m256i in) {
+  const __m256i merge_ab_and_bc =
+      _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+  __m256i out = _mm256_madd_epi16(merge_ab_and_bc, _mm256_set1_epi32(0x00011000));
+  out = _mm256_shuffle_epi8(
+      out, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+                            -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                            -1, -1));
+  // pack the two 12 byte lanes into the low 24 bytes
+  return _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+#endif
+
+size_t bm_base64_encode(const uint8_t *src, size_t len, char *dst) {
+  char *const start = dst;
+
+#if defined(__AVX2__)
+  // loads 16 bytes at src and at src + 12, consumes 24
+  while (len >= 28) {
+    __m256i in = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+        _mm_loadu_si128((const __m128i *)(src + 12)), 1);
+    in = enc_translate_256(enc_reshuffle_256(in));
+    _mm256_storeu_si256((__m256i *)dst, in);
+    src += 24;
+    len -= 24;
+    dst += 32;
+  }
+#endif
+#if defined(__SSSE3__)
+  // loads 16 bytes, consumes 12
+  while (len >= 16) {
+    __m128i in = _mm_loadu_si128((const __m128i *)src);
+    in = enc_translate(enc_reshuffle(in));
+    _mm_storeu_si128((__m128i *)dst, in);
+    src += 12;
+    len -= 12;
+    dst += 16;
+  }
+#endif
+
+  while (len >= 3) {
+    const uint32_t v = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+    dst[0] = encode_table[(v >> 18) & 0x3f];
+    dst[1] = encode_table[(v >> 12) & 0x3f];
+    dst[2] = encode_table[(v >> 6) & 0x3f];
+    dst[3] = encode_table[v & 0x3f];
+    src += 3;
+    len -= 3;
+    dst += 4;
+  }
+
+  if (len) {
+    const uint32_t v = ((uint32_t)src[0] << 16) | (len == 2 ? (uint32_t)src[1] << 8 : 0);
+    dst[0] = encode_table[(v >> 18) & 0x3f];
+    dst[1] = encode_table[(v >> 12) & 0x3f];
+    dst[2] = len == 2 ? encode_table[(v >> 6) & 0x3f] : '=';
+    dst[3] = '=';
+    dst += 4;
+  }
+
+  return (size_t)(dst - start);
+}
+
+size_t bm_base64_decoded_len(const char *src, size_t len) {
+  if (len % 4 == 0 && len >= 4 && src[len - 1] == '=') {
+    len -= src[len - 2] == '=' ? 2 : 1;
+  }
+  return (len / 4) * 3 + (len % 4 ? len % 4 - 1 : 0);
+}
+
+bool bm_base64_decode(const char *src, size_t len, uint8_t *dst,
+                      size_t *out_len) {
+  const uint8_t *in = (const uint8_t *)src;
+  uint8_t *const start = dst;
+
+  *out_len = 0;
+
+  // strip padding, then split into full quads and a 2 or 3 character tail
+  if (len % 4 == 0 && len >= 4 && in[len - 1] == '=') {
+    len -= in[len - 2] == '=' ? 2 : 1;
+  }
+  if (len % 4 == 1) {
+    return false;
+  }
+  const size_t tail = len % 4;
+  size_t quads = len / 4;
+
+#if defined(__AVX2__)
+  // loads 32 characters, stores 24 bytes
+  while (quads >= 8) {
+    __m256i str = _mm256_loadu_si256((const __m256i *)in);
+    if (!dec_translate_256(&str)) {
+      return false;
+    }
+    str = dec_reshuffle_256(str);
+    _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(str));
+    _mm_storel_epi64((__m128i *)(dst + 16), _mm256_extracti128_si256(str, 1));
+    in += 32;
+    dst += 24;
+    quads -= 8;
+  }
+#endif
+#if defined(__SSSE3__)
+  // loads 16 characters, stores 12 bytes
+  while (quads >= 4) {
+    __m128i str = _mm_loadu_si128((const __m128i *)in);
+    if (!dec_translate(&str)) {
+      return false;
+    }
+    str = dec_reshuffle(str);
+    _mm_storel_epi64((__m128i *)dst, str);
+    const uint32_t last = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(str, 8));
+    dst[8] = (uint8_t)last;
+    dst[9] = (uint8_t)(last >> 8);
+    dst[10] = (uint8_t)(last >> 16);
+    dst[11] = (uint8_t)(last >> 24);
+    in += 16;
+    dst += 12;
+    quads -= 4;
+  }
+#endif
+
+  while (quads--) {
+    const uint8_t a = decode_table[in[0]];
+    const uint8_t b = decode_table[in[1]];
+    const uint8_t c = decode_table[in[2]];
+    const uint8_t d = decode_table[in[3]];
+    if ((a | b | c | d) & 0x80) {
+      return false;
+    }
+    const uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+    dst[0] = (uint8_t)(v >> 16);
+    dst[1] = (uint8_t)(v >> 8);
+    dst[2] = (uint8_t)v;
+    in += 4;
+    dst += 3;
+  }
+
+  if (tail) {
+    const uint8_t a = decode_table[in[0]];
+    const uint8_t b = decode_table[in[1]];
+    const uint8_t c = tail == 3 ? decode_table[in[2]] : 0;
+    if ((a | b | c) & 0x80) {
+      return false;
+    }
+    const uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+    *dst++ = (uint8_t)(v >> 16);
+    if (tail == 3) {
+      *dst++ = (uint8_t)(v >> 8);
+    }
+  }
+
+  *out_len = (size_t)(dst - start);
+  return true;
+}
@@ -0,0 +1,42 @@
+#ifndef __BM_BASE64_H__
+#define __BM_BASE64_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Standard base64 (RFC 4648, '+' and '/', '=' padding).
+//
+// Built with AVX2 or SSSE3 enabled (e.g. -mavx2 on the gateway) the bulk of
+// the input is processed 24/12 bytes at a time with SIMD; otherwise, as on
+// the MCUs, a table-driven scalar loop is used. Both produce identical
+// output and accept exactly the same inputs.
+
+#define bm_base64_encoded_len(n) ((((n) + 2) / 3) * 4)
+#define bm_base64_decoded_max_len(n) ((((n) + 3) / 4) * 3)
+
+// Encodes len bytes of src into dst, which must hold
+// bm_base64_encoded_len(len) characters. No terminator is written.
+// Returns the number of characters written.
+size_t bm_base64_encode(const uint8_t *src, size_t len, char *dst);
+
+// Exact number of bytes bm_base64_decode produces for well formed input.
+size_t bm_base64_decoded_len(const char *src, size_t len);
+
+// Decodes len characters of src into dst, which must hold
+// bm_base64_decoded_len(src, len) bytes (at most
+// bm_base64_decoded_max_len(len)); nothing is written past them. Padding is optional, but only
+// allowed at the end. Returns false on any invalid input, including
+// whitespace. *out_len receives the number of bytes written.
+bool bm_base64_decode(const char *src, size_t len, uint8_t *dst,
+                      size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,6 +31,71 @@ static CborError create_map_and_send_header(CborEncoder * encoder, CborEncoder *
     return err;
 }
 
+/* payloads from binary_version on carry raw bytes, earlier ones base64 text */
+static CborError encode_payload(CborEncoder * map_encoder, const char * key, uint32_t version, uint32_t binary_version, const char * text, const uint8_t * bytes, size_t len) {
+    if (version >= binary_version)
+        return encode_key_value_bytes(map_encoder, key, bytes, len);
+    return encode_key_value_string(map_encoder, key, text, len);
+}
+
+/* where a decoded payload ends up: a fresh allocation, the caller's buffer as
+   sent, or the caller's buffer as raw bytes with base64 text decoded in place */
+enum payload_sink_kind {
+    PAYLOAD_ALLOCATE,
+    PAYLOAD_INTO,
+    PAYLOAD_BINARY,
+};
+
+struct payload_sink {
+    enum payload_sink_kind kind;
+    void * buffer;
+    size_t capacity;
+};
+
+static CborError decode_payload(const struct payload_sink * sink, char ** text, uint8_t ** bytes, size_t * len, CborValue * value, const char * key, uint32_t version, uint32_t binary_version) {
+    switch (sink->kind) {
+    case PAYLOAD_ALLOCATE:
+        if (version >= binary_version)
+            return decode_key_value_bytes(bytes, len, value, key);
+        return decode_key_value_string(text, len, value, key);
+    case PAYLOAD_INTO:
+        *len = sink->capacity;
+        if (version >= binary_version) {
+            *bytes = (uint8_t *)sink->buffer;
+            return decode_key_value_bytes_into(*bytes, len, value, key);
+        }
+        *text = (char *)sink->buffer;
+        return decode_key_value_string_into(*text, len, value, key);
+    case PAYLOAD_BINARY:
+    default:
+        *len = sink->capacity;
+        *bytes = (uint8_t *)sink->buffer;
+        return decode_key_value_base64(*bytes, len, value, key);
+    }
+}
+
+static CborError decode_text(const struct payload_sink * sink, char ** text, size_t * len, CborValue * value, const char * key) {
+    if (sink->kind == PAYLOAD_ALLOCATE)
+        return decode_key_value_string(text, len, value, key);
+    *len = sink->capacity;
+    *text = (char *)sink->buffer;
+    return decode_key_value_string_into(*text, len, value, key);
+}
+
+static void free_payload(const struct payload_sink * sink, char ** text, uint8_t ** bytes) {
+    if (sink->kind == PAYLOAD_ALLOCATE) {
+#ifndef CI_TEST
+        bm_free(*text);
+        bm_free(*bytes);
+#else
+        free(*text);
+        free(*bytes);
+#endif
+    }
+    *text = NULL;
+    *bytes = NULL;
+}
+
 CborError borealis_spectrum_data_encode(struct borealis_spectrum_data * d, uint8_t * cbor_buffer, size_t size, size_t * encoded_len) {
     CborError err;
     CborEncoder encoder, map_encoder;
@@ -41,7 +106,7 @@ CborError borealis_spectrum_data_encode(struct borealis_spectrum_data * d, uint8
         if ((err = encode_key_value_float(&map_encoder, "dt", d->dt)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_float(&map_encoder, "df", d->df)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_uint8(&map_encoder, "bands_per_octave", d->bands_per_octave)) != CborNoError && err != CborErrorOutOfMemory) break;
-        if ((err = encode_key_value_string(&map_encoder, "spectrum", d->spectrum_as_base64, d->spectrum_length)) != CborNoError && err != CborErrorOutOfMemory) break;
+        if ((err = encode_payload(&map_encoder, "spectrum", d->header.version, BOREALIS_SPECTRUM_MSG_VERSION_BINARY, d->spectrum_as_base64, d->spectrum, d->spectrum_length)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encoder_message_finish(&encoder, &map_encoder)) != CborNoError && err != CborErrorOutOfMemory) break;
 
         if (err != CborNoError) break;
@@ -65,7 +130,7 @@ CborError borealis_levels_encode(struct borealis_levels * d, uint8_t * cbor_buff
         if ((err = create_map_and_send_header(&encoder, &map_encoder, d->header, BOREALIS_LEVELS_MSG_NUM_FIELDS)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_float(&map_encoder, "dt", d->dt)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_uint8(&map_encoder, "first_band_index", d->first_band_index)) != CborNoError && err != CborErrorOutOfMemory) break;
-        if ((err = encode_key_value_string(&map_encoder, "levels", d->levels, d->levels_length)) != CborNoError && err != CborErrorOutOfMemory) break;
+        if ((err = encode_payload(&map_encoder, "levels", d->header.version, BOREALIS_LEVELS_MSG_VERSION_BINARY, d->levels, d->level_data, d->levels_length)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encoder_message_finish(&encoder, &map_encoder)) != CborNoError && err != CborErrorOutOfMemory) break;
 
         if (err != CborNoError) break;
@@ -90,7 +155,7 @@ CborError borealis_levels_statistics_encode(struct borealis_level_statistics * d
         if ((err = encode_key_value_float(&map_encoder, "dt", d->dt)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_float(&map_encoder, "dt_report", d->dt_report)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_uint8(&map_encoder, "first_band_index", d->first_band_index)) != CborNoError && err != CborErrorOutOfMemory) break;
-        if ((err = encode_key_value_string(&map_encoder, "levels", d->levels, d->levels_length)) != CborNoError && err != CborErrorOutOfMemory) break;
+        if ((err = encode_payload(&map_encoder, "levels", d->header.version, BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY, d->levels, d->level_data, d->levels_length)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encode_key_value_float(&map_encoder, "max_iqr", d->max_iqr)) != CborNoError && err != CborErrorOutOfMemory) break;
         if ((err = encoder_message_finish(&encoder, &map_encoder)) != CborNoError && err != CborErrorOutOfMemory) break;
 
@@ -131,79 +196,63 @@ CborError borealis_recording_status_encode(struct borealis_recording_status * d,
     return err;
 }
 
-CborError borealis_spectrum_data_decode(struct borealis_spectrum_data * d, uint8_t *cbor_buffer, size_t size) {
+static CborError spectrum_data_decode(struct borealis_spectrum_data * d, const struct payload_sink * sink, uint8_t * cbor_buffer, size_t size) {
     CborValue map;
     CborParser parser;
     CborValue value;
 
     d->spectrum_as_base64 = NULL;
+    d->spectrum = NULL;
 
     CborError err;
     do {
-        err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_SPECTRUM_MSG_NUM_FIELDS);
+        if ((err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_SPECTRUM_MSG_NUM_FIELDS)) != CborNoError) break;
 
         if ((err = SensorHeaderMsg::decode(value, d->header)) != CborNoError) break;
 
         if (CborNoError != (err = decode_key_value_float(&d->dt, &value, "dt"))) break;
         if (CborNoError != (err = decode_key_value_float(&d->df, &value, "df"))) break;
         if (CborNoError != (err = decode_key_value_uint8(&d->bands_per_octave, &value, "bands_per_octave"))) break;
-        if (CborNoError != (err = decode_key_value_string(&d->spectrum_as_base64, &d->spectrum_length, &value, "spectrum"))) break;
+        if (CborNoError != (err = decode_payload(sink, &d->spectrum_as_base64, &d->spectrum, &d->spectrum_length, &value, "spectrum", d->header.version, BOREALIS_SPECTRUM_MSG_VERSION_BINARY))) break;
 
-        if (err != CborNoError) break;
-
-        err = decoder_message_leave(&value, &map);
-
-        return err;
+        return decoder_message_leave(&value, &map);
     } while (0);
 
     /* we get here only on error. free the allocation if there was one */
-#ifndef CI_TEST
-    bm_free(d->spectrum_as_base64);
-#else
-    free(d->spectrum_as_base64);
-#endif
-    d->spectrum_as_base64 = NULL;
+    free_payload(sink, &d->spectrum_as_base64, &d->spectrum);
 
     return err;
 }
 
-CborError borealis_levels_decode(struct borealis_levels * d, uint8_t *cbor_buffer, size_t size) {
+static CborError levels_decode(struct borealis_levels * d, const struct payload_sink * sink, uint8_t * cbor_buffer, size_t size) {
     CborValue map;
     CborParser parser;
     CborValue value;
 
     d->levels = NULL;
+    d->level_data = NULL;
 
     CborError err;
     do {
-        err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_LEVELS_MSG_NUM_FIELDS);
+        if ((err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_LEVELS_MSG_NUM_FIELDS)) != CborNoError) break;
 
         // header
         if ((err = SensorHeaderMsg::decode(value, d->header)) != CborNoError) break;
 
         if (CborNoError != (err = decode_key_value_float(&d->dt, &value, "dt"))) break;
         if (CborNoError != (err = decode_key_value_uint8(&d->first_band_index, &value, "first_band_index"))) break;
-        if (CborNoError != (err = decode_key_value_string(&d->levels, &d->levels_length, &value, "levels"))) break;
+        if (CborNoError != (err = decode_payload(sink, &d->levels, &d->level_data, &d->levels_length, &value, "levels", d->header.version, BOREALIS_LEVELS_MSG_VERSION_BINARY))) break;
 
-        if (err != CborNoError) break;
-
-        err = decoder_message_leave(&value, &map);
-
-        return err;
+        return decoder_message_leave(&value, &map);
     } while (0);
 
     /* we get here only on error. free the allocation if there was one */
-#ifndef CI_TEST
-    bm_free(d->levels);
-#else
-    free(d->levels);
-#endif
-    d->levels = NULL;
+    free_payload(sink, &d->levels, &d->level_data);
 
     return err;
 }
 
-CborError borealis_recording_status_decode(struct borealis_recording_status * d, uint8_t *cbor_buffer, size_t size) {
+static CborError recording_status_decode(struct borealis_recording_status * d, const struct payload_sink * sink, uint8_t * cbor_buffer, size_t size) {
     CborValue map;
     CborParser parser;
     CborValue value;
@@ -212,43 +261,36 @@ CborError borealis_recording_status_decode(struct borealis_recording_status * d,
 
     CborError err;
     do {
-        err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_RECORDING_STATUS_MSG_NUM_FIELDS);
+        if ((err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_RECORDING_STATUS_MSG_NUM_FIELDS)) != CborNoError) break;
 
         if ((err = SensorHeaderMsg::decode(value, d->header)) != CborNoError) break;
 
         if (CborNoError != (err = decode_key_value_uint8(&d->flags, &value, "flags"))) break;
-        if (CborNoError != (err = decode_key_value_string(&d->filename, &d->filename_length, &value, "filename"))) break;
+        if (CborNoError != (err = decode_text(sink, &d->filename, &d->filename_length, &value, "filename"))) break;
         if (CborNoError != (err = decode_key_value_float(&d->seconds_written, &value, "seconds_written"))) break;
         if (CborNoError != (err = decode_key_value_float(&d->seconds_free, &value, "seconds_free"))) break;
 
-        if (err != CborNoError) break;
-
-        err = decoder_message_leave(&value, &map);
-
-        return err;
+        return decoder_message_leave(&value, &map);
     } while (0);
 
     /* we get here only on error. free the allocation if there was one */
-#ifndef CI_TEST
-    bm_free(d->filename);
-#else
-    free(d->filename);
-#endif
-    d->filename = NULL;
+    uint8_t * no_bytes = NULL;
+    free_payload(sink, &d->filename, &no_bytes);
 
     return err;
 }
 
-CborError borealis_levels_statistics_decode(struct borealis_level_statistics * d, uint8_t * cbor_buffer, size_t size) {
+static CborError levels_statistics_decode(struct borealis_level_statistics * d, const struct payload_sink * sink, uint8_t * cbor_buffer, size_t size) {
     CborValue map;
     CborParser parser;
     CborValue value;
 
     d->levels = NULL;
+    d->level_data = NULL;
 
     CborError err;
     do {
-        err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_LEVEL_STATISTICS_MSG_NUM_FIELDS);
+        if ((err = decoder_message_enter(&map, &value, &parser, cbor_buffer, size, BOREALIS_LEVEL_STATISTICS_MSG_NUM_FIELDS)) != CborNoError) break;
 
         // header
         if ((err = SensorHeaderMsg::decode(value, d->header)) != CborNoError) break;
@@ -256,23 +298,69 @@ CborError borealis_levels_statistics_decode(struct borealis_level_statistics * d
         if (CborNoError != (err = decode_key_value_float(&d->dt, &value, "dt"))) break;
         if (CborNoError != (err = decode_key_value_float(&d->dt_report, &value, "dt_report"))) break;
         if (CborNoError != (err = decode_key_value_uint8(&d->first_band_index, &value, "first_band_index"))) break;
-        if (CborNoError != (err = decode_key_value_string(&d->levels, &d->levels_length, &value, "levels"))) break;
+        if (CborNoError != (err = decode_payload(sink, &d->levels, &d->level_data, &d->levels_length, &value, "levels", d->header.version, BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY))) break;
         if (CborNoError != (err = decode_key_value_float(&d->max_iqr, &value, "max_iqr"))) break;
 
-        if (err != CborNoError) break;
-
-        err = decoder_message_leave(&value, &map);
-
-        return err;
+        return decoder_message_leave(&value, &map);
     } while (0);
 
     /* we get here only on error. free the allocation if there was one */
-#ifndef CI_TEST
-    bm_free(d->levels);
-#else
-    free(d->levels);
-#endif
-    d->levels = NULL;
+    free_payload(sink, &d->levels, &d->level_data);
 
     return err;
 }
+
+CborError borealis_spectrum_data_decode(struct borealis_spectrum_data * d, uint8_t *cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_ALLOCATE, NULL, 0};
+    return spectrum_data_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_levels_decode(struct borealis_levels * d, uint8_t *cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_ALLOCATE, NULL, 0};
+    return levels_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_recording_status_decode(struct borealis_recording_status * d, uint8_t *cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_ALLOCATE, NULL, 0};
+    return recording_status_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_levels_statistics_decode(struct borealis_level_statistics * d, uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_ALLOCATE, NULL, 0};
+    return levels_statistics_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_spectrum_data_decode_binary(struct borealis_spectrum_data * d, uint8_t * spectrum, size_t capacity, const uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_BINARY, spectrum, capacity};
+    return spectrum_data_decode(d, &sink, (uint8_t *)cbor_buffer, size);
+}
+
+CborError borealis_levels_decode_binary(struct borealis_levels * d, uint8_t * levels, size_t capacity, const uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_BINARY, levels, capacity};
+    return levels_decode(d, &sink, (uint8_t *)cbor_buffer, size);
+}
+
+CborError borealis_levels_statistics_decode_binary(struct borealis_level_statistics * d, uint8_t * levels, size_t capacity, const uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_BINARY, levels, capacity};
+    return levels_statistics_decode(d, &sink, (uint8_t *)cbor_buffer, size);
+}
+
+CborError borealis_spectrum_data_decode_into(struct borealis_spectrum_data * d, void * buffer, size_t capacity, uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_INTO, buffer, capacity};
+    return spectrum_data_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_levels_decode_into(struct borealis_levels * d, void * buffer, size_t capacity, uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_INTO, buffer, capacity};
+    return levels_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_recording_status_decode_into(struct borealis_recording_status * d, char * filename, size_t capacity, uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_INTO, filename, capacity};
+    return recording_status_decode(d, &sink, cbor_buffer, size);
+}
+
+CborError borealis_levels_statistics_decode_into(struct borealis_level_statistics * d, void * buffer, size_t capacity, uint8_t * cbor_buffer, size_t size) {
+    const struct payload_sink sink = {PAYLOAD_INTO, buffer, capacity};
+    return levels_statistics_decode(d, &sink, cbor_buffer, size);
+}
@@ -7,7 +7,14 @@
 // For Applied Ocean Sciences Acoustic Recorder: BOREALIS
 // Bristlemouth Open Recorder & Edge-processor Acoustic Low-power Information System
 
+// *_MSG_VERSION messages carry the spectrum/levels payload as base64 text in
+// a CBOR text string, from the char * field. *_MSG_VERSION_BINARY messages
+// carry the raw bytes as a CBOR byte string, from the separate uint8_t *
+// field. Encoders pick the wire format and the field from header.version;
+// decoders accept both, fill the field matching the version received and
+// set the other to NULL.
 #define BOREALIS_SPECTRUM_MSG_VERSION 1
+#define BOREALIS_SPECTRUM_MSG_VERSION_BINARY 2
 #define BOREALIS_SPECTRUM_MSG_NUM_FIELDS (4 + SensorHeaderMsg::NUM_FIELDS)
 
 /* hopefully temporary c-accessible shim for things defined in a vestigial c++ namespaced struct */
@@ -45,11 +52,13 @@ struct borealis_spectrum_data {
   uint8_t bands_per_octave;
   //on the encode side this points into a line buffer and is the given length, and is not null terminated
   //on the decode side, this will be bm_malloc'd inside the decode function and must be bm_freed by the caller
-  char *spectrum_as_base64;
-  size_t spectrum_length; //this does not get tx'd as its own cbor field
+  char *spectrum_as_base64; // BOREALIS_SPECTRUM_MSG_VERSION
+  uint8_t *spectrum;        // BOREALIS_SPECTRUM_MSG_VERSION_BINARY, raw bytes
+  size_t spectrum_length; //length of the field in use, this does not get tx'd as its own cbor field
 };
 
 #define BOREALIS_LEVELS_MSG_VERSION 1
+#define BOREALIS_LEVELS_MSG_VERSION_BINARY 2
 #define BOREALIS_LEVELS_MSG_NUM_FIELDS (3 + SensorHeaderMsg::NUM_FIELDS)
 
 struct borealis_levels {
@@ -62,8 +71,9 @@ struct borealis_levels {
   uint8_t first_band_index;
   //on the encode side this points into a line buffer and is the given length, and is not null terminated
   //on the decode side, this will be bm_malloc'd inside the decode function and must be bm_freed by the caller
-  char *levels;
-  size_t levels_length; //this does not get tx'd as its own cbor field
+  char *levels;        // BOREALIS_LEVELS_MSG_VERSION, base64 text
+  uint8_t *level_data; // BOREALIS_LEVELS_MSG_VERSION_BINARY, raw bytes
+  size_t levels_length; //length of the field in use, this does not get tx'd as its own cbor field
 };
 
 #define BOREALIS_RECORDING_STATUS_MSG_VERSION 1
@@ -85,6 +95,7 @@ struct borealis_recording_status {
 };
 
 #define BOREALIS_LEVEL_STATISTICS_MSG_VERSION 1
+#define BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY 2
 #define BOREALIS_LEVEL_STATISTICS_MSG_NUM_FIELDS                               \
   (5 + SensorHeaderMsg::NUM_FIELDS)
 
@@ -97,7 +108,8 @@ struct borealis_level_statistics {
   float dt;
   float dt_report;
   uint8_t first_band_index;
-  char *levels;
+  char *levels;        // BOREALIS_LEVEL_STATISTICS_MSG_VERSION, base64 text
+  uint8_t *level_data; // BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY, raw bytes
   size_t levels_length;
   float max_iqr;
 };
@@ -129,6 +141,48 @@ CborError borealis_levels_statistics_encode(struct borealis_level_statistics *d,
 CborError borealis_levels_statistics_decode(struct borealis_level_statistics *d,
                                             uint8_t *cbor_buffer, size_t size);
 
+/*
+ * Same as the decode functions above, but the string field is written to a
+ * caller buffer of the given capacity instead of being bm_malloc'd, so a
+ * receiver can reuse one buffer for every message. Base64 text and
+ * filenames are zero terminated and need one byte more than their length.
+ * On success the pointer field matching the version received refers to
+ * buffer and the length field holds the length; on CborErrorOutOfMemory
+ * the length field holds the capacity required. Nothing needs to be freed.
+ */
+CborError borealis_spectrum_data_decode_into(struct borealis_spectrum_data *d,
+                                             void *buffer, size_t capacity,
+                                             uint8_t *cbor_buffer, size_t size);
+CborError borealis_levels_decode_into(struct borealis_levels *d, void *buffer,
+                                      size_t capacity, uint8_t *cbor_buffer,
+                                      size_t size);
+CborError borealis_recording_status_decode_into(struct borealis_recording_status *d,
+                                                char *filename, size_t capacity,
+                                                uint8_t *cbor_buffer, size_t size);
+CborError borealis_levels_statistics_decode_into(struct borealis_level_statistics *d,
+                                                 void *buffer, size_t capacity,
+                                                 uint8_t *cbor_buffer, size_t size);
+
+/*
+ * Decode the spectrum/levels payload as binary straight into a caller
+ * buffer of the given capacity, without allocating. Base64 text is decoded
+ * in place from cbor_buffer; *_VERSION_BINARY bytes are copied. On success
+ * the raw payload field (spectrum or level_data) refers to the caller
+ * buffer, the base64 field is NULL and the length field holds the number of
+ * bytes; on CborErrorOutOfMemory the length field holds the capacity
+ * required.
+ */
+CborError borealis_spectrum_data_decode_binary(struct borealis_spectrum_data *d,
+                                               uint8_t *spectrum, size_t capacity,
+                                               const uint8_t *cbor_buffer, size_t size);
+CborError borealis_levels_decode_binary(struct borealis_levels *d,
+                                        uint8_t *levels, size_t capacity,
+                                        const uint8_t *cbor_buffer, size_t size);
+CborError borealis_levels_statistics_decode_binary(struct borealis_level_statistics *d,
+                                                   uint8_t *levels, size_t capacity,
+                                                   const uint8_t *cbor_buffer,
+                                                   size_t size);
+
 #ifdef __cplusplus
 }
 #endif
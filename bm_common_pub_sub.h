@@ -31,6 +31,23 @@ typedef struct {
   uint8_t fnameAndData[0];
 } __attribute__((packed)) bm_print_publication_t;
 
+// Payload for several prints to the same node and file. Not sent on the
+// print topic: it follows a bm_common_pub_sub_header_t on its own topic, see
+// bm_print_batch.h
+typedef struct {
+  uint64_t target_node_id;
+  uint16_t fname_len;
+  uint16_t num_records;
+  uint8_t fnameAndRecords[0]; // fname, then num_records records
+} __attribute__((packed)) bm_print_batch_publication_t;
+
+// One print within a bm_print_batch_publication_t, followed by its data
+typedef struct {
+  uint16_t data_len;
+  uint8_t print_time;
+  uint8_t data[0];
+} __attribute__((packed)) bm_print_batch_record_t;
+
 #ifdef __cplusplus
 }
 #endif
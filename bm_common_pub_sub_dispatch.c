@@ -0,0 +1,46 @@
+#include "bm_common_pub_sub_dispatch.h"
+
+CborError bm_pub_sub_dispatch(const BmPubSubDispatchTable *table,
+                              const uint8_t *data, size_t len, void *ctx) {
+  if (len < sizeof(bm_common_pub_sub_header_t)) {
+    return CborErrorUnexpectedEOF;
+  }
+  const bm_common_pub_sub_header_t *header =
+      (const bm_common_pub_sub_header_t *)data;
+
+  const BmPubSubRoute *route = NULL;
+  for (size_t i = 0; i < table->num_routes; i++) {
+    if (table->routes[i].type == header->type &&
+        table->routes[i].version == header->version) {
+      route = &table->routes[i];
+      break;
+    }
+  }
+  if (!route) {
+    return CborErrorUnsupportedType;
+  }
+
+  BmPubSubPayload payload = {
+      .type = header->type,
+      .version = header->version,
+      .payload = header->payload,
+      .payload_len = len - sizeof(*header),
+      .cbor = NULL,
+  };
+  if (payload.payload_len < route->min_len) {
+    return CborErrorUnexpectedEOF;
+  }
+
+  CborParser parser;
+  CborValue value;
+  if (route->cbor) {
+    CborError err = cbor_parser_init(payload.payload, payload.payload_len, 0,
+                                     &parser, &value);
+    if (err != CborNoError) {
+      return err;
+    }
+    payload.cbor = &value;
+  }
+
+  return route->handler(&payload, ctx);
+}
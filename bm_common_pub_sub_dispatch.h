@@ -0,0 +1,63 @@
+#pragma once
+#include "bm_common_pub_sub.h"
+#include "cbor.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Routing of pub sub publications to their handlers.
+//
+// A subscriber declares a constant table of routes, one per (type, version)
+// it understands, and hands every publication it receives to
+// bm_pub_sub_dispatch(). The header is checked once here; handlers get a
+// view of the payload that is known to be at least min_len bytes long, and
+// for CBOR routes a parser already positioned on the payload, so they can
+// read in place instead of copying.
+
+typedef struct {
+  uint8_t type;
+  uint8_t version;
+  const uint8_t *payload; // points into the publication
+  size_t payload_len;     // at least the route's min_len
+  CborValue *cbor;        // the parsed payload for CBOR routes, else NULL
+} BmPubSubPayload;
+
+typedef CborError (*BmPubSubHandler)(const BmPubSubPayload *payload, void *ctx);
+
+typedef struct {
+  uint8_t type;
+  uint8_t version;
+  size_t min_len; // e.g. sizeof(bm_common_pub_sub_utc_t)
+  bool cbor;      // payload is a CBOR item
+  BmPubSubHandler handler;
+} BmPubSubRoute;
+
+typedef struct {
+  const BmPubSubRoute *routes;
+  size_t num_routes;
+} BmPubSubDispatchTable;
+
+/* Declares a constant dispatch table name over the routes given. */
+#define BM_PUB_SUB_DISPATCH_TABLE(name, ...)                                   \
+  static const BmPubSubRoute name##_routes[] = {__VA_ARGS__};                  \
+  static const BmPubSubDispatchTable name = {                                  \
+      name##_routes, sizeof(name##_routes) / sizeof(name##_routes[0])}
+
+/*!
+ Calls the handler routed for the publication in data and returns its
+ result.
+
+ @return CborErrorUnsupportedType if no route matches type and version
+         CborErrorUnexpectedEOF if data is shorter than the header plus the
+         route's min_len
+         a parser error if a CBOR payload does not start with a valid item
+*/
+CborError bm_pub_sub_dispatch(const BmPubSubDispatchTable *table,
+                              const uint8_t *data, size_t len, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
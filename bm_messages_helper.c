@@ -1,4 +1,5 @@
 #include "bm_messages_helper.h"
+#include "bm_base64.h"
 
 #ifndef CI_TEST
 #include "bm_os.h"
@@ -14,6 +15,219 @@
 
 #define check_and_run_get_api(e, f) check_and_decode_key(e, f)
 
+uint32_t bm_fnv1a(uint32_t hash, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 16777619u;
+  }
+  return hash;
+}
+
+size_t bm_cbor_text_header(size_t len, uint8_t header[9]) {
+  if (len < 24) {
+    header[0] = 0x60 | (uint8_t)len;
+    return 1;
+  }
+  if (len <= UINT8_MAX) {
+    header[0] = 0x78;
+    header[1] = (uint8_t)len;
+    return 2;
+  }
+  if (len <= UINT16_MAX) {
+    header[0] = 0x79;
+    header[1] = (uint8_t)(len >> 8);
+    header[2] = (uint8_t)len;
+    return 3;
+  }
+  header[0] = 0x7a;
+  for (int i = 0; i < 4; i++) {
+    header[1 + i] = (uint8_t)(len >> (24 - 8 * i));
+  }
+  return 5;
+}
+
+uint32_t bm_cbor_key_hash(const char *key, uint8_t header[9],
+                          size_t *header_len) {
+  const size_t key_len = strlen(key);
+  *header_len = bm_cbor_text_header(key_len, header);
+  return bm_fnv1a(bm_fnv1a(BM_FNV1A_INIT, header, *header_len), key, key_len);
+}
+
+static uint32_t histogram_bucket(uint32_t value) {
+  uint32_t b = 0;
+  while (value) {
+    value >>= 1;
+    b++;
+  }
+  return b;
+}
+
+void bm_histogram_add(BmHistogram *h, uint32_t value) {
+  h->counts[histogram_bucket(value)]++;
+}
+
+void bm_histogram_merge(BmHistogram *dst, const BmHistogram *src) {
+  for (size_t b = 0; b < BM_HISTOGRAM_NUM_BUCKETS; b++) {
+    dst->counts[b] += src->counts[b];
+  }
+}
+
+uint64_t bm_histogram_quantile(const BmHistogram *h, float q) {
+  uint64_t total = 0;
+  for (size_t b = 0; b < BM_HISTOGRAM_NUM_BUCKETS; b++) {
+    total += h->counts[b];
+  }
+  if (!total) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(q * (float)total + 0.5f);
+  rank = rank ? rank : 1;
+  uint64_t seen = 0;
+  size_t b;
+  for (b = 0; b < BM_HISTOGRAM_NUM_BUCKETS - 1; b++) {
+    seen += h->counts[b];
+    if (seen >= rank) {
+      break;
+    }
+  }
+  return b ? (1ull << b) - 1 : 0;
+}
+
+void bm_summary_add(BmSummary *s, float value) {
+  if (!s->count || value < s->min) {
+    s->min = value;
+  }
+  if (!s->count || value > s->max) {
+    s->max = value;
+  }
+  s->count++;
+  s->sum += value;
+}
+
+void bm_summary_merge(BmSummary *dst, const BmSummary *src) {
+  if (!src->count) {
+    return;
+  }
+  if (!dst->count || src->min < dst->min) {
+    dst->min = src->min;
+  }
+  if (!dst->count || src->max > dst->max) {
+    dst->max = src->max;
+  }
+  dst->count += src->count;
+  dst->sum += src->sum;
+}
+
+static CborError encode_histogram(CborEncoder *encoder, const BmHistogram *h) {
+  CborError err = CborNoError;
+  CborEncoder array;
+  size_t first = 0, end = BM_HISTOGRAM_NUM_BUCKETS;
+  while (first < end && !h->counts[first]) {
+    first++;
+  }
+  while (end > first && !h->counts[end - 1]) {
+    end--;
+  }
+  check_and_encode_key(err, cbor_encoder_create_array(encoder, &array, 1 + end - first));
+  check_and_encode_key(err, cbor_encode_uint(&array, first == end ? 0 : first));
+  for (size_t b = first; b < end; b++) {
+    check_and_encode_key(err, cbor_encode_uint(&array, h->counts[b]));
+  }
+  check_and_encode_key(err, cbor_encoder_close_container(encoder, &array));
+  return err;
+}
+
+static CborError encode_summary(CborEncoder *encoder, const BmSummary *s) {
+  CborError err = CborNoError;
+  CborEncoder array;
+  check_and_encode_key(err, cbor_encoder_create_array(encoder, &array, s->count ? 4 : 1));
+  check_and_encode_key(err, cbor_encode_uint(&array, s->count));
+  if (s->count) {
+    check_and_encode_key(err, cbor_encode_float(&array, s->min));
+    check_and_encode_key(err, cbor_encode_float(&array, s->max));
+    check_and_encode_key(err, cbor_encode_double(&array, s->sum));
+  }
+  check_and_encode_key(err, cbor_encoder_close_container(encoder, &array));
+  return err;
+}
+
+static CborError decode_array_uint32(CborValue *it, uint32_t *out) {
+  uint64_t v;
+  if (!cbor_value_is_unsigned_integer(it)) {
+    return CborErrorIllegalType;
+  }
+  CborError err = cbor_value_get_uint64(it, &v);
+  if (err == CborNoError && v > UINT32_MAX) {
+    err = CborErrorDataTooLarge;
+  }
+  *out = (uint32_t)v;
+  check_and_run_get_api(err, cbor_value_advance_fixed(it));
+  return err;
+}
+
+static CborError decode_array_double(CborValue *it, double *out) {
+  CborError err;
+  if (cbor_value_is_double(it)) {
+    err = cbor_value_get_double(it, out);
+  } else if (cbor_value_is_float(it)) {
+    float f;
+    err = cbor_value_get_float(it, &f);
+    *out = f;
+  } else {
+    return CborErrorIllegalType;
+  }
+  check_and_run_get_api(err, cbor_value_advance_fixed(it));
+  return err;
+}
+
+/* value is left on the array, the destination is only written if it is valid */
+static CborError decode_histogram(const CborValue *value, BmHistogram *out) {
+  BmHistogram h = {0};
+  CborValue it;
+  size_t len;
+  uint32_t first;
+  CborError err = cbor_value_get_array_length(value, &len);
+  if (err == CborNoError && len < 1) {
+    err = CborErrorImproperValue;
+  }
+  check_and_run_get_api(err, cbor_value_enter_container(value, &it));
+  check_and_run_get_api(err, decode_array_uint32(&it, &first));
+  if (err == CborNoError && first + len - 1 > BM_HISTOGRAM_NUM_BUCKETS) {
+    err = CborErrorImproperValue;
+  }
+  for (size_t b = first; err == CborNoError && b < first + len - 1; b++) {
+    err = decode_array_uint32(&it, &h.counts[b]);
+  }
+  if (err == CborNoError) {
+    *out = h;
+  }
+  return err;
+}
+
+static CborError decode_summary(const CborValue *value, BmSummary *out) {
+  BmSummary s = {0};
+  CborValue it;
+  size_t len;
+  double min = 0, max = 0;
+  CborError err = cbor_value_get_array_length(value, &len);
+  check_and_run_get_api(err, cbor_value_enter_container(value, &it));
+  check_and_run_get_api(err, decode_array_uint32(&it, &s.count));
+  if (err == CborNoError && len != (s.count ? 4u : 1u)) {
+    err = CborErrorImproperValue;
+  }
+  if (s.count) {
+    check_and_run_get_api(err, decode_array_double(&it, &min));
+    check_and_run_get_api(err, decode_array_double(&it, &max));
+    check_and_run_get_api(err, decode_array_double(&it, &s.sum));
+  }
+  s.min = (float)min;
+  s.max = (float)max;
+  if (err == CborNoError) {
+    *out = s;
+  }
+  return err;
+}
+
 CborError encoder_message_create(CborEncoder *encoder, CborEncoder *map_encoder,
                                  uint8_t *cbor_buffer, size_t size,
                                  size_t num_fields) {
@@ -238,6 +452,21 @@ CborError decoder_message_enter(CborValue *map, CborValue *decode_value,
   return err;
 }
 
+CborError decoder_message_num_fields(const uint8_t *cbor_buffer, size_t size,
+                                     size_t *num_fields) {
+  CborParser parser;
+  CborValue map;
+  CborError err = cbor_parser_init(cbor_buffer, size, 0, &parser, &map);
+
+  if (check_acceptable_decode_errors(err) && !cbor_value_is_map(&map)) {
+    err = CborErrorIllegalType;
+  }
+
+  check_and_run_get_api(err, cbor_value_get_map_length(&map, num_fields));
+
+  return err;
+}
+
 CborError decode_key_value_float(float *out, CborValue *value,
                                  const char *key_expected) {
   CborError err;
@@ -432,6 +661,342 @@ CborError decode_key_value_bytes(uint8_t **out, size_t *len, CborValue *value,
   return decode_key_value_string_bytes((void **)out, len, value, key_expected);
 }
 
+static CborError decode_key_value_string_bytes_into(void *out, size_t *len,
+                                                    CborValue *value,
+                                                    const char *key_expected,
+                                                    CborType type) {
+  CborError err;
+  const size_t capacity = *len;
+
+  if (!cbor_value_is_text_string(value)) {
+    bm_debug("error: %s(%s): expected string key but got something else\r\n",
+             __func__, key_expected);
+    return CborErrorIllegalType;
+  }
+
+  if ((err = cbor_value_advance(value)) != CborNoError)
+    return err;
+
+  if (cbor_value_get_type(value) != type) {
+    bm_debug("error: %s(%s): value has the wrong string type\r\n", __func__,
+             key_expected);
+    return CborErrorIllegalType;
+  }
+
+  size_t len_without_zeroterm = 0;
+  if ((err = cbor_value_calculate_string_length(
+           value, &len_without_zeroterm)) != CborNoError)
+    return err;
+
+  size_t required = len_without_zeroterm;
+  if (value->type == CborTextStringType) {
+    // Length with zeroterm
+    required++;
+  }
+  if (required > capacity) {
+    bm_debug("error: %s(%s): %zu bytes needed, %zu available\r\n", __func__,
+             key_expected, required, capacity);
+    *len = required;
+    return CborErrorOutOfMemory;
+  }
+
+  size_t copied = capacity;
+  if (value->type == CborTextStringType) {
+    err = cbor_value_copy_text_string(value, (char *)out, &copied, NULL);
+  } else {
+    err = cbor_value_copy_byte_string(value, (uint8_t *)out, &copied, NULL);
+  }
+  if (err != CborNoError)
+    return err;
+
+  if (value->type == CborTextStringType) {
+    /* explicitly zero terminate */
+    ((char *)out)[len_without_zeroterm] = '\0';
+  }
+  *len = len_without_zeroterm;
+
+  return cbor_value_advance(value);
+}
+
+/*!
+ @brief Decodes a string or byte string value into a caller buffer
+
+ @details Same as decode_key_value_string/decode_key_value_bytes without the
+ allocation. Text strings are zero terminated, so need one byte more than
+ their length.
+
+ @param out Destination buffer
+ @param len In: capacity of out. Out: length of the value (without the zero
+            terminator), or the capacity required if CborErrorOutOfMemory is
+            returned
+ @param value The key of the key-value pair
+ @param key_expected Name of the key, for diagnostics
+
+ @return CborNoError on success, CborErrorOutOfMemory if out is too small,
+         CborErrorIllegalType if the value is not the requested string type
+*/
+CborError decode_key_value_string_into(char *out, size_t *len, CborValue *value,
+                                       const char *key_expected) {
+  return decode_key_value_string_bytes_into(out, len, value, key_expected,
+                                            CborTextStringType);
+}
+
+CborError decode_key_value_bytes_into(uint8_t *out, size_t *len,
+                                      CborValue *value,
+                                      const char *key_expected) {
+  return decode_key_value_string_bytes_into(out, len, value, key_expected,
+                                            CborByteStringType);
+}
+
+/*
+ * RFC 8746 typed arrays: a tag naming the element type followed by a byte
+ * string holding the packed elements. uint16 arrays are sent as uint8
+ * arrays when every element fits, which is the common case for counters.
+ */
+CborError encode_key_value_uint8_typed_array(CborEncoder *map_encoder,
+                                             const char *name,
+                                             const uint8_t *array,
+                                             size_t len) {
+  CborError err = CborNoError;
+  check_and_encode_key(err, cbor_encode_text_stringz(map_encoder, name));
+  check_and_encode_key(err, cbor_encode_tag(map_encoder, BM_CBOR_TAG_TYPED_UINT8));
+  check_and_encode_key(err, cbor_encode_byte_string(map_encoder, array, len));
+  if (err != CborNoError) {
+    bm_debug("error: %s(%s): %d\r\n", __func__, name, err);
+  }
+  return err;
+}
+
+CborError encode_key_value_uint16_typed_array(CborEncoder *map_encoder,
+                                              const char *name,
+                                              const uint16_t *array,
+                                              size_t len) {
+  CborError err = CborNoError;
+  uint8_t packed[2 * BM_TYPED_ARRAY_MAX_LEN];
+  bool narrow = true;
+  if (len > BM_TYPED_ARRAY_MAX_LEN) {
+    return CborErrorDataTooLarge;
+  }
+  for (size_t i = 0; i < len; i++) {
+    narrow = narrow && array[i] <= UINT8_MAX;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (narrow) {
+      packed[i] = (uint8_t)array[i];
+    } else {
+      packed[2 * i] = (uint8_t)array[i];
+      packed[2 * i + 1] = (uint8_t)(array[i] >> 8);
+    }
+  }
+  check_and_encode_key(err, cbor_encode_text_stringz(map_encoder, name));
+  check_and_encode_key(err, cbor_encode_tag(map_encoder,
+                                            narrow ? BM_CBOR_TAG_TYPED_UINT8
+                                                   : BM_CBOR_TAG_TYPED_UINT16_LE));
+  check_and_encode_key(err, cbor_encode_byte_string(map_encoder, packed,
+                                                    narrow ? len : 2 * len));
+  if (err != CborNoError) {
+    bm_debug("error: %s(%s): %d\r\n", __func__, name, err);
+  }
+  return err;
+}
+
+/* leaves value on the packed byte string, returns its element width */
+static CborError enter_typed_array(CborValue *value, const char *key_expected,
+                                   size_t *width, bool *big_endian) {
+  CborError err;
+  CborTag tag = 0;
+  if (!cbor_value_is_text_string(value)) {
+    bm_debug("error: %s(%s): expected string key but got something else\r\n",
+             __func__, key_expected);
+    return CborErrorIllegalType;
+  }
+  if ((err = cbor_value_advance(value)) != CborNoError) {
+    return err;
+  }
+  if (!cbor_value_is_tag(value)) {
+    return CborErrorIllegalType;
+  }
+  if ((err = cbor_value_get_tag(value, &tag)) != CborNoError ||
+      (err = cbor_value_advance_fixed(value)) != CborNoError) {
+    return err;
+  }
+  *big_endian = tag == BM_CBOR_TAG_TYPED_UINT16_BE;
+  if (tag == BM_CBOR_TAG_TYPED_UINT8) {
+    *width = 1;
+  } else if (tag == BM_CBOR_TAG_TYPED_UINT16_LE || *big_endian) {
+    *width = 2;
+  } else {
+    bm_debug("error: %s(%s): unexpected tag %llu\r\n", __func__, key_expected,
+             (unsigned long long)tag);
+    return CborErrorInappropriateTagForType;
+  }
+  if (!cbor_value_is_byte_string(value)) {
+    return CborErrorIllegalType;
+  }
+  return CborNoError;
+}
+
+/*!
+ @brief Decodes a uint8 typed array into caller storage
+
+ @param out Destination array
+ @param len In: capacity of out in elements. Out: number of elements, or the
+            number required if CborErrorOutOfMemory is returned
+ @param value The key of the key-value pair
+ @param key_expected Name of the key, for diagnostics
+
+ @return CborErrorInappropriateTagForType for other element types
+*/
+CborError decode_key_value_uint8_typed_array(uint8_t *out, size_t *len,
+                                             CborValue *value,
+                                             const char *key_expected) {
+  CborError err;
+  size_t width, n = 0;
+  bool big_endian;
+  if ((err = enter_typed_array(value, key_expected, &width, &big_endian)) !=
+      CborNoError) {
+    return err;
+  }
+  if (width != 1) {
+    return CborErrorInappropriateTagForType;
+  }
+  if ((err = cbor_value_calculate_string_length(value, &n)) != CborNoError) {
+    return err;
+  }
+  if (n > *len) {
+    *len = n;
+    return CborErrorOutOfMemory;
+  }
+  if ((err = cbor_value_copy_byte_string(value, out, &n, NULL)) != CborNoError) {
+    return err;
+  }
+  *len = n;
+  return cbor_value_advance(value);
+}
+
+/*!
+ @brief Decodes a uint8 or uint16 typed array into uint16 caller storage
+
+ @details The bytes are copied into out and widened in place, so there is no
+ intermediate buffer.
+
+ @param len As for decode_key_value_uint8_typed_array()
+*/
+CborError decode_key_value_uint16_typed_array(uint16_t *out, size_t *len,
+                                              CborValue *value,
+                                              const char *key_expected) {
+  CborError err;
+  size_t width, bytes = 0;
+  bool big_endian;
+  if ((err = enter_typed_array(value, key_expected, &width, &big_endian)) !=
+      CborNoError) {
+    return err;
+  }
+  if ((err = cbor_value_calculate_string_length(value, &bytes)) != CborNoError) {
+    return err;
+  }
+  if (bytes % width) {
+    return CborErrorImproperValue;
+  }
+  const size_t n = bytes / width;
+  if (n > *len) {
+    *len = n;
+    return CborErrorOutOfMemory;
+  }
+
+  uint8_t *raw = (uint8_t *)out;
+  if (width == 1) {
+    /* copy to the upper half and widen upwards; element i never overwrites a
+     * byte that is still to be read */
+    uint8_t *src = raw + n;
+    if ((err = cbor_value_copy_byte_string(value, src, &bytes, NULL)) != CborNoError) {
+      return err;
+    }
+    for (size_t i = 0; i < n; i++) {
+      out[i] = src[i];
+    }
+  } else {
+    if ((err = cbor_value_copy_byte_string(value, raw, &bytes, NULL)) != CborNoError) {
+      return err;
+    }
+    for (size_t i = 0; i < n; i++) {
+      const uint8_t b0 = raw[2 * i], b1 = raw[2 * i + 1];
+      out[i] = big_endian ? (uint16_t)(b0 << 8 | b1) : (uint16_t)(b1 << 8 | b0);
+    }
+  }
+  *len = n;
+  return cbor_value_advance(value);
+}
+
+/*!
+ @brief Decodes a base64 text string value straight into a caller buffer
+
+ @details The characters are read in place from the CBOR buffer, so there is
+ no intermediate allocation. A byte string value is copied as is, which lets
+ the same call handle payloads that moved from base64 text to raw bytes.
+
+ @param out Destination buffer
+ @param len In: capacity of out. Out: number of bytes decoded, or the
+            number of bytes required if CborErrorOutOfMemory is returned
+ @param value The key of the key-value pair
+ @param key_expected Name of the key, for diagnostics
+
+ @return CborErrorImproperValue if the text is not valid base64,
+         CborErrorUnknownLength for chunked (indefinite length) strings
+*/
+CborError decode_key_value_base64(uint8_t *out, size_t *len, CborValue *value,
+                                  const char *key_expected) {
+  CborError err;
+  const size_t capacity = *len;
+
+  if (!cbor_value_is_text_string(value)) {
+    bm_debug("error: %s(%s): expected string key but got something else\r\n",
+             __func__, key_expected);
+    return CborErrorIllegalType;
+  }
+  if ((err = cbor_value_advance(value)) != CborNoError)
+    return err;
+
+  if (cbor_value_is_byte_string(value)) {
+    size_t required = 0;
+    if ((err = cbor_value_calculate_string_length(value, &required)) != CborNoError)
+      return err;
+    if (required > capacity) {
+      *len = required;
+      return CborErrorOutOfMemory;
+    }
+    *len = capacity;
+    if ((err = cbor_value_copy_byte_string(value, out, len, NULL)) != CborNoError)
+      return err;
+    return cbor_value_advance(value);
+  }
+
+  if (!cbor_value_is_text_string(value))
+    return CborErrorIllegalType;
+  if (!cbor_value_is_length_known(value))
+    return CborErrorUnknownLength;
+
+  const char *text = NULL;
+  size_t text_len = 0;
+  if ((err = cbor_value_get_text_string_chunk(value, &text, &text_len, NULL)) !=
+      CborNoError)
+    return err;
+
+  const size_t required = bm_base64_decoded_len(text, text_len);
+  if (required > capacity) {
+    bm_debug("error: %s(%s): %zu bytes needed, %zu available\r\n", __func__,
+             key_expected, required, capacity);
+    *len = required;
+    return CborErrorOutOfMemory;
+  }
+  if (!bm_base64_decode(text, text_len, out, len)) {
+    bm_debug("error: %s(%s): invalid base64\r\n", __func__, key_expected);
+    return CborErrorImproperValue;
+  }
+
+  return cbor_value_advance(value);
+}
+
 CborError decoder_message_leave(CborValue *value, CborValue *map) {
   CborError err;
 
@@ -546,10 +1111,521 @@ CborError decode_key_value_double_array(double **array_out, uint8_t *len,
   return err;
 }
 
-CborError bm_decode_fields_from_table(CborValue *value, const BmDecodeTableEntry *entries_table, size_t table_len) {
+/* IEEE 754 single to half precision, rounding to nearest even */
+static uint16_t float_to_half(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+  const uint32_t exp = (x >> 23) & 0xff;
+  uint32_t mant = x & 0x7fffff;
+  if (exp == 0xff) {
+    return sign | 0x7c00 | (mant ? 0x200 : 0);
+  }
+  const int32_t e = (int32_t)exp - 127 + 15;
+  if (e >= 0x1f) {
+    return sign | 0x7c00;
+  }
+  uint32_t shift = 13;
+  uint32_t half;
+  if (e <= 0) {
+    if (e < -10) {
+      return sign;
+    }
+    /* subnormal */
+    mant |= 0x800000;
+    shift = (uint32_t)(14 - e);
+    half = mant >> shift;
+  } else {
+    half = ((uint32_t)e << 10) | (mant >> shift);
+  }
+  const uint32_t rem = mant & ((1u << shift) - 1);
+  const uint32_t mid = 1u << (shift - 1);
+  if (rem > mid || (rem == mid && (half & 1))) {
+    half++; /* may carry into the exponent, which is still correct */
+  }
+  return sign | (uint16_t)half;
+}
+
+static float half_to_float(uint16_t h) {
+  const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  const uint32_t exp = (h >> 10) & 0x1f;
+  const uint32_t mant = h & 0x3ff;
+  float f;
+  if (exp == 0) {
+    f = (float)mant * (1.0f / 16777216.0f);
+    return sign ? -f : f;
+  }
+  const uint32_t x = sign | (exp == 0x1f ? 0x7f800000 | (mant << 13)
+                                          : ((exp + 112) << 23) | (mant << 13));
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+size_t bm_field_scalar_size(BmField type) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+  case BM_FIELD_INT8:
+    return 1;
+  case BM_FIELD_UINT16:
+  case BM_FIELD_INT16:
+    return 2;
+  case BM_FIELD_UINT32:
+  case BM_FIELD_INT32:
+  case BM_FIELD_FLOAT:
+  case BM_FIELD_HALF:
+    return 4;
+  case BM_FIELD_UINT64:
+  case BM_FIELD_INT64:
+  case BM_FIELD_DOUBLE:
+    return 8;
+  case BM_FIELD_BOOL:
+    return sizeof(bool);
+  default:
+    return 0;
+  }
+}
+
+static CborError encode_scalar(CborEncoder *encoder, BmField type,
+                               const void *src) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+    return cbor_encode_uint(encoder, *(const uint8_t *)src);
+  case BM_FIELD_UINT16:
+    return cbor_encode_uint(encoder, *(const uint16_t *)src);
+  case BM_FIELD_UINT32:
+    return cbor_encode_uint(encoder, *(const uint32_t *)src);
+  case BM_FIELD_UINT64:
+    return cbor_encode_uint(encoder, *(const uint64_t *)src);
+  case BM_FIELD_INT8:
+    return cbor_encode_int(encoder, *(const int8_t *)src);
+  case BM_FIELD_INT16:
+    return cbor_encode_int(encoder, *(const int16_t *)src);
+  case BM_FIELD_INT32:
+    return cbor_encode_int(encoder, *(const int32_t *)src);
+  case BM_FIELD_INT64:
+    return cbor_encode_int(encoder, *(const int64_t *)src);
+  case BM_FIELD_BOOL:
+    return cbor_encode_boolean(encoder, *(const bool *)src);
+  case BM_FIELD_HALF: {
+    const uint16_t half = float_to_half(*(const float *)src);
+    return cbor_encode_half_float(encoder, &half);
+  }
+  case BM_FIELD_FLOAT:
+    return cbor_encode_float(encoder, *(const float *)src);
+  case BM_FIELD_DOUBLE:
+    return cbor_encode_double(encoder, *(const double *)src);
+  default:
+    return CborErrorUnsupportedType;
+  }
+}
+
+/*
+ * Decodes value, without advancing over it. Returns CborErrorImproperValue,
+ * leaving dst untouched, if value does not have the table type or does not
+ * fit a signed destination. Unsigned destinations keep their low bits.
+ */
+static CborError decode_scalar(const CborValue *value, BmField type,
+                               void *dst) {
+  CborError err;
+  switch (type) {
+  case BM_FIELD_UINT8:
+  case BM_FIELD_UINT16:
+  case BM_FIELD_UINT32:
+  case BM_FIELD_UINT64: {
+    uint64_t v = 0;
+    if (!cbor_value_is_unsigned_integer(value)) {
+      bm_debug("table expected int but got something else\n");
+      return CborErrorImproperValue;
+    }
+    if ((err = cbor_value_get_uint64(value, &v)) != CborNoError) {
+      return err;
+    }
+    if (type == BM_FIELD_UINT8) {
+      *(uint8_t *)dst = (uint8_t)v;
+    } else if (type == BM_FIELD_UINT16) {
+      *(uint16_t *)dst = (uint16_t)v;
+    } else if (type == BM_FIELD_UINT32) {
+      *(uint32_t *)dst = (uint32_t)v;
+    } else {
+      *(uint64_t *)dst = v;
+    }
+    return CborNoError;
+  }
+  case BM_FIELD_INT8:
+  case BM_FIELD_INT16:
+  case BM_FIELD_INT32:
+  case BM_FIELD_INT64: {
+    int64_t v = 0;
+    if (!cbor_value_is_integer(value) ||
+        cbor_value_get_int64_checked(value, &v) != CborNoError) {
+      bm_debug("table expected signed int but got something else\n");
+      return CborErrorImproperValue;
+    }
+    if (type == BM_FIELD_INT8 && v >= INT8_MIN && v <= INT8_MAX) {
+      *(int8_t *)dst = (int8_t)v;
+    } else if (type == BM_FIELD_INT16 && v >= INT16_MIN && v <= INT16_MAX) {
+      *(int16_t *)dst = (int16_t)v;
+    } else if (type == BM_FIELD_INT32 && v >= INT32_MIN && v <= INT32_MAX) {
+      *(int32_t *)dst = (int32_t)v;
+    } else if (type == BM_FIELD_INT64) {
+      *(int64_t *)dst = v;
+    } else {
+      bm_debug("signed int out of range\n");
+      return CborErrorImproperValue;
+    }
+    return CborNoError;
+  }
+  case BM_FIELD_BOOL:
+    if (!cbor_value_is_boolean(value)) {
+      bm_debug("table expected bool but got something else\n");
+      return CborErrorImproperValue;
+    }
+    return cbor_value_get_boolean(value, (bool *)dst);
+  case BM_FIELD_HALF: {
+    uint16_t half;
+    if (!cbor_value_is_half_float(value)) {
+      bm_debug("table expected half float but got something else\n");
+      return CborErrorImproperValue;
+    }
+    if ((err = cbor_value_get_half_float(value, &half)) == CborNoError) {
+      *(float *)dst = half_to_float(half);
+    }
+    return err;
+  }
+  case BM_FIELD_FLOAT:
+    if (!cbor_value_is_float(value)) {
+      bm_debug("table expected float but got something else\n");
+      return CborErrorImproperValue;
+    }
+    return cbor_value_get_float(value, (float *)dst);
+  case BM_FIELD_DOUBLE:
+    if (!cbor_value_is_double(value)) {
+      bm_debug("table expected double but got something else\n");
+      return CborErrorImproperValue;
+    }
+    return cbor_value_get_double(value, (double *)dst);
+  default:
+    return CborErrorUnsupportedType;
+  }
+}
+
+static CborError decode_string_into(const CborValue *value, BmFieldBuffer *b,
+                                    bool text) {
+  CborError err;
+  size_t n = 0;
+  if (text ? !cbor_value_is_text_string(value)
+           : !cbor_value_is_byte_string(value)) {
+    bm_debug("table expected %s but got something else\n",
+             text ? "string" : "bytes");
+    return CborErrorImproperValue;
+  }
+  if ((err = cbor_value_calculate_string_length(value, &n)) != CborNoError) {
+    return err;
+  }
+  if (n + text > b->capacity) {
+    bm_debug("%zu bytes needed, %zu available\n", n + text, b->capacity);
+    b->len = n + text;
+    return CborErrorOutOfMemory;
+  }
+  size_t copied = b->capacity;
+  if (text) {
+    err = cbor_value_copy_text_string(value, (char *)b->data, &copied, NULL);
+    ((char *)b->data)[n] = '\0';
+  } else {
+    err = cbor_value_copy_byte_string(value, (uint8_t *)b->data, &copied, NULL);
+  }
+  if (err == CborNoError) {
+    b->len = n;
+  }
+  return err;
+}
+
+/* elements may be written before a mismatch is found, len is only set on success */
+static CborError decode_array_into(const CborValue *value, BmFieldBuffer *b) {
+  CborError err;
+  CborValue it;
+  size_t n = 0;
+  const size_t size = bm_field_scalar_size(b->element);
+  if (!cbor_value_is_array(value)) {
+    bm_debug("table expected array but got something else\n");
+    return CborErrorImproperValue;
+  }
+  if (!size) {
+    return CborErrorUnsupportedType;
+  }
+  if ((err = cbor_value_get_array_length(value, &n)) != CborNoError) {
+    return err;
+  }
+  if (n > b->capacity) {
+    bm_debug("%zu elements needed, %zu available\n", n, b->capacity);
+    b->len = n;
+    return CborErrorOutOfMemory;
+  }
+  if ((err = cbor_value_enter_container(value, &it)) != CborNoError) {
+    return err;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if ((err = decode_scalar(&it, b->element, (uint8_t *)b->data + i * size)) !=
+        CborNoError) {
+      return err;
+    }
+    if ((err = cbor_value_advance_fixed(&it)) != CborNoError) {
+      return err;
+    }
+  }
+  b->len = n;
+  return CborNoError;
+}
+
+/*
+ * The fields of one map: either a table of entries pointing at their own
+ * storage, or struct members at offsets from base.
+ */
+typedef struct {
+  const BmDecodeTableEntry *decode_entries;
+  const BmEncoderTableEntry *encode_entries;
+  const BmStructField *fields;
+  uint8_t *base;
+  size_t len;
+} FieldSet;
+
+typedef struct {
+  const char *key;
+  BmField type;
+  void *ptr;
+  const BmStructTable *sub;
+} FieldRef;
+
+static FieldRef field_ref(const FieldSet *set, size_t i) {
+  FieldRef f = {0};
+  if (set->fields) {
+    f.key = set->fields[i].key;
+    f.type = set->fields[i].type;
+    f.ptr = set->base + set->fields[i].offset;
+    f.sub = set->fields[i].sub;
+  } else if (set->decode_entries) {
+    f.key = set->decode_entries[i].key;
+    f.type = set->decode_entries[i].type;
+    f.ptr = set->decode_entries[i].value_desitination;
+  } else {
+    f.key = set->encode_entries[i].key;
+    f.type = set->encode_entries[i].type;
+    f.ptr = (void *)set->encode_entries[i].value_source;
+  }
+  return f;
+}
+
+static FieldSet struct_field_set(const BmStructTable *table, const void *base) {
+  FieldSet set = {0};
+  set.fields = table->fields;
+  set.len = table->num_fields;
+  set.base = (uint8_t *)base;
+  return set;
+}
+
+static CborError decode_fields(CborValue *value, const FieldSet *set);
+static CborError encode_fields(CborEncoder *encoder, const FieldSet *set);
+
+/* CborErrorImproperValue, OutOfMemory and UnsupportedType still let the rest of a map decode */
+static bool is_soft_decode_error(CborError err) {
+  return err == CborErrorImproperValue || err == CborErrorOutOfMemory ||
+         err == CborErrorUnsupportedType;
+}
+
+/* the first soft error by precedence, as bm_decode_fields_from_table() reports them */
+static CborError worst_decode_error(CborError a, CborError b) {
+  const CborError order[] = {CborErrorImproperValue, CborErrorOutOfMemory,
+                             CborErrorUnsupportedType};
+  for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+    if (a == order[i] || b == order[i]) {
+      return order[i];
+    }
+  }
+  return CborNoError;
+}
+
+static CborError decode_map(const CborValue *value, const FieldSet *set) {
+  CborValue it;
+  CborError err;
+  if (!cbor_value_is_map(value)) {
+    bm_debug("table expected map but got something else\n");
+    return CborErrorImproperValue;
+  }
+  if ((err = cbor_value_enter_container(value, &it)) != CborNoError) {
+    return err;
+  }
+  return decode_fields(&it, set);
+}
+
+static CborError decode_struct_array(const CborValue *value, BmStructArray *a,
+                                     const BmStructTable *table) {
+  CborError err, soft = CborNoError;
+  CborValue it;
+  size_t n = 0;
+  if (!cbor_value_is_array(value)) {
+    bm_debug("table expected array but got something else\n");
+    return CborErrorImproperValue;
+  }
+  if ((err = cbor_value_get_array_length(value, &n)) != CborNoError) {
+    return err;
+  }
+  if (n > a->capacity) {
+    bm_debug("%zu elements needed, %zu available\n", n, a->capacity);
+    a->len = n;
+    return CborErrorOutOfMemory;
+  }
+  if ((err = cbor_value_enter_container(value, &it)) != CborNoError) {
+    return err;
+  }
+  for (size_t i = 0; i < n; i++) {
+    const FieldSet set =
+        struct_field_set(table, (uint8_t *)a->data + i * table->size);
+    err = decode_map(&it, &set);
+    if (err != CborNoError && !is_soft_decode_error(err)) {
+      return err;
+    }
+    soft = worst_decode_error(soft, err);
+    if ((err = cbor_value_advance(&it)) != CborNoError) {
+      return err;
+    }
+  }
+  a->len = n;
+  return soft;
+}
+
+static CborError decode_field(const CborValue *value, const FieldRef *f) {
+  switch (f->type) {
+  case BM_FIELD_STRING:
+    return decode_string_into(value, (BmFieldBuffer *)f->ptr, true);
+  case BM_FIELD_BYTES:
+    return decode_string_into(value, (BmFieldBuffer *)f->ptr, false);
+  case BM_FIELD_ARRAY:
+    return decode_array_into(value, (BmFieldBuffer *)f->ptr);
+  case BM_FIELD_HISTOGRAM:
+    if (!cbor_value_is_array(value) ||
+        decode_histogram(value, (BmHistogram *)f->ptr) != CborNoError) {
+      bm_debug("table expected histogram but got something else\n");
+      return CborErrorImproperValue;
+    }
+    return CborNoError;
+  case BM_FIELD_HISTOGRAM_MERGE: {
+    BmHistogram h;
+    if (!cbor_value_is_array(value) || decode_histogram(value, &h) != CborNoError) {
+      bm_debug("table expected histogram but got something else\n");
+      return CborErrorImproperValue;
+    }
+    bm_histogram_merge((BmHistogram *)f->ptr, &h);
+    return CborNoError;
+  }
+  case BM_FIELD_SUMMARY:
+    if (!cbor_value_is_array(value) ||
+        decode_summary(value, (BmSummary *)f->ptr) != CborNoError) {
+      bm_debug("table expected summary but got something else\n");
+      return CborErrorImproperValue;
+    }
+    return CborNoError;
+  case BM_FIELD_SUMMARY_MERGE: {
+    BmSummary sm;
+    if (!cbor_value_is_array(value) || decode_summary(value, &sm) != CborNoError) {
+      bm_debug("table expected summary but got something else\n");
+      return CborErrorImproperValue;
+    }
+    bm_summary_merge((BmSummary *)f->ptr, &sm);
+    return CborNoError;
+  }
+  case BM_FIELD_MAP: {
+    FieldSet set = {0};
+    if (f->sub) {
+      set = struct_field_set(f->sub, f->ptr);
+    } else {
+      set.decode_entries = ((const BmDecodeTable *)f->ptr)->entries;
+      set.len = ((const BmDecodeTable *)f->ptr)->num_entries;
+    }
+    return decode_map(value, &set);
+  }
+  case BM_FIELD_STRUCT_ARRAY:
+    if (!f->sub) {
+      return CborErrorUnsupportedType;
+    }
+    return decode_struct_array(value, (BmStructArray *)f->ptr, f->sub);
+  default:
+    return decode_scalar(value, f->type, f->ptr);
+  }
+}
+
+static CborError encode_field(CborEncoder *encoder, const FieldRef *f) {
+  CborError err = CborNoError;
+  switch (f->type) {
+  case BM_FIELD_STRING: {
+    const BmFieldBuffer *b = (const BmFieldBuffer *)f->ptr;
+    return cbor_encode_text_string(encoder, (const char *)b->data, b->len);
+  }
+  case BM_FIELD_BYTES: {
+    const BmFieldBuffer *b = (const BmFieldBuffer *)f->ptr;
+    return cbor_encode_byte_string(encoder, (const uint8_t *)b->data, b->len);
+  }
+  case BM_FIELD_ARRAY: {
+    const BmFieldBuffer *b = (const BmFieldBuffer *)f->ptr;
+    const size_t size = bm_field_scalar_size(b->element);
+    CborEncoder array;
+    if (!size) {
+      return CborErrorUnsupportedType;
+    }
+    check_and_encode_key(err, cbor_encoder_create_array(encoder, &array, b->len));
+    for (size_t i = 0; i < b->len; i++) {
+      check_and_encode_key(err, encode_scalar(&array, b->element,
+                                              (const uint8_t *)b->data + i * size));
+    }
+    check_and_encode_key(err, cbor_encoder_close_container(encoder, &array));
+    return err;
+  }
+  case BM_FIELD_HISTOGRAM:
+  case BM_FIELD_HISTOGRAM_MERGE:
+    return encode_histogram(encoder, (const BmHistogram *)f->ptr);
+  case BM_FIELD_SUMMARY:
+  case BM_FIELD_SUMMARY_MERGE:
+    return encode_summary(encoder, (const BmSummary *)f->ptr);
+  case BM_FIELD_MAP: {
+    FieldSet set = {0};
+    CborEncoder map;
+    if (f->sub) {
+      set = struct_field_set(f->sub, f->ptr);
+    } else {
+      set.encode_entries = ((const BmEncoderTable *)f->ptr)->entries;
+      set.len = ((const BmEncoderTable *)f->ptr)->num_entries;
+    }
+    check_and_encode_key(err, cbor_encoder_create_map(encoder, &map, set.len));
+    check_and_encode_key(err, encode_fields(&map, &set));
+    check_and_encode_key(err, cbor_encoder_close_container(encoder, &map));
+    return err;
+  }
+  case BM_FIELD_STRUCT_ARRAY: {
+    const BmStructArray *a = (const BmStructArray *)f->ptr;
+    CborEncoder array, map;
+    if (!f->sub) {
+      return CborErrorUnsupportedType;
+    }
+    check_and_encode_key(err, cbor_encoder_create_array(encoder, &array, a->len));
+    for (size_t i = 0; i < a->len; i++) {
+      const FieldSet set =
+          struct_field_set(f->sub, (const uint8_t *)a->data + i * f->sub->size);
+      check_and_encode_key(err, cbor_encoder_create_map(&array, &map, set.len));
+      check_and_encode_key(err, encode_fields(&map, &set));
+      check_and_encode_key(err, cbor_encoder_close_container(&array, &map));
+    }
+    check_and_encode_key(err, cbor_encoder_close_container(encoder, &array));
+    return err;
+  }
+  default:
+    return encode_scalar(encoder, f->type, f->ptr);
+  }
+}
+
+static CborError decode_fields(CborValue *value, const FieldSet *set) {
   CborError err = CborNoError;
   bool has_unknown_key = false;
   bool type_mismatch = false;
+  bool too_small = false;
 
   // Loop through the known keys, ignoring any unknown keys, or missing keys
     while (!cbor_value_at_end(value)) {
@@ -597,86 +1673,28 @@ CborError bm_decode_fields_from_table(CborValue *value, const BmDecodeTableEntry
       // Search the look up table for the matching string key
       size_t index;
       bool key_in_table = false;
-      for (index = 0; index < table_len; index++) {
-        if (strcmp(entries_table[index].key, key) == 0) {
+      for (index = 0; index < set->len; index++) {
+        const FieldRef f = field_ref(set, index);
+        if (strcmp(f.key, key) == 0) {
           key_in_table = true;
-          switch (entries_table[index].type) {
-            case BM_FIELD_UINT8: {
-              if (!cbor_value_is_unsigned_integer(value)) {
-                bm_debug("table expected int but got something else\n");
-                type_mismatch = true;
-                break;
-              }
-              uint64_t temp_value = 0;
-              err = cbor_value_get_uint64(value, &temp_value);
-              *(uint8_t *)entries_table[index].value_desitination = (uint8_t)temp_value;
-              break;
-            }
-            case BM_FIELD_UINT16: {
-              if (!cbor_value_is_unsigned_integer(value)) {
-                bm_debug("table expected int but got something else\n");
-                type_mismatch = true;
-                break;
-              }
-              uint64_t temp_value = 0;
-              err = cbor_value_get_uint64(value, &temp_value);
-              *(uint16_t *)entries_table[index].value_desitination = (uint16_t)temp_value;
-              break;
-            }
-            case BM_FIELD_UINT32: {
-              if (!cbor_value_is_unsigned_integer(value)) {
-                bm_debug("table expected int but got something else\n");
-                type_mismatch = true;
-                break;
-              }
-              uint64_t temp_value = 0;
-              err = cbor_value_get_uint64(value, &temp_value);
-              *(uint32_t *)entries_table[index].value_desitination = (uint32_t)temp_value;
-              break;
-            }
-            case BM_FIELD_UINT64: {
-              if (!cbor_value_is_unsigned_integer(value)) {
-                bm_debug("table expected int but got something else\n");
-                type_mismatch = true;
-                break;
-              }
-              err = cbor_value_get_uint64(value, (uint64_t *)entries_table[index].value_desitination);
-              break;
-            }
-            case BM_FIELD_FLOAT: {
-              if (!cbor_value_is_float(value)) {
-                bm_debug("table expected float but got something else\n");
-                type_mismatch = true;
-                break;
-              }
-              err = cbor_value_get_float(value, (float *)entries_table[index].value_desitination);
-              break;
-            }
-            case BM_FIELD_DOUBLE: {
-              if (!cbor_value_is_double(value)) {
-                bm_debug("table expected double but got something else\n");
-                type_mismatch = true;
-                break;
-              }
-              err = cbor_value_get_double(value, (double *)entries_table[index].value_desitination);
-              break;
-            }
-            // TODO - this one needs more work
-            // case BM_FIELD_STRING: {
-            //   err = cbor_value_copy_text_string(&value, (char *)entries_table[index].value_desitination, &key_len, NULL);
-            //   break;
-            // }
-            default: {
-              bm_debug("Failed to decode value for key %s, err: %d", entries_table[index].key, err);
-              err = CborErrorUnsupportedType;
-              break;
-            }
+          err = decode_field(value, &f);
+          if (err == CborErrorImproperValue) {
+            type_mismatch = true;
+          } else if (err == CborErrorOutOfMemory) {
+            too_small = true;
+          } else if (err == CborErrorUnsupportedType) {
+            bm_debug("Failed to decode value for key %s, err: %d", f.key, err);
+            has_unknown_key = true;
           }
           // We have found our key and decoded the value so exit the for loop
           break;
         }
       }
 
+      if (err != CborNoError && !is_soft_decode_error(err)) {
+        break;
+      }
+
       if (!key_in_table) {
         bm_debug("Ignoring unknown key-value pair\n");
         has_unknown_key = true;
@@ -693,6 +1711,10 @@ CborError bm_decode_fields_from_table(CborValue *value, const BmDecodeTableEntry
       err = CborErrorImproperValue;
     }
 
+    if (too_small && err == CborNoError) {
+      err = CborErrorOutOfMemory;
+    }
+
     if (has_unknown_key && err == CborNoError) {
       err = CborErrorUnsupportedType;
     }
@@ -700,63 +1722,56 @@ CborError bm_decode_fields_from_table(CborValue *value, const BmDecodeTableEntry
   return err;
 }
 
-CborError bm_encode_fields_from_table(CborEncoder *map_encoder, const BmEncoderTableEntry *entries_table, size_t table_len) {
+static CborError encode_fields(CborEncoder *encoder, const FieldSet *set) {
   CborError err = CborNoError;
 
   size_t index;
-  for (index = 0; index < table_len; index++) {
+  for (index = 0; index < set->len; index++) {
+    const FieldRef f = field_ref(set, index);
     // Encode the key
-    err = cbor_encode_text_stringz(map_encoder, entries_table[index].key);
+    err = cbor_encode_text_stringz(encoder, f.key);
     if (err != CborNoError) {
-      bm_debug("cbor_encode_text_stringz failed for key: %s, err: %d\n", entries_table[index].key, err);
+      bm_debug("cbor_encode_text_stringz failed for key: %s, err: %d\n", f.key, err);
       if (err != CborErrorOutOfMemory) {
         break;
       }
     }
 
     // Encode the value based on the type
-    switch (entries_table[index].type) {
-      case BM_FIELD_UINT8: {
-        err = cbor_encode_uint(map_encoder, *(const uint8_t *)entries_table[index].value_source);
-        break;
-      }
-      case BM_FIELD_UINT16: {
-        err = cbor_encode_uint(map_encoder, *(const uint16_t *)entries_table[index].value_source);
-        break;
-      }
-      case BM_FIELD_UINT32: {
-        err = cbor_encode_uint(map_encoder, *(const uint32_t *)entries_table[index].value_source);
-        break;
-      }
-      case BM_FIELD_UINT64: {
-        err = cbor_encode_uint(map_encoder, *(const uint64_t *)entries_table[index].value_source);
+    err = encode_field(encoder, &f);
+    if (err != CborNoError) {
+      bm_debug("Failed to encode value for key: %s\n", f.key);
+      if (err != CborErrorOutOfMemory) {
+        // exit the loop and return, out of memory is an acceptable error
         break;
       }
+    }
+  }
+  return err;
+}
 
-      case BM_FIELD_FLOAT: {
-        err = cbor_encode_float(map_encoder, *(const float *)entries_table[index].value_source);
-        break;
-      }
+CborError bm_decode_fields_from_table(CborValue *value, const BmDecodeTableEntry *entries_table, size_t table_len) {
+  FieldSet set = {0};
+  set.decode_entries = entries_table;
+  set.len = table_len;
+  return decode_fields(value, &set);
+}
 
-      case BM_FIELD_DOUBLE: {
-        err = cbor_encode_double(map_encoder, *(const double *)entries_table[index].value_source);
-        break;
-      }
+CborError bm_encode_fields_from_table(CborEncoder *map_encoder, const BmEncoderTableEntry *entries_table, size_t table_len) {
+  FieldSet set = {0};
+  set.encode_entries = entries_table;
+  set.len = table_len;
+  return encode_fields(map_encoder, &set);
+}
 
-      default: {
-        err = CborErrorUnsupportedType;
-        bm_debug("Unsupported value type for key: %s\n", entries_table[index].key);
-        break;
-      }
+CborError bm_decode_struct(CborValue *value, const BmStructTable *table,
+                           void *dst) {
+  const FieldSet set = struct_field_set(table, dst);
+  return decode_fields(value, &set);
+}
 
-      if (err != CborNoError) {
-        bm_debug("Failed to encode value for key: %s\n", entries_table[index].key);
-        if (err != CborErrorOutOfMemory) {
-          // exit the loop and return, out of memory is an acceptable error
-          break;
-        }
-      }
-    }
-  }
-  return err;
+CborError bm_encode_struct(CborEncoder *map_encoder, const BmStructTable *table,
+                           const void *src) {
+  const FieldSet set = struct_field_set(table, src);
+  return encode_fields(map_encoder, &set);
 }
@@ -28,9 +28,70 @@ typedef enum {
   BM_FIELD_UINT64,
   BM_FIELD_FLOAT,
   BM_FIELD_DOUBLE,
-  BM_FIELD_STRING,
+  BM_FIELD_STRING,    // BmFieldBuffer of char
+  BM_FIELD_HISTOGRAM, // BmHistogram
+  BM_FIELD_SUMMARY,   // BmSummary
+  BM_FIELD_INT8,
+  BM_FIELD_INT16,
+  BM_FIELD_INT32,
+  BM_FIELD_INT64,
+  BM_FIELD_BOOL,
+  BM_FIELD_HALF,  // float in memory, half precision on the wire
+  BM_FIELD_BYTES, // BmFieldBuffer of uint8_t
+  BM_FIELD_ARRAY, // BmFieldBuffer of a scalar element type
+  BM_FIELD_MAP,   // nested map, see BmStructField and BmEncoderTable
+  BM_FIELD_STRUCT_ARRAY, // BmStructArray, in struct tables only
+  BM_FIELD_HISTOGRAM_MERGE, // BmHistogram, decode merges into the destination
+  BM_FIELD_SUMMARY_MERGE,   // BmSummary, decode merges into the destination
 } BmField;
 
+/*
+ * Caller storage for BM_FIELD_STRING, BM_FIELD_BYTES and BM_FIELD_ARRAY.
+ * Decoding copies into data and never allocates. If data is too small the
+ * field decodes to CborErrorOutOfMemory and len is set to the capacity it
+ * needs. Decoded strings are zero terminated, so capacity counts the
+ * terminator while len does not.
+ */
+typedef struct {
+  void *data;
+  size_t len;      // bytes for strings and bytes, elements for arrays
+  size_t capacity; // decode only, in the same unit as len
+  BmField element; // BM_FIELD_ARRAY only, any of the scalar types
+} BmFieldBuffer;
+
+/*
+ * Log2 bucketed distribution of uint32 samples, e.g. latencies in us.
+ * Bucket 0 counts zeros and bucket b > 0 counts values in [2^(b-1), 2^b).
+ * Encoded as [first non-empty bucket, counts...], leading and trailing
+ * empty buckets dropped, so a narrow distribution costs a few bytes.
+ * BM_FIELD_HISTOGRAM decodes by overwriting the destination, while
+ * BM_FIELD_HISTOGRAM_MERGE adds the decoded counts to it, so a receiver can
+ * accumulate replies from several nodes or intervals. Both encode the same.
+ */
+#define BM_HISTOGRAM_NUM_BUCKETS 33
+
+typedef struct {
+  uint32_t counts[BM_HISTOGRAM_NUM_BUCKETS];
+} BmHistogram;
+
+/*
+ * Encoded as [count, min, max, sum], or [0] when empty. Like histograms,
+ * BM_FIELD_SUMMARY overwrites on decode and BM_FIELD_SUMMARY_MERGE merges.
+ */
+typedef struct {
+  uint32_t count;
+  float min;
+  float max;
+  double sum;
+} BmSummary;
+
+void bm_histogram_add(BmHistogram *h, uint32_t value);
+void bm_histogram_merge(BmHistogram *dst, const BmHistogram *src);
+/* upper bound of the bucket holding quantile q (0..1), 0 when empty */
+uint64_t bm_histogram_quantile(const BmHistogram *h, float q);
+void bm_summary_add(BmSummary *s, float value);
+void bm_summary_merge(BmSummary *dst, const BmSummary *src);
+
 typedef struct {
   const char* key;
   BmField type;
@@ -43,10 +104,74 @@ typedef struct {
   const void *value_source;
 } BmEncoderTableEntry;
 
+/*
+ * Value of a BM_FIELD_MAP entry in an encoder/decode table: the sub-table
+ * holding the nested map's fields.
+ */
+typedef struct {
+  const BmEncoderTableEntry *entries;
+  size_t num_entries;
+} BmEncoderTable;
+
+typedef struct {
+  const BmDecodeTableEntry *entries;
+  size_t num_entries;
+} BmDecodeTable;
+
+/*
+ * Struct tables describe a whole message tree statically, by member
+ * offsets, so one table serves every instance of the struct. A BM_FIELD_MAP
+ * member is a nested struct laid out by sub. A BM_FIELD_STRUCT_ARRAY member
+ * is a BmStructArray whose elements are laid out by sub, each encoded as a
+ * map. SENSOR_HEADER_STRUCT_FIELDS gives the header prefix.
+ */
+typedef struct BmStructTable BmStructTable;
+
+typedef struct {
+  const char *key;
+  BmField type;
+  size_t offset;            // offsetof(<struct>, <member>)
+  const BmStructTable *sub; // BM_FIELD_MAP and BM_FIELD_STRUCT_ARRAY only
+} BmStructField;
+
+struct BmStructTable {
+  const BmStructField *fields;
+  size_t num_fields;
+  size_t size; // sizeof the struct, the stride of a BmStructArray
+};
+
+/* decoding fills at most capacity elements and sets len */
+typedef struct {
+  void *data;
+  size_t len;
+  size_t capacity;
+} BmStructArray;
+
+/* size in memory of a scalar field type, 0 for the other types */
+size_t bm_field_scalar_size(BmField type);
+
 CborError bm_decode_fields_from_table(CborValue *value, const BmDecodeTableEntry *entries_table, size_t table_len);
 
 CborError bm_encode_fields_from_table(CborEncoder *map_encoder, const BmEncoderTableEntry *entries_table, size_t table_len);
 
+/* As the table functions, for the members of the struct at src/dst */
+CborError bm_decode_struct(CborValue *value, const BmStructTable *table,
+                           void *dst);
+
+CborError bm_encode_struct(CborEncoder *map_encoder, const BmStructTable *table,
+                           const void *src);
+
+/*
+ * Matching keys without decoding them: bm_cbor_key_hash() hashes the bytes
+ * a definite length encoder emits for a text key, header included, so it
+ * equals bm_fnv1a over the raw key item in a received message.
+ */
+#define BM_FNV1A_INIT 2166136261u
+uint32_t bm_fnv1a(uint32_t hash, const void *data, size_t len);
+size_t bm_cbor_text_header(size_t len, uint8_t header[9]);
+uint32_t bm_cbor_key_hash(const char *key, uint8_t header[9],
+                          size_t *header_len);
+
 CborError encoder_message_create(CborEncoder *encoder, CborEncoder *map_encoder,
                                  uint8_t *cbor_buffer, size_t size,
                                  size_t num_fields);
@@ -66,6 +191,17 @@ CborError encode_key_value_bytes(CborEncoder *map_encoder, const char *name,
                                  const unsigned char *value, const size_t len);
 CborError encode_key_value_double_array(CborEncoder *map_encoder, const char *name,
                                         const double *array, const size_t len);
+#define BM_CBOR_TAG_TYPED_UINT8 64
+#define BM_CBOR_TAG_TYPED_UINT16_BE 65
+#define BM_CBOR_TAG_TYPED_UINT16_LE 69
+#define BM_TYPED_ARRAY_MAX_LEN (64) // elements packed on the stack when encoding
+CborError encode_key_value_uint8_typed_array(CborEncoder *map_encoder,
+                                             const char *name,
+                                             const uint8_t *array, size_t len);
+CborError encode_key_value_uint16_typed_array(CborEncoder *map_encoder,
+                                              const char *name,
+                                              const uint16_t *array,
+                                              size_t len);
 CborError encoder_message_finish(CborEncoder *encoder,
                                  CborEncoder *map_encoder);
 void encoder_message_check_memory(CborEncoder *encoder, CborError err);
@@ -73,6 +209,10 @@ void encoder_message_check_memory(CborEncoder *encoder, CborError err);
 CborError decoder_message_enter(CborValue *map, CborValue *decode_value,
                                 CborParser *parser, uint8_t *cbor_buffer,
                                 size_t size, size_t num_fields);
+/* field count of a message's top level map, for messages whose field count
+   selects a variant; pass it on to decoder_message_enter() */
+CborError decoder_message_num_fields(const uint8_t *cbor_buffer, size_t size,
+                                     size_t *num_fields);
 CborError decode_key_value_float(float *out, CborValue *value,
                                  const char *key_expected);
 CborError decode_key_value_double(double *out, CborValue *value,
@@ -87,6 +227,19 @@ CborError decode_key_value_string(char **out, size_t *len, CborValue *value,
                                   const char *key_expected);
 CborError decode_key_value_bytes(uint8_t **out, size_t *len, CborValue *value,
                                  const char *key_expected);
+CborError decode_key_value_string_into(char *out, size_t *len, CborValue *value,
+                                       const char *key_expected);
+CborError decode_key_value_bytes_into(uint8_t *out, size_t *len,
+                                      CborValue *value,
+                                      const char *key_expected);
+CborError decode_key_value_uint8_typed_array(uint8_t *out, size_t *len,
+                                             CborValue *value,
+                                             const char *key_expected);
+CborError decode_key_value_uint16_typed_array(uint16_t *out, size_t *len,
+                                              CborValue *value,
+                                              const char *key_expected);
+CborError decode_key_value_base64(uint8_t *out, size_t *len, CborValue *value,
+                                  const char *key_expected);
 CborError decode_key_value_double_array(double **array_out, uint8_t *len,
                                         CborValue *value,
                                         const char * key_expected);
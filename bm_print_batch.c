@@ -0,0 +1,161 @@
+#include "bm_print_batch.h"
+#include <string.h>
+
+/* the batch follows the pub sub header in the buffer */
+#define BATCH_OFFSET sizeof(bm_common_pub_sub_header_t)
+
+void bm_print_batcher_init(BmPrintBatcher *b, uint8_t *buffer, size_t capacity,
+                           uint32_t max_age_ms, BmPrintBatchFlush flush,
+                           void *ctx) {
+  b->buffer = buffer;
+  b->capacity = capacity;
+  b->len = 0;
+  b->opened_ms = 0;
+  b->max_age_ms = max_age_ms;
+  b->flush = flush;
+  b->ctx = ctx;
+}
+
+CborError bm_print_batcher_flush(BmPrintBatcher *b) {
+  if (!b->len) {
+    return CborNoError;
+  }
+  CborError err = b->flush(b->buffer, b->len, b->ctx);
+  if (err == CborNoError) {
+    b->len = 0;
+  }
+  return err;
+}
+
+CborError bm_print_batcher_poll(BmPrintBatcher *b, uint64_t now_ms) {
+  if (b->len && now_ms - b->opened_ms >= b->max_age_ms) {
+    return bm_print_batcher_flush(b);
+  }
+  return CborNoError;
+}
+
+static bool batch_matches(const BmPrintBatcher *b, uint64_t target_node_id,
+                          const char *fname, size_t fname_len) {
+  bm_print_batch_publication_t header;
+  memcpy(&header, b->buffer + BATCH_OFFSET, sizeof(header));
+  return header.target_node_id == target_node_id &&
+         header.fname_len == fname_len &&
+         (!fname_len ||
+          memcmp(b->buffer + BATCH_OFFSET + sizeof(header), fname, fname_len) == 0);
+}
+
+CborError bm_print_batcher_add(BmPrintBatcher *b, uint64_t now_ms,
+                               uint64_t target_node_id, const char *fname,
+                               size_t fname_len, const char *data,
+                               size_t data_len, uint8_t print_time) {
+  const size_t record_len = sizeof(bm_print_batch_record_t) + data_len;
+  const size_t empty_len =
+      BATCH_OFFSET + sizeof(bm_print_batch_publication_t) + fname_len;
+  if (fname_len > UINT16_MAX || data_len > UINT16_MAX ||
+      empty_len + record_len > b->capacity) {
+    return CborErrorDataTooLarge;
+  }
+
+  CborError err;
+  bm_print_batch_publication_t header;
+  if (b->len) {
+    memcpy(&header, b->buffer + BATCH_OFFSET, sizeof(header));
+    if (!batch_matches(b, target_node_id, fname, fname_len) ||
+        b->len + record_len > b->capacity ||
+        header.num_records == UINT16_MAX) {
+      if ((err = bm_print_batcher_flush(b)) != CborNoError) {
+        return err;
+      }
+    }
+  }
+
+  if (!b->len) {
+    const bm_common_pub_sub_header_t pub_sub = {
+        .type = BM_PRINT_BATCH_PUB_SUB_TYPE,
+        .version = BM_PRINT_BATCH_PUB_SUB_VERSION,
+    };
+    memcpy(b->buffer, &pub_sub, sizeof(pub_sub));
+    header.target_node_id = target_node_id;
+    header.fname_len = (uint16_t)fname_len;
+    header.num_records = 0;
+    if (fname_len) {
+      memcpy(b->buffer + BATCH_OFFSET + sizeof(header), fname, fname_len);
+    }
+    b->len = empty_len;
+    b->opened_ms = now_ms;
+  }
+
+  const bm_print_batch_record_t record = {
+      .data_len = (uint16_t)data_len,
+      .print_time = print_time,
+  };
+  memcpy(b->buffer + b->len, &record, sizeof(record));
+  if (data_len) {
+    memcpy(b->buffer + b->len + sizeof(record), data, data_len);
+  }
+  b->len += record_len;
+  header.num_records++;
+  memcpy(b->buffer + BATCH_OFFSET, &header, sizeof(header));
+
+  if (b->len + sizeof(record) >= b->capacity) {
+    /* nothing more fits, send it now rather than on the next print */
+    return bm_print_batcher_flush(b);
+  }
+  return bm_print_batcher_poll(b, now_ms);
+}
+
+CborError bm_print_batch_reader_init(BmPrintBatchReader *r, const uint8_t *buf,
+                                     size_t len) {
+  bm_print_batch_publication_t header;
+  if (len < sizeof(header)) {
+    return CborErrorUnexpectedEOF;
+  }
+  memcpy(&header, buf, sizeof(header));
+
+  /* check every record up front so reading them cannot fail */
+  size_t offset = sizeof(header) + header.fname_len;
+  for (uint16_t i = 0; i < header.num_records; i++) {
+    bm_print_batch_record_t record;
+    if (offset > len || len - offset < sizeof(record)) {
+      return CborErrorUnexpectedEOF;
+    }
+    memcpy(&record, buf + offset, sizeof(record));
+    offset += sizeof(record) + record.data_len;
+  }
+  if (offset > len) {
+    return CborErrorUnexpectedEOF;
+  }
+  if (offset < len) {
+    return CborErrorGarbageAtEnd;
+  }
+
+  r->buf = buf;
+  r->offset = sizeof(header) + header.fname_len;
+  r->remaining = header.num_records;
+  r->target_node_id = header.target_node_id;
+  r->fname = header.fname_len ? (const char *)buf + sizeof(header) : NULL;
+  r->fname_len = header.fname_len;
+  return CborNoError;
+}
+
+bool bm_print_batch_reader_next(BmPrintBatchReader *r,
+                                BmPrintPublicationView *view) {
+  if (!r->remaining) {
+    return false;
+  }
+  bm_print_batch_record_t record;
+  memcpy(&record, r->buf + r->offset, sizeof(record));
+
+  view->target_node_id = r->target_node_id;
+  view->print_time = record.print_time;
+  view->fname = r->fname;
+  view->fname_len = r->fname_len;
+  view->data =
+      record.data_len ? (const char *)r->buf + r->offset + sizeof(record)
+                      : NULL;
+  view->data_len = record.data_len;
+
+  r->offset += sizeof(record) + record.data_len;
+  r->remaining--;
+  return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "bm_print_publication.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Coalescing of print publications.
+//
+// A BmPrintBatcher collects consecutive prints to the same target node and
+// file into one bm_print_batch_publication_t in a caller supplied buffer,
+// so a chatty node sends one publication per batch instead of one per
+// print. The batch is handed to the flush callback when the next print does
+// not fit or goes elsewhere, when it is max_age_ms old, or on
+// bm_print_batcher_flush(). The receiver walks a batch with a
+// BmPrintBatchReader, which yields each print as a BmPrintPublicationView.
+//
+// Single prints carry no pub sub header, so a batch could not be told apart
+// from one on the print topic. Batches are therefore published on their own
+// topic, BM_PRINT_BATCH_TOPIC, and start with a bm_common_pub_sub_header_t
+// holding BM_PRINT_BATCH_PUB_SUB_TYPE and BM_PRINT_BATCH_PUB_SUB_VERSION. A
+// subscriber routes them with a bm_pub_sub_dispatch() route for that type
+// and version with min_len sizeof(bm_print_batch_publication_t), and reads
+// the routed payload with a BmPrintBatchReader.
+
+#define BM_PRINT_BATCH_TOPIC "printf_batch"
+#define BM_PRINT_BATCH_PUB_SUB_TYPE (1)
+#define BM_PRINT_BATCH_PUB_SUB_VERSION (1)
+
+/* buf holds the whole publication, pub sub header included */
+typedef CborError (*BmPrintBatchFlush)(const uint8_t *buf, size_t len,
+                                       void *ctx);
+
+typedef struct {
+  uint8_t *buffer;
+  size_t capacity;
+  size_t len;        // 0 while no batch is open
+  uint64_t opened_ms; // time of the first print in the batch
+  uint32_t max_age_ms;
+  BmPrintBatchFlush flush;
+  void *ctx;
+} BmPrintBatcher;
+
+typedef struct {
+  const uint8_t *buf;
+  size_t offset; // next record
+  uint16_t remaining;
+  uint64_t target_node_id;
+  const char *fname;
+  uint16_t fname_len;
+} BmPrintBatchReader;
+
+void bm_print_batcher_init(BmPrintBatcher *b, uint8_t *buffer, size_t capacity,
+                           uint32_t max_age_ms, BmPrintBatchFlush flush,
+                           void *ctx);
+
+/*!
+ Adds a print taken at now_ms, flushing the open batch first if needed.
+
+ @return CborNoError on success
+         CborErrorDataTooLarge if the print does not fit in an empty batch,
+         publish it alone with bm_print_publication_iov()
+         the flush callback's error; the batch is kept for the next add,
+         poll or flush, and the print is only in it if the failed flush
+         came after adding it
+*/
+CborError bm_print_batcher_add(BmPrintBatcher *b, uint64_t now_ms,
+                               uint64_t target_node_id, const char *fname,
+                               size_t fname_len, const char *data,
+                               size_t data_len, uint8_t print_time);
+
+/* flushes the open batch once it is max_age_ms old */
+CborError bm_print_batcher_poll(BmPrintBatcher *b, uint64_t now_ms);
+
+/* flushes the open batch, if any */
+CborError bm_print_batcher_flush(BmPrintBatcher *b);
+
+/*!
+ Checks a whole batch and prepares to read it. buf is the payload after the
+ pub sub header, e.g. BmPubSubPayload.payload of the batch route. The views
+ the reader returns point into buf.
+
+ @return CborNoError on success
+         CborErrorUnexpectedEOF if buf ends before the last record does
+         CborErrorGarbageAtEnd if buf is longer than the batch
+*/
+CborError bm_print_batch_reader_init(BmPrintBatchReader *r, const uint8_t *buf,
+                                     size_t len);
+
+/* the next print of the batch, false after the last one */
+bool bm_print_batch_reader_next(BmPrintBatchReader *r,
+                                BmPrintPublicationView *view);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,68 @@
+#include "bm_print_publication.h"
+#include <string.h>
+
+CborError bm_print_publication_iov(BmPrintPublicationIov *pub,
+                                   uint64_t target_node_id, const char *fname,
+                                   size_t fname_len, const char *data,
+                                   size_t data_len, uint8_t print_time) {
+  if (fname_len > UINT16_MAX || data_len > UINT16_MAX) {
+    return CborErrorDataTooLarge;
+  }
+
+  pub->header.target_node_id = target_node_id;
+  pub->header.fname_len = (uint16_t)fname_len;
+  pub->header.data_len = (uint16_t)data_len;
+  pub->header.print_time = print_time;
+
+  pub->iov[0].base = &pub->header;
+  pub->iov[0].len = sizeof(pub->header);
+  pub->iov[1].base = fname;
+  pub->iov[1].len = fname_len;
+  pub->iov[2].base = data;
+  pub->iov[2].len = data_len;
+
+  return CborNoError;
+}
+
+size_t bm_iov_gather(const BmIoVec *iov, size_t iovcnt, uint8_t *buf,
+                     size_t size) {
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++) {
+    if (iov[i].len > size - total) {
+      return 0;
+    }
+    if (iov[i].len) {
+      memcpy(buf + total, iov[i].base, iov[i].len);
+    }
+    total += iov[i].len;
+  }
+  return total;
+}
+
+CborError bm_print_publication_parse(const uint8_t *buf, size_t len,
+                                     BmPrintPublicationView *view) {
+  bm_print_publication_t header;
+  if (len < sizeof(header)) {
+    return CborErrorUnexpectedEOF;
+  }
+  memcpy(&header, buf, sizeof(header));
+
+  const size_t needed =
+      bm_print_publication_size(header.fname_len, header.data_len);
+  if (len < needed) {
+    return CborErrorUnexpectedEOF;
+  }
+  if (len > needed) {
+    return CborErrorGarbageAtEnd;
+  }
+
+  const char *fname = (const char *)buf + sizeof(header);
+  view->target_node_id = header.target_node_id;
+  view->print_time = header.print_time;
+  view->fname = header.fname_len ? fname : NULL;
+  view->fname_len = header.fname_len;
+  view->data = header.data_len ? fname + header.fname_len : NULL;
+  view->data_len = header.data_len;
+
+  return CborNoError;
+}
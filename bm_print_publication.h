@@ -0,0 +1,79 @@
+#pragma once
+#include "bm_common_pub_sub.h"
+#include "cbor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Building and reading bm_print_publication_t without copies.
+//
+// A print publication is its fixed header followed by the file name and
+// the printed data. bm_print_publication_iov() describes one as three
+// pieces, the header it fills in plus the caller's name and data, for
+// transports that send scatter-gather lists. bm_iov_gather() writes such
+// a list straight into a transport buffer. On the receiving side
+// bm_print_publication_parse() returns views of the name and data inside
+// the publication.
+
+typedef struct {
+  const void *base;
+  size_t len;
+} BmIoVec;
+
+#define BM_PRINT_PUBLICATION_IOV_COUNT 3 // header, file name, data
+
+typedef struct {
+  bm_print_publication_t header;
+  BmIoVec iov[BM_PRINT_PUBLICATION_IOV_COUNT];
+} BmPrintPublicationIov;
+
+typedef struct {
+  uint64_t target_node_id;
+  uint8_t print_time;
+  const char *fname; // not zero terminated, NULL if fname_len is 0
+  uint16_t fname_len;
+  const char *data; // not zero terminated, NULL if data_len is 0
+  uint16_t data_len;
+} BmPrintPublicationView;
+
+/* encoded size of a publication with the given name and data */
+static inline size_t bm_print_publication_size(size_t fname_len,
+                                               size_t data_len) {
+  return sizeof(bm_print_publication_t) + fname_len + data_len;
+}
+
+/*!
+ Fills pub for a print of data to fname on target_node_id. pub->iov
+ refers to pub->header, fname and data, which must outlive it.
+
+ @return CborNoError, or CborErrorDataTooLarge if fname_len or data_len
+         does not fit in 16 bits
+*/
+CborError bm_print_publication_iov(BmPrintPublicationIov *pub,
+                                   uint64_t target_node_id, const char *fname,
+                                   size_t fname_len, const char *data,
+                                   size_t data_len, uint8_t print_time);
+
+/*!
+ Copies iovcnt pieces into buf back to back.
+
+ @return bytes written, or 0 if they need more than size bytes
+*/
+size_t bm_iov_gather(const BmIoVec *iov, size_t iovcnt, uint8_t *buf,
+                     size_t size);
+
+/*!
+ Reads the print publication in buf. The views point into buf.
+
+ @return CborNoError on success
+         CborErrorUnexpectedEOF if buf ends before the name and data do
+         CborErrorGarbageAtEnd if buf is longer than the publication
+*/
+CborError bm_print_publication_parse(const uint8_t *buf, size_t len,
+                                     BmPrintPublicationView *view);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,12 @@
 
 namespace BmSeapointTurbidityDataMsg {
 
+const BmTemplateField TEMPLATE_FIELDS[NUM_FIELDS] = {
+    SENSOR_HEADER_FIELD_OFFSETS(Data),
+    {"s_signal", BM_FIELD_DOUBLE, offsetof(Data, s_signal)},
+    {"r_signal", BM_FIELD_DOUBLE, offsetof(Data, r_signal)},
+};
+
 CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
                  size_t *encoded_len) {
   CborError err;
@@ -1,6 +1,8 @@
 #pragma once
 #include "cbor.h"
+#include "bm_template_encoder.h"
 #include "sensor_header_msg.h"
+#include "sensor_stats_msg.h"
 
 // For the Seapoint STM-S Turbidity Sensor
 
@@ -15,6 +17,17 @@ struct Data {
   double r_signal;
 };
 
+// Field table for bm_template_encoder, in encode order.
+extern const BmTemplateField TEMPLATE_FIELDS[NUM_FIELDS];
+
+// Fields summarized by SensorStatsMsg::Accumulator
+inline constexpr SensorStatsMsg::Field<Data> STATS_FIELDS[] = {
+    SENSOR_STATS_FIELD(Data, s_signal),
+    SENSOR_STATS_FIELD(Data, r_signal),
+};
+using StatsAccumulator =
+    SensorStatsMsg::Accumulator<Data, sizeof(STATS_FIELDS) / sizeof(STATS_FIELDS[0])>;
+
 CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
                  size_t *encoded_len);
 
@@ -0,0 +1,179 @@
+#include "bm_template_encoder.h"
+#include <string.h>
+
+#if __has_include("bm_config.h")
+#include "bm_config.h"
+#else
+#define bm_debug printf
+#endif
+
+static size_t template_value_size(BmField type) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+    return 1;
+  case BM_FIELD_UINT16:
+    return 2;
+  case BM_FIELD_UINT32:
+  case BM_FIELD_FLOAT:
+    return 4;
+  case BM_FIELD_UINT64:
+  case BM_FIELD_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+static uint8_t template_value_head(BmField type) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+    return 0x18; // unsigned, 1 byte follows
+  case BM_FIELD_UINT16:
+    return 0x19;
+  case BM_FIELD_UINT32:
+    return 0x1a;
+  case BM_FIELD_UINT64:
+    return 0x1b;
+  case BM_FIELD_FLOAT:
+    return 0xfa;
+  case BM_FIELD_DOUBLE:
+    return 0xfb;
+  default:
+    return 0;
+  }
+}
+
+static CborError encode_placeholder(CborEncoder *map_encoder, BmField type) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+    return cbor_encode_uint(map_encoder, UINT8_MAX);
+  case BM_FIELD_UINT16:
+    return cbor_encode_uint(map_encoder, UINT16_MAX);
+  case BM_FIELD_UINT32:
+    return cbor_encode_uint(map_encoder, UINT32_MAX);
+  case BM_FIELD_UINT64:
+    return cbor_encode_uint(map_encoder, UINT64_MAX);
+  case BM_FIELD_FLOAT:
+    return cbor_encode_float(map_encoder, 0.0f);
+  case BM_FIELD_DOUBLE:
+    return cbor_encode_double(map_encoder, 0.0);
+  default:
+    return CborErrorUnsupportedType;
+  }
+}
+
+static void store_be(uint8_t *dst, uint64_t value, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = (uint8_t)(value >> (8 * (n - 1 - i)));
+  }
+}
+
+CborError bm_template_encoder_init(BmTemplateEncoder *t,
+                                   const BmTemplateField *fields,
+                                   size_t num_fields, uint8_t *template_buffer,
+                                   size_t size) {
+  CborError err;
+  CborEncoder encoder, map_encoder;
+
+  if (num_fields > BM_TEMPLATE_MAX_FIELDS) {
+    bm_debug("error: %s: too many fields: %zu\r\n", __func__, num_fields);
+    return CborErrorTooManyItems;
+  }
+
+  memset(t, 0, sizeof(*t));
+  t->fields = fields;
+  t->num_fields = num_fields;
+  t->template_buffer = template_buffer;
+
+  err = encoder_message_create(&encoder, &map_encoder, template_buffer, size,
+                               num_fields);
+
+  // tinycbor picks the shortest integer encoding, so each value is reserved
+  // by encoding the largest value of its type, which needs the full width.
+  // Floats and doubles are always encoded at their own width.
+  for (size_t i = 0; i < num_fields && check_acceptable_encode_errors(err); i++) {
+    const size_t n = template_value_size(fields[i].type);
+    if (n == 0) {
+      bm_debug("error: %s(%s): unsupported template field type\r\n", __func__,
+               fields[i].key);
+      return CborErrorUnsupportedType;
+    }
+    check_and_encode_key(err, cbor_encode_text_stringz(&map_encoder, fields[i].key));
+    check_and_encode_key(err, encode_placeholder(&map_encoder, fields[i].type));
+    if (err != CborNoError) {
+      break;
+    }
+    const size_t end = cbor_encoder_get_buffer_size(&map_encoder, template_buffer);
+    if (template_buffer[end - n - 1] != template_value_head(fields[i].type)) {
+      return CborErrorInternalError;
+    }
+    memset(&template_buffer[end - n], 0, n);
+    t->value_offsets[i] = (uint16_t)(end - n);
+  }
+
+  if (err == CborNoError) {
+    err = encoder_message_finish(&encoder, &map_encoder);
+  }
+  if (err == CborNoError) {
+    t->len = cbor_encoder_get_buffer_size(&encoder, template_buffer);
+  }
+
+  encoder_message_check_memory(&encoder, err);
+
+  return err;
+}
+
+void bm_template_encoder_patch(const BmTemplateEncoder *t, uint8_t *cbor_buffer,
+                               const void *src) {
+  const uint8_t *base = (const uint8_t *)src;
+  for (size_t i = 0; i < t->num_fields; i++) {
+    const BmTemplateField *f = &t->fields[i];
+    uint8_t *dst = &cbor_buffer[t->value_offsets[i]];
+    switch (f->type) {
+    case BM_FIELD_UINT8:
+      *dst = base[f->offset];
+      break;
+    case BM_FIELD_UINT16: {
+      uint16_t v;
+      memcpy(&v, base + f->offset, sizeof(v));
+      store_be(dst, v, sizeof(v));
+      break;
+    }
+    case BM_FIELD_UINT32:
+    case BM_FIELD_FLOAT: {
+      // floats are stored by their bit pattern
+      uint32_t v;
+      memcpy(&v, base + f->offset, sizeof(v));
+      store_be(dst, v, sizeof(v));
+      break;
+    }
+    case BM_FIELD_UINT64:
+    case BM_FIELD_DOUBLE: {
+      uint64_t v;
+      memcpy(&v, base + f->offset, sizeof(v));
+      store_be(dst, v, sizeof(v));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+CborError bm_template_encode(const BmTemplateEncoder *t, const void *src,
+                             uint8_t *cbor_buffer, size_t size,
+                             size_t *encoded_len) {
+  if (!t->len) {
+    return CborErrorInternalError;
+  }
+  if (size < t->len) {
+    bm_debug("error: %s: extra_bytes_needed: %zu\r\n", __func__, t->len - size);
+    return CborErrorOutOfMemory;
+  }
+  if (cbor_buffer != t->template_buffer) {
+    memcpy(cbor_buffer, t->template_buffer, t->len);
+  }
+  bm_template_encoder_patch(t, cbor_buffer, src);
+  *encoded_len = t->len;
+  return CborNoError;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "bm_messages_helper.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Template-patch encoder for messages whose fields are all fixed width.
+//
+// Every value is written with a fixed size head (uint8 -> 2 bytes,
+// uint16 -> 3, uint32 -> 5, uint64 -> 9, float -> 5, double -> 9) instead
+// of the shortest form, so the encoded layout never changes. The map header,
+// keys and value heads are built once; each encode only stores the value
+// bytes at their known offsets. The output is valid CBOR and is decoded by
+// the regular message decoders.
+
+#define BM_TEMPLATE_MAX_FIELDS (32)
+
+typedef struct {
+  const char *key;
+  BmField type;  // BM_FIELD_UINT8..BM_FIELD_DOUBLE
+  size_t offset; // offsetof(<message struct>, <field>)
+} BmTemplateField;
+
+typedef struct {
+  const BmTemplateField *fields;
+  size_t num_fields;
+  const uint8_t *template_buffer; // holds the pre-built encoding
+  size_t len;                     // encoded length, identical on every encode
+  uint16_t value_offsets[BM_TEMPLATE_MAX_FIELDS]; // start of each value's payload
+} BmTemplateEncoder;
+
+CborError bm_template_encoder_init(BmTemplateEncoder *t,
+                                   const BmTemplateField *fields,
+                                   size_t num_fields, uint8_t *template_buffer,
+                                   size_t size);
+
+// Patches the values of src into a buffer that already holds the template,
+// e.g. the template buffer itself or the output of a previous encode.
+void bm_template_encoder_patch(const BmTemplateEncoder *t, uint8_t *cbor_buffer,
+                               const void *src);
+
+// Copies the template into cbor_buffer (unless it is the template buffer)
+// and patches in the values of src.
+CborError bm_template_encode(const BmTemplateEncoder *t, const void *src,
+                             uint8_t *cbor_buffer, size_t size,
+                             size_t *encoded_len);
+
+#ifdef __cplusplus
+}
+#endif
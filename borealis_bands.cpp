@@ -0,0 +1,103 @@
+#include "borealis_bands.h"
+#include "borealis_level_sketch.h"
+#include <math.h>
+#include <string.h>
+
+float borealis_band_center_hz(uint8_t bands_per_octave, uint8_t band) {
+    return 1000.0f * exp2f(((float)band - 10.0f * bands_per_octave) / bands_per_octave);
+}
+
+bool borealis_band_table_init(struct borealis_band_table * t, float df, uint8_t bands_per_octave, size_t num_bins) {
+    memset(t, 0, sizeof(*t));
+    if (!(df > 0.0f) || bands_per_octave == 0 || num_bins < 2 || num_bins > UINT16_MAX) {
+        return false;
+    }
+    t->df = df;
+    t->bands_per_octave = bands_per_octave;
+    t->num_bins = (uint16_t)num_bins;
+
+    const double half_band = exp2(0.5 / bands_per_octave);
+    for (unsigned b = 0; b <= UINT8_MAX && t->num_bands < BOREALIS_BAND_TABLE_MAX_BANDS; b++) {
+        const double center = borealis_band_center_hz(bands_per_octave, (uint8_t)b);
+        /* band edges in bin coordinates, bin k spans [k, k + 1) */
+        const double lo = center / half_band / df + 0.5;
+        const double hi = center * half_band / df + 0.5;
+        if (lo < 1.0) {
+            /* reaches into the DC bin */
+            continue;
+        }
+        if (hi > num_bins) {
+            break;
+        }
+        if (t->num_bands == 0) {
+            t->first_band_index = (uint8_t)b;
+        }
+
+        const uint8_t i = t->num_bands++;
+        const uint16_t first = (uint16_t)floor(lo);
+        uint16_t last = (uint16_t)floor(hi);
+        if (last == hi) {
+            last--;
+        }
+        t->first_bin[i] = first;
+        t->last_bin[i] = last;
+        if (first == last) {
+            t->first_weight[i] = (float)(hi - lo);
+            t->last_weight[i] = 0.0f;
+        } else {
+            t->first_weight[i] = (float)(first + 1 - lo);
+            t->last_weight[i] = (float)(hi - last);
+        }
+    }
+
+    return t->num_bands > 0;
+}
+
+/* four independent accumulators so the compiler can keep the sum in vector registers */
+static float sum_bins(const float * p, size_t n) {
+    float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += p[i];
+        a1 += p[i + 1];
+        a2 += p[i + 2];
+        a3 += p[i + 3];
+    }
+    for (; i < n; i++) {
+        a0 += p[i];
+    }
+    return (a0 + a1) + (a2 + a3);
+}
+
+void borealis_band_levels_db(const struct borealis_band_table * t, const float * psd, float * db) {
+    for (uint8_t i = 0; i < t->num_bands; i++) {
+        const uint16_t first = t->first_bin[i];
+        const uint16_t last = t->last_bin[i];
+        float power = t->first_weight[i] * psd[first];
+        if (last > first) {
+            power += sum_bins(&psd[first + 1], last - first - 1) + t->last_weight[i] * psd[last];
+        }
+        power *= t->df;
+        db[i] = power > 0.0f ? 10.0f * log10f(power) : -INFINITY;
+    }
+}
+
+bool borealis_band_levels(const struct borealis_band_table * t, const struct borealis_spectrum_data * spectrum, const float * psd, struct borealis_levels * levels, uint8_t * levels_buffer, size_t capacity) {
+    const size_t len = (size_t)t->num_bands * BOREALIS_LEVEL_BYTES_PER_BAND;
+    if (spectrum->df != t->df || spectrum->bands_per_octave != t->bands_per_octave || capacity < len) {
+        return false;
+    }
+
+    float db[BOREALIS_BAND_TABLE_MAX_BANDS];
+    borealis_band_levels_db(t, psd, db);
+    borealis_levels_pack_db(db, t->num_bands, levels_buffer);
+
+    levels->header = spectrum->header;
+    levels->header.version = BOREALIS_LEVELS_MSG_VERSION_BINARY;
+    levels->dt = spectrum->dt;
+    levels->first_band_index = t->first_band_index;
+    levels->level_data = levels_buffer;
+    levels->levels_length = len;
+
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "bm_borealis.h"
+#include <stdbool.h>
+
+// Fractional-octave band levels from a BOREALIS power spectrum.
+//
+// Bands are numbered as in ANSI S1.11 with base 2 octaves: band
+// 10 * bands_per_octave is centered on 1 kHz and band b on
+// 1000 * 2^((b - 10 * bands_per_octave) / bands_per_octave) Hz, with edges
+// half a band either side. Spectrum bin k is centered on k * df and is df
+// wide; bins straddling a band edge contribute in proportion to their
+// overlap, so band power is exact for a flat spectrum.
+//
+// The band edges and bin weights for a df/bands_per_octave/number of bins
+// are computed once into a borealis_band_table. Each spectrum is then a
+// single pass summing contiguous runs of bins with no per-bin math.
+
+#ifndef BOREALIS_BAND_TABLE_MAX_BANDS
+#define BOREALIS_BAND_TABLE_MAX_BANDS 64
+#endif
+
+struct borealis_band_table {
+  float df;
+  uint8_t bands_per_octave;
+  uint8_t first_band_index;
+  uint8_t num_bands;
+  uint16_t num_bins;
+  uint16_t first_bin[BOREALIS_BAND_TABLE_MAX_BANDS];
+  uint16_t last_bin[BOREALIS_BAND_TABLE_MAX_BANDS];
+  float first_weight[BOREALIS_BAND_TABLE_MAX_BANDS];
+  float last_weight[BOREALIS_BAND_TABLE_MAX_BANDS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Build the table for spectra of num_bins bins spaced df Hz apart, starting
+ * at 0 Hz. Only bands lying entirely between the first bin and the last bin
+ * are included, lowest first, up to BOREALIS_BAND_TABLE_MAX_BANDS of them.
+ * Returns false if no band fits or the arguments are out of range.
+ */
+bool borealis_band_table_init(struct borealis_band_table *t, float df,
+                              uint8_t bands_per_octave, size_t num_bins);
+
+/* center frequency of band in Hz */
+float borealis_band_center_hz(uint8_t bands_per_octave, uint8_t band);
+
+/*
+ * Convert a spectrum of t->num_bins power spectral density values (per Hz,
+ * linear) into band levels in dB, 10 * log10 of the band power. The result
+ * is a version 2 borealis_levels with the header and dt of spectrum, whose
+ * level data is packed into levels_buffer (see borealis_levels_pack_db).
+ * Returns false if spectrum's df/bands_per_octave do not match the table or
+ * levels_buffer is too small.
+ */
+bool borealis_band_levels(const struct borealis_band_table *t,
+                          const struct borealis_spectrum_data *spectrum,
+                          const float *psd, struct borealis_levels *levels,
+                          uint8_t *levels_buffer, size_t capacity);
+
+/* as above, but just the band levels in dB, t->num_bands of them */
+void borealis_band_levels_db(const struct borealis_band_table *t,
+                             const float *psd, float *db);
+
+#ifdef __cplusplus
+}
+#endif
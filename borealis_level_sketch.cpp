@@ -0,0 +1,177 @@
+#include "borealis_level_sketch.h"
+#include "bm_base64.h"
+#include <math.h>
+#include <string.h>
+
+#define LAST_MARKER (BOREALIS_LEVEL_SKETCH_MARKERS - 1)
+
+/* markers sit at p = 0, 1/8, 1/4 ... 1, so Q1, median and Q3 are markers 2, 4 and 6 */
+static float marker_p(int i) {
+    return (float)i / LAST_MARKER;
+}
+
+static void band_add_initial(struct borealis_level_sketch_band * b, uint32_t count, float x) {
+    /* insertion sort the first few observations, they seed the markers */
+    int i = (int)count;
+    while (i > 0 && b->height[i - 1] > x) {
+        b->height[i] = b->height[i - 1];
+        i--;
+    }
+    b->height[i] = x;
+    if (count == LAST_MARKER) {
+        for (int m = 0; m < BOREALIS_LEVEL_SKETCH_MARKERS; m++) {
+            b->position[m] = m + 1;
+        }
+    }
+}
+
+static float parabolic(const struct borealis_level_sketch_band * b, int i, int d) {
+    const float *q = b->height;
+    const int32_t *n = b->position;
+    return q[i] + (float)d / (n[i + 1] - n[i - 1]) *
+        ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+         (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static void band_add(struct borealis_level_sketch_band * b, uint32_t count, float x) {
+    float *q = b->height;
+    int32_t *n = b->position;
+
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[LAST_MARKER]) {
+        q[LAST_MARKER] = x;
+        k = LAST_MARKER - 1;
+    } else {
+        k = 0;
+        while (x >= q[k + 1]) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < BOREALIS_LEVEL_SKETCH_MARKERS; i++) {
+        n[i]++;
+    }
+
+    /* count now includes x */
+    for (int i = 1; i < LAST_MARKER; i++) {
+        const float desired = 1.0f + (count - 1) * marker_p(i);
+        const float d = desired - n[i];
+        if ((d >= 1.0f && n[i + 1] - n[i] > 1) || (d <= -1.0f && n[i - 1] - n[i] < -1)) {
+            const int ds = d > 0 ? 1 : -1;
+            float h = parabolic(b, i, ds);
+            if (!(q[i - 1] < h && h < q[i + 1])) {
+                h = q[i] + ds * (q[i + ds] - q[i]) / (n[i + ds] - n[i]);
+            }
+            q[i] = h;
+            n[i] += ds;
+        }
+    }
+}
+
+void borealis_level_sketch_reset(struct borealis_level_sketch * s) {
+    memset(s, 0, sizeof(*s));
+}
+
+bool borealis_level_sketch_add(struct borealis_level_sketch * s, const struct borealis_levels * levels) {
+    uint8_t decoded[BOREALIS_LEVEL_SKETCH_MAX_BANDS * BOREALIS_LEVEL_BYTES_PER_BAND];
+    const uint8_t *payload = levels->level_data;
+    size_t len = levels->levels_length;
+
+    if (levels->header.version < BOREALIS_LEVELS_MSG_VERSION_BINARY) {
+        if (bm_base64_decoded_len(levels->levels, len) > sizeof(decoded) ||
+            !bm_base64_decode(levels->levels, len, decoded, &len)) {
+            return false;
+        }
+        payload = decoded;
+    }
+
+    if (len % BOREALIS_LEVEL_BYTES_PER_BAND || len == 0 ||
+        len > BOREALIS_LEVEL_SKETCH_MAX_BANDS * BOREALIS_LEVEL_BYTES_PER_BAND) {
+        return false;
+    }
+    const uint8_t num_bands = (uint8_t)(len / BOREALIS_LEVEL_BYTES_PER_BAND);
+    if (s->count == 0) {
+        s->first_band_index = levels->first_band_index;
+        s->num_bands = num_bands;
+    } else if (s->first_band_index != levels->first_band_index || s->num_bands != num_bands) {
+        return false;
+    }
+
+    float db[BOREALIS_LEVEL_SKETCH_MAX_BANDS];
+    borealis_levels_unpack_db(payload, num_bands, db);
+
+    for (uint8_t i = 0; i < num_bands; i++) {
+        if (s->count < BOREALIS_LEVEL_SKETCH_MARKERS) {
+            band_add_initial(&s->bands[i], s->count, db[i]);
+        } else {
+            band_add(&s->bands[i], s->count + 1, db[i]);
+        }
+    }
+    s->count++;
+    s->header = levels->header;
+    s->dt = levels->dt;
+
+    return true;
+}
+
+float borealis_level_sketch_quantile(const struct borealis_level_sketch * s, uint8_t band, float p) {
+    if (s->count == 0 || band >= s->num_bands) {
+        return NAN;
+    }
+    const float *q = s->bands[band].height;
+    const uint32_t n = s->count < BOREALIS_LEVEL_SKETCH_MARKERS ? s->count : BOREALIS_LEVEL_SKETCH_MARKERS;
+
+    /* before the sketch fills, q holds the sorted observations; after, the markers */
+    const float h = p * (s->count < BOREALIS_LEVEL_SKETCH_MARKERS ? n - 1 : LAST_MARKER);
+    const uint32_t lo = (uint32_t)h;
+    if (lo + 1 >= n) {
+        return q[n - 1];
+    }
+    return q[lo] + (h - lo) * (q[lo + 1] - q[lo]);
+}
+
+bool borealis_level_sketch_report(const struct borealis_level_sketch * s, struct borealis_level_statistics * stats, uint8_t * levels_buffer, size_t capacity) {
+    const size_t len = (size_t)s->num_bands * BOREALIS_LEVEL_BYTES_PER_BAND;
+    if (s->count == 0 || capacity < len) {
+        return false;
+    }
+
+    float median[BOREALIS_LEVEL_SKETCH_MAX_BANDS];
+    float max_iqr = 0.0f;
+    for (uint8_t i = 0; i < s->num_bands; i++) {
+        median[i] = borealis_level_sketch_quantile(s, i, 0.5f);
+        const float iqr = borealis_level_sketch_quantile(s, i, 0.75f) - borealis_level_sketch_quantile(s, i, 0.25f);
+        max_iqr = iqr > max_iqr ? iqr : max_iqr;
+    }
+    borealis_levels_pack_db(median, s->num_bands, levels_buffer);
+
+    stats->header = s->header;
+    stats->header.version = BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY;
+    stats->dt = s->dt;
+    stats->dt_report = s->dt * s->count;
+    stats->first_band_index = s->first_band_index;
+    stats->level_data = levels_buffer;
+    stats->levels_length = len;
+    stats->max_iqr = max_iqr;
+
+    return true;
+}
+
+void borealis_levels_pack_db(const float * db, size_t num_bands, uint8_t * out) {
+    for (size_t i = 0; i < num_bands; i++) {
+        float v = roundf(db[i] * BOREALIS_LEVEL_DB_SCALE);
+        v = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+        const uint16_t u = (uint16_t)(int16_t)v;
+        out[2 * i] = (uint8_t)u;
+        out[2 * i + 1] = (uint8_t)(u >> 8);
+    }
+}
+
+void borealis_levels_unpack_db(const uint8_t * in, size_t num_bands, float * db) {
+    for (size_t i = 0; i < num_bands; i++) {
+        const int16_t v = (int16_t)(in[2 * i] | (in[2 * i + 1] << 8));
+        db[i] = v / BOREALIS_LEVEL_DB_SCALE;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "bm_borealis.h"
+#include <stdbool.h>
+
+// Streaming per-band level statistics for BOREALIS.
+//
+// Each band keeps an extended P-square sketch (Raatikainen) with nine
+// markers tracking the quartiles, so a borealis_level_statistics report
+// over any number of borealis_levels records needs fixed memory: no levels
+// vectors are buffered for the report window.
+//
+// Levels payloads (the bytes of borealis_levels.level_data) are one signed
+// 16 bit little endian value per band in hundredths of a dB, starting at
+// first_band_index. Version 1 (base64) records are decoded before use.
+
+#ifndef BOREALIS_LEVEL_SKETCH_MAX_BANDS
+#define BOREALIS_LEVEL_SKETCH_MAX_BANDS 64
+#endif
+#define BOREALIS_LEVEL_SKETCH_MARKERS 9
+#define BOREALIS_LEVEL_DB_SCALE 100.0f
+#define BOREALIS_LEVEL_BYTES_PER_BAND 2
+
+struct borealis_level_sketch_band {
+  float height[BOREALIS_LEVEL_SKETCH_MARKERS];
+  int32_t position[BOREALIS_LEVEL_SKETCH_MARKERS];
+};
+
+struct borealis_level_sketch {
+#ifdef __cplusplus
+  SensorHeaderMsg::Data header; // of the last record added
+#else
+  struct sensor_header_msg_data header;
+#endif
+  float dt;
+  uint8_t first_band_index;
+  uint8_t num_bands;
+  uint32_t count;
+  struct borealis_level_sketch_band bands[BOREALIS_LEVEL_SKETCH_MAX_BANDS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void borealis_level_sketch_reset(struct borealis_level_sketch *s);
+
+/*
+ * Add one levels record. The first record after a reset fixes the band
+ * layout; later records must have the same first_band_index and number of
+ * bands. Returns false, leaving the sketch unchanged, if they do not, if
+ * there are more than BOREALIS_LEVEL_SKETCH_MAX_BANDS bands or if the
+ * payload is malformed.
+ */
+bool borealis_level_sketch_add(struct borealis_level_sketch *s,
+                               const struct borealis_levels *levels);
+
+/*
+ * Estimate quantile p (0.25, 0.5 or 0.75) of a band in dB. The estimate is
+ * exact until the sketch holds more than BOREALIS_LEVEL_SKETCH_MARKERS
+ * records. Returns NAN if the sketch is empty or the band is out of range.
+ */
+float borealis_level_sketch_quantile(const struct borealis_level_sketch *s,
+                                     uint8_t band, float p);
+
+/*
+ * Fill a level statistics report for the records added since the last
+ * reset: the median level of each band, packed into levels_buffer, and the
+ * largest interquartile range over the bands as max_iqr. dt_report is the
+ * time covered, count * dt. Returns false if the sketch is empty or
+ * levels_buffer holds fewer than num_bands * BOREALIS_LEVEL_BYTES_PER_BAND
+ * bytes. The sketch is not reset.
+ */
+bool borealis_level_sketch_report(const struct borealis_level_sketch *s,
+                                  struct borealis_level_statistics *stats,
+                                  uint8_t *levels_buffer, size_t capacity);
+
+/* conversions between levels payload bytes and dB */
+void borealis_levels_pack_db(const float *db, size_t num_bands, uint8_t *out);
+void borealis_levels_unpack_db(const uint8_t *in, size_t num_bands, float *db);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,475 @@
+#include "columnar_archive.h"
+#include "aanderaa_conductivity_msg.h"
+#include "bm_config.h"
+#include "pme_dissolved_oxygen_msg.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#ifndef CI_TEST
+#include "bm_os.h"
+#else
+#include <stdlib.h>
+#endif
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define COLUMNAR_ARCHIVE_HAS_MMAP 1
+#endif
+
+namespace ColumnarArchive {
+
+static size_t align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+static size_t field_width(BmField type) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+    return sizeof(uint8_t);
+  case BM_FIELD_UINT16:
+    return sizeof(uint16_t);
+  case BM_FIELD_UINT32:
+    return sizeof(uint32_t);
+  case BM_FIELD_UINT64:
+    return sizeof(uint64_t);
+  case BM_FIELD_FLOAT:
+    return sizeof(float);
+  case BM_FIELD_DOUBLE:
+    return sizeof(double);
+  default:
+    return 0;
+  }
+}
+
+static double field_as_double(BmField type, const uint8_t *src) {
+  switch (type) {
+  case BM_FIELD_UINT8:
+    return *src;
+  case BM_FIELD_UINT16: {
+    uint16_t v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+  }
+  case BM_FIELD_UINT32: {
+    uint32_t v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+  }
+  case BM_FIELD_UINT64: {
+    uint64_t v;
+    memcpy(&v, src, sizeof(v));
+    return static_cast<double>(v);
+  }
+  case BM_FIELD_FLOAT: {
+    float v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+  }
+  case BM_FIELD_DOUBLE: {
+    double v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+  }
+  default:
+    return NAN;
+  }
+}
+
+static Error_t build_header(FileHeader &h, const Schema &schema,
+                            uint32_t rows_per_block) {
+  if (schema.num_columns == 0 || schema.num_columns > MAX_COLUMNS ||
+      rows_per_block == 0 || strlen(schema.message_type) >= MAX_NAME_LEN) {
+    return ERR_UNSUPPORTED;
+  }
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.format_version = FORMAT_VERSION;
+  h.message_version = schema.message_version;
+  strncpy(h.message_type, schema.message_type, MAX_NAME_LEN - 1);
+  h.num_columns = static_cast<uint32_t>(schema.num_columns);
+  h.rows_per_block = rows_per_block;
+  h.header_size = align8(sizeof(FileHeader));
+
+  uint64_t offset = align8(sizeof(BlockHeader));
+  for (size_t i = 0; i < schema.num_columns; i++) {
+    const Column &c = schema.columns[i];
+    const size_t width = field_width(c.type);
+    if (width == 0 || strlen(c.name) >= MAX_NAME_LEN) {
+      return ERR_UNSUPPORTED;
+    }
+    strncpy(h.columns[i].name, c.name, MAX_NAME_LEN - 1);
+    h.columns[i].type = c.type;
+    h.columns[i].width = static_cast<uint32_t>(width);
+    h.columns[i].offset = offset;
+    offset += align8(width * rows_per_block);
+  }
+  h.block_size = offset;
+
+  return OK;
+}
+
+static Error_t validate_header(const FileHeader &h, size_t file_size) {
+  if (file_size < sizeof(FileHeader) || memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      h.format_version != FORMAT_VERSION || h.num_columns == 0 ||
+      h.num_columns > MAX_COLUMNS || h.rows_per_block == 0 ||
+      h.header_size < sizeof(FileHeader) || h.header_size > file_size ||
+      h.block_size < sizeof(BlockHeader) || h.message_type[MAX_NAME_LEN - 1] != '\0') {
+    return ERR_FORMAT;
+  }
+  for (uint32_t i = 0; i < h.num_columns; i++) {
+    const ColumnHeader &c = h.columns[i];
+    // columns follow the block header and must fit in the block, the
+    // subtraction cannot wrap once offset is known to be inside it
+    if (c.width != field_width(static_cast<BmField>(c.type)) ||
+        c.offset < sizeof(BlockHeader) || c.offset > h.block_size ||
+        static_cast<uint64_t>(c.width) * h.rows_per_block > h.block_size - c.offset ||
+        c.name[MAX_NAME_LEN - 1] != '\0') {
+      return ERR_FORMAT;
+    }
+  }
+  if ((file_size - h.header_size) % h.block_size != 0) {
+    return ERR_FORMAT;
+  }
+  return OK;
+}
+
+static Error_t check_schema(const FileHeader &h, const Schema &schema) {
+  if (strcmp(h.message_type, schema.message_type) != 0 ||
+      h.message_version != schema.message_version ||
+      h.num_columns != schema.num_columns) {
+    return ERR_SCHEMA_MISMATCH;
+  }
+  for (size_t i = 0; i < schema.num_columns; i++) {
+    if (strcmp(h.columns[i].name, schema.columns[i].name) != 0 ||
+        h.columns[i].type != static_cast<uint32_t>(schema.columns[i].type)) {
+      return ERR_SCHEMA_MISMATCH;
+    }
+  }
+  return OK;
+}
+
+static void reset_block(Writer &w) {
+  memset(w.block, 0, w.header.block_size);
+  BlockHeader *bh = reinterpret_cast<BlockHeader *>(w.block);
+  for (uint32_t i = 0; i < w.header.num_columns; i++) {
+    bh->ranges[i].min = INFINITY;
+    bh->ranges[i].max = -INFINITY;
+  }
+}
+
+static Error_t write_block(Writer &w) {
+  const uint64_t pos = w.header.header_size + w.block_index * w.header.block_size;
+  if (fseek(w.file, static_cast<long>(pos), SEEK_SET) != 0 ||
+      fwrite(w.block, 1, w.header.block_size, w.file) != w.header.block_size) {
+    bm_debug("columnar archive: failed to write block %llu\n",
+             static_cast<unsigned long long>(w.block_index));
+    return ERR_IO;
+  }
+  return OK;
+}
+
+// closes without writing back the block being filled
+static void writer_abort(Writer &w) {
+  fclose(w.file);
+  w.file = NULL;
+#ifndef CI_TEST
+  bm_free(w.block);
+#else
+  free(w.block);
+#endif
+  w.block = NULL;
+}
+
+Error_t writer_open(Writer &w, const char *path, const Schema &schema,
+                    uint32_t rows_per_block) {
+  Error_t err;
+  memset(&w, 0, sizeof(w));
+  w.schema = &schema;
+
+  w.file = fopen(path, "r+b");
+  if (w.file) {
+    // existing archive, continue where it left off
+    if (fread(&w.header, sizeof(w.header), 1, w.file) != 1 ||
+        fseek(w.file, 0, SEEK_END) != 0) {
+      fclose(w.file);
+      w.file = NULL;
+      return ERR_FORMAT;
+    }
+    const long file_size = ftell(w.file);
+    if (file_size < 0) {
+      fclose(w.file);
+      w.file = NULL;
+      return ERR_IO;
+    }
+    if ((err = validate_header(w.header, static_cast<size_t>(file_size))) != OK ||
+        (err = check_schema(w.header, schema)) != OK) {
+      fclose(w.file);
+      w.file = NULL;
+      return err;
+    }
+    w.block_index = (static_cast<uint64_t>(file_size) - w.header.header_size) /
+                    w.header.block_size;
+  } else {
+    if ((err = build_header(w.header, schema, rows_per_block)) != OK) {
+      return err;
+    }
+    w.file = fopen(path, "w+b");
+    if (!w.file) {
+      return ERR_IO;
+    }
+    // pad the header out to header_size
+    static const uint8_t zeros[8] = {0};
+    if (fwrite(&w.header, sizeof(w.header), 1, w.file) != 1 ||
+        fwrite(zeros, 1, w.header.header_size - sizeof(w.header), w.file) !=
+            w.header.header_size - sizeof(w.header)) {
+      fclose(w.file);
+      w.file = NULL;
+      return ERR_IO;
+    }
+  }
+
+#ifndef CI_TEST
+  w.block = static_cast<uint8_t *>(bm_malloc(w.header.block_size));
+#else
+  w.block = static_cast<uint8_t *>(malloc(w.header.block_size));
+#endif
+  if (!w.block) {
+    fclose(w.file);
+    w.file = NULL;
+    return ERR_NO_MEMORY;
+  }
+  reset_block(w);
+
+  if (w.block_index > 0) {
+    // reload the last block if it still has room
+    const uint64_t last = w.block_index - 1;
+    const uint64_t pos = w.header.header_size + last * w.header.block_size;
+    if (fseek(w.file, static_cast<long>(pos), SEEK_SET) != 0 ||
+        fread(w.block, 1, w.header.block_size, w.file) != w.header.block_size) {
+      writer_abort(w);
+      return ERR_IO;
+    }
+    const uint32_t num_rows = reinterpret_cast<BlockHeader *>(w.block)->num_rows;
+    if (num_rows > w.header.rows_per_block) {
+      writer_abort(w);
+      return ERR_FORMAT;
+    }
+    if (num_rows < w.header.rows_per_block) {
+      w.block_index = last;
+    } else {
+      reset_block(w);
+    }
+  }
+
+  return OK;
+}
+
+Error_t writer_append(Writer &w, const void *row) {
+  if (!w.file || !w.block) {
+    return ERR_IO;
+  }
+
+  BlockHeader *bh = reinterpret_cast<BlockHeader *>(w.block);
+  const uint8_t *src = static_cast<const uint8_t *>(row);
+  for (uint32_t i = 0; i < w.header.num_columns; i++) {
+    const ColumnHeader &c = w.header.columns[i];
+    const uint8_t *field = src + w.schema->columns[i].offset;
+    memcpy(w.block + c.offset + static_cast<uint64_t>(bh->num_rows) * c.width, field,
+           c.width);
+    const double v = field_as_double(static_cast<BmField>(c.type), field);
+    if (v < bh->ranges[i].min) {
+      bh->ranges[i].min = v;
+    }
+    if (v > bh->ranges[i].max) {
+      bh->ranges[i].max = v;
+    }
+  }
+  bh->num_rows++;
+
+  if (bh->num_rows == w.header.rows_per_block) {
+    Error_t err = write_block(w);
+    if (err != OK) {
+      return err;
+    }
+    w.block_index++;
+    reset_block(w);
+  }
+  return OK;
+}
+
+Error_t writer_flush(Writer &w) {
+  if (!w.file || !w.block) {
+    return ERR_IO;
+  }
+  if (reinterpret_cast<BlockHeader *>(w.block)->num_rows > 0) {
+    Error_t err = write_block(w);
+    if (err != OK) {
+      return err;
+    }
+  }
+  return fflush(w.file) == 0 ? OK : ERR_IO;
+}
+
+Error_t writer_close(Writer &w) {
+  Error_t err = OK;
+  if (w.file) {
+    if (w.block) {
+      err = writer_flush(w);
+    }
+    if (fclose(w.file) != 0 && err == OK) {
+      err = ERR_IO;
+    }
+    w.file = NULL;
+  }
+#ifndef CI_TEST
+  bm_free(w.block);
+#else
+  free(w.block);
+#endif
+  w.block = NULL;
+  return err;
+}
+
+Error_t reader_open(Reader &r, const char *path) {
+  memset(&r, 0, sizeof(r));
+#ifdef COLUMNAR_ARCHIVE_HAS_MMAP
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return ERR_IO;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+    close(fd);
+    return ERR_FORMAT;
+  }
+  void *base = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (base == MAP_FAILED) {
+    return ERR_IO;
+  }
+
+  r.base = static_cast<const uint8_t *>(base);
+  r.size = static_cast<size_t>(st.st_size);
+  r.header = reinterpret_cast<const FileHeader *>(r.base);
+  Error_t err = validate_header(*r.header, r.size);
+  if (err != OK) {
+    reader_close(r);
+    return err;
+  }
+  r.num_blocks = (r.size - r.header->header_size) / r.header->block_size;
+  // readers walk each column up to num_rows, so check every block once here
+  for (uint64_t i = 0; i < r.num_blocks; i++) {
+    if (reader_block(r, i)->num_rows > r.header->rows_per_block) {
+      reader_close(r);
+      return ERR_FORMAT;
+    }
+  }
+  return OK;
+#else
+  (void)path;
+  return ERR_UNSUPPORTED;
+#endif
+}
+
+Error_t reader_open(Reader &r, const char *path, const Schema &schema) {
+  Error_t err = reader_open(r, path);
+  if (err == OK && (err = check_schema(*r.header, schema)) != OK) {
+    reader_close(r);
+  }
+  return err;
+}
+
+void reader_close(Reader &r) {
+#ifdef COLUMNAR_ARCHIVE_HAS_MMAP
+  if (r.base) {
+    munmap(const_cast<uint8_t *>(r.base), r.size);
+  }
+#endif
+  memset(&r, 0, sizeof(r));
+}
+
+uint64_t reader_num_rows(const Reader &r) {
+  uint64_t rows = 0;
+  for (uint64_t i = 0; i < r.num_blocks; i++) {
+    rows += reader_block(r, i)->num_rows;
+  }
+  return rows;
+}
+
+int reader_find_column(const Reader &r, const char *name) {
+  for (uint32_t i = 0; i < r.header->num_columns; i++) {
+    if (strcmp(r.header->columns[i].name, name) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+const BlockHeader *reader_block(const Reader &r, uint64_t block_index) {
+  if (block_index >= r.num_blocks) {
+    return NULL;
+  }
+  return reinterpret_cast<const BlockHeader *>(
+      r.base + r.header->header_size + block_index * r.header->block_size);
+}
+
+const void *reader_column(const Reader &r, uint64_t block_index, size_t col) {
+  const BlockHeader *bh = reader_block(r, block_index);
+  if (!bh || col >= r.header->num_columns) {
+    return NULL;
+  }
+  return reinterpret_cast<const uint8_t *>(bh) + r.header->columns[col].offset;
+}
+
+bool reader_block_may_contain(const Reader &r, uint64_t block_index, size_t col,
+                              double lo, double hi) {
+  const BlockHeader *bh = reader_block(r, block_index);
+  if (!bh || col >= r.header->num_columns || bh->num_rows == 0) {
+    return false;
+  }
+  return bh->ranges[col].max >= lo && bh->ranges[col].min <= hi;
+}
+
+static const Column aanderaa_conductivity_columns[] = {
+    SENSOR_HEADER_FIELD_OFFSETS(AanderaaConductivityMsg::Data),
+    {"conductivity_ms_cm", BM_FIELD_DOUBLE,
+     offsetof(AanderaaConductivityMsg::Data, conductivity_ms_cm)},
+    {"temperature_deg_c", BM_FIELD_DOUBLE,
+     offsetof(AanderaaConductivityMsg::Data, temperature_deg_c)},
+    {"salinity_psu", BM_FIELD_DOUBLE, offsetof(AanderaaConductivityMsg::Data, salinity_psu)},
+    {"water_density_kg_m3", BM_FIELD_DOUBLE,
+     offsetof(AanderaaConductivityMsg::Data, water_density_kg_m3)},
+    {"sound_speed_m_s", BM_FIELD_DOUBLE,
+     offsetof(AanderaaConductivityMsg::Data, sound_speed_m_s)},
+    {"depth_m", BM_FIELD_FLOAT, offsetof(AanderaaConductivityMsg::Data, depth_m)},
+};
+
+const Schema AANDERAA_CONDUCTIVITY_SCHEMA = {
+    "aanderaa_conductivity",
+    AanderaaConductivityMsg::VERSION,
+    aanderaa_conductivity_columns,
+    sizeof(aanderaa_conductivity_columns) / sizeof(aanderaa_conductivity_columns[0]),
+};
+
+static const Column pme_dissolved_oxygen_columns[] = {
+    SENSOR_HEADER_FIELD_OFFSETS(PmeDissolvedOxygenMsg::Data),
+    {"temperature_deg_c", BM_FIELD_DOUBLE,
+     offsetof(PmeDissolvedOxygenMsg::Data, temperature_deg_c)},
+    {"do_mg_per_l", BM_FIELD_DOUBLE, offsetof(PmeDissolvedOxygenMsg::Data, do_mg_per_l)},
+    {"quality", BM_FIELD_DOUBLE, offsetof(PmeDissolvedOxygenMsg::Data, quality)},
+    {"do_saturation_pct", BM_FIELD_DOUBLE,
+     offsetof(PmeDissolvedOxygenMsg::Data, do_saturation_pct)},
+    {"salinity_ppt", BM_FIELD_FLOAT, offsetof(PmeDissolvedOxygenMsg::Data, salinity_ppt)},
+};
+
+const Schema PME_DISSOLVED_OXYGEN_SCHEMA = {
+    "pme_dissolved_oxygen",
+    PmeDissolvedOxygenMsg::VERSION,
+    pme_dissolved_oxygen_columns,
+    sizeof(pme_dissolved_oxygen_columns) / sizeof(pme_dissolved_oxygen_columns[0]),
+};
+
+} // namespace ColumnarArchive
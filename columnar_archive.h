@@ -0,0 +1,142 @@
+#pragma once
+#include "bm_messages_helper.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Append-only columnar archive of decoded sensor messages.
+//
+// One file holds one message type. Rows are grouped into fixed-capacity
+// blocks; inside a block every field of the Data struct is stored as its own
+// contiguous column, and the block header carries a min/max range per column.
+// Every block has the same size, so block i lives at
+// header_size + i * block_size and a reader can mmap the file and hand out
+// column pointers directly without parsing anything.
+//
+// All values are stored in host byte order.
+
+namespace ColumnarArchive {
+
+constexpr char MAGIC[8] = {'B', 'M', 'C', 'O', 'L', 'A', 'R', '1'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr size_t MAX_COLUMNS = 24;
+constexpr size_t MAX_NAME_LEN = 32;
+constexpr uint32_t DEFAULT_ROWS_PER_BLOCK = 1024;
+
+typedef enum Error : uint8_t {
+  OK = 0,
+  ERR_IO,
+  ERR_FORMAT,
+  ERR_SCHEMA_MISMATCH,
+  ERR_NO_MEMORY,
+  ERR_UNSUPPORTED,
+} Error_t;
+
+// Describes one field of a Data struct. Only fixed width BmField types are
+// supported (UINT8/16/32/64, FLOAT, DOUBLE); enums are stored as their
+// underlying integer type.
+struct Column {
+  const char *name;
+  BmField type;
+  size_t offset; // offsetof(Data, field)
+};
+
+struct Schema {
+  const char *message_type; // e.g. "aanderaa_conductivity"
+  uint32_t message_version;
+  const Column *columns;
+  size_t num_columns;
+};
+
+// On-disk layout
+struct ColumnHeader {
+  char name[MAX_NAME_LEN];
+  uint32_t type;   // BmField
+  uint32_t width;  // bytes per value
+  uint64_t offset; // byte offset of the column inside a block
+};
+
+struct FileHeader {
+  char magic[sizeof(MAGIC)];
+  uint32_t format_version;
+  uint32_t message_version;
+  char message_type[MAX_NAME_LEN];
+  uint32_t num_columns;
+  uint32_t rows_per_block;
+  uint64_t block_size;
+  uint64_t header_size;
+  ColumnHeader columns[MAX_COLUMNS];
+};
+
+struct ColumnRange {
+  double min;
+  double max;
+};
+
+struct BlockHeader {
+  uint32_t num_rows;
+  uint32_t reserved;
+  ColumnRange ranges[MAX_COLUMNS];
+};
+
+struct Writer {
+  FILE *file;
+  const Schema *schema;
+  FileHeader header;
+  uint8_t *block;         // in-memory copy of the block being filled
+  uint64_t block_index;   // index of the block being filled
+};
+
+struct Reader {
+  const uint8_t *base; // mmap'd file
+  size_t size;
+  const FileHeader *header;
+  uint64_t num_blocks;
+};
+
+// Opens path for appending rows described by schema, creating the file if
+// it does not exist. An existing file must have been written with a matching
+// schema. A partially filled last block is loaded and continued.
+Error_t writer_open(Writer &w, const char *path, const Schema &schema,
+                    uint32_t rows_per_block = DEFAULT_ROWS_PER_BLOCK);
+
+// Appends one decoded Data struct. Full blocks are written out immediately.
+Error_t writer_append(Writer &w, const void *row);
+
+// Writes the block being filled (if it holds any rows) and flushes the file.
+Error_t writer_flush(Writer &w);
+
+Error_t writer_close(Writer &w);
+
+// Maps the archive read only. The header and every block's num_rows are
+// checked here, so the accessors below can trust them.
+Error_t reader_open(Reader &r, const char *path);
+
+// The archive is validated against the schema's type, version and columns.
+Error_t reader_open(Reader &r, const char *path, const Schema &schema);
+
+void reader_close(Reader &r);
+
+uint64_t reader_num_rows(const Reader &r);
+
+// Returns the index of the named column, or -1 if there is none.
+int reader_find_column(const Reader &r, const char *name);
+
+const BlockHeader *reader_block(const Reader &r, uint64_t block_index);
+
+// Returns a pointer to the first value of column col in block block_index.
+// The block holds reader_block(r, block_index)->num_rows values.
+const void *reader_column(const Reader &r, uint64_t block_index, size_t col);
+
+template <typename T>
+const T *reader_column(const Reader &r, uint64_t block_index, size_t col) {
+  return static_cast<const T *>(reader_column(r, block_index, col));
+}
+
+// True if any value of column col in the block may lie within [lo, hi].
+bool reader_block_may_contain(const Reader &r, uint64_t block_index, size_t col,
+                              double lo, double hi);
+
+extern const Schema AANDERAA_CONDUCTIVITY_SCHEMA;
+extern const Schema PME_DISSOLVED_OXYGEN_SCHEMA;
+
+} // namespace ColumnarArchive
@@ -0,0 +1,126 @@
+#include "config_cbor_map_cache.h"
+#include "bm_config.h"
+#include <string.h>
+#ifndef CI_TEST
+#include "bm_os.h"
+#else
+#define bm_malloc malloc
+#define bm_free free
+#endif
+
+static size_t entry_slot(uint64_t node_id, uint32_t partition_id,
+                         size_t capacity) {
+  uint64_t h = (node_id ^ ((uint64_t)partition_id << 32 | partition_id)) *
+               0x9e3779b97f4a7c15ull;
+  return (size_t)(h >> 32) & (capacity - 1);
+}
+
+bool config_cbor_map_cache_init(ConfigCborMapCache *c,
+                                ConfigCborMapCacheEntry *entries,
+                                size_t capacity) {
+  memset(c, 0, sizeof(*c));
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    /* left empty, find_slot() needs the mask */
+    return false;
+  }
+  memset(entries, 0, capacity * sizeof(*entries));
+  c->entries = entries;
+  c->capacity = capacity;
+  return true;
+}
+
+void config_cbor_map_cache_deinit(ConfigCborMapCache *c) {
+  for (size_t i = 0; i < c->capacity; i++) {
+    if (c->entries[i].valid) {
+      bm_free(c->entries[i].cbor_data);
+    }
+  }
+  if (c->entries) {
+    memset(c->entries, 0, c->capacity * sizeof(*c->entries));
+  }
+  c->count = 0;
+}
+
+static ConfigCborMapCacheEntry *find_slot(const ConfigCborMapCache *c,
+                                          uint64_t node_id,
+                                          uint32_t partition_id) {
+  if (c->capacity == 0) {
+    return NULL;
+  }
+  size_t i = entry_slot(node_id, partition_id, c->capacity);
+  /* at least one slot is always free, so this terminates */
+  while (c->entries[i].valid && (c->entries[i].node_id != node_id ||
+                                 c->entries[i].partition_id != partition_id)) {
+    i = (i + 1) & (c->capacity - 1);
+  }
+  return &c->entries[i];
+}
+
+const ConfigCborMapCacheEntry *
+config_cbor_map_cache_find(const ConfigCborMapCache *c, uint64_t node_id,
+                           uint32_t partition_id) {
+  const ConfigCborMapCacheEntry *e = find_slot(c, node_id, partition_id);
+  return e && e->valid ? e : NULL;
+}
+
+bool config_cbor_map_cache_request(const ConfigCborMapCache *c,
+                                   uint64_t node_id, uint32_t partition_id,
+                                   uint32_t crc,
+                                   ConfigCborMapRequestData *request) {
+  const ConfigCborMapCacheEntry *e =
+      config_cbor_map_cache_find(c, node_id, partition_id);
+  if (e && e->crc == crc) {
+    return false;
+  }
+  memset(request, 0, sizeof(*request));
+  request->partition_id = partition_id;
+  return true;
+}
+
+CborError config_cbor_map_cache_store(ConfigCborMapCache *c, uint64_t node_id,
+                                      uint32_t partition_id, uint32_t crc,
+                                      const uint8_t *cbor_data, uint32_t len) {
+  uint32_t key_slots = 0;
+  CborError err = config_cbor_map_index_slots(cbor_data, len, &key_slots);
+  if (err != CborNoError) {
+    return err;
+  }
+
+  ConfigCborMapCacheEntry *slot = find_slot(c, node_id, partition_id);
+  if (!slot || (!slot->valid && c->count + 1 >= c->capacity)) {
+    return CborErrorOutOfMemory;
+  }
+
+  ConfigCborMapCacheEntry e = {
+      .node_id = node_id,
+      .partition_id = partition_id,
+      .crc = crc,
+      .valid = true,
+  };
+
+  /* one allocation, the map followed by its key table */
+  const size_t keys_offset = (len + 3u) & ~(size_t)3u;
+  e.cbor_data = (uint8_t *)bm_malloc(keys_offset +
+                                     key_slots * sizeof(ConfigCborMapIndexKey));
+  if (!e.cbor_data) {
+    return CborErrorOutOfMemory;
+  }
+  memcpy(e.cbor_data, cbor_data, len);
+
+  if ((err = config_cbor_map_index_build(
+           &e.index, e.cbor_data, len,
+           (ConfigCborMapIndexKey *)(e.cbor_data + keys_offset), key_slots)) !=
+      CborNoError) {
+    bm_free(e.cbor_data);
+    return err;
+  }
+
+  if (slot->valid) {
+    bm_free(slot->cbor_data);
+  } else {
+    c->count++;
+  }
+  *slot = e;
+
+  return CborNoError;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "config_cbor_map_index.h"
+#include "config_cbor_map_srv_request_msg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Gateway side cache of node config maps.
+//
+// Maps are cached per (node_id, partition_id) together with the config CRC
+// they were fetched for, e.g. SysInfoReplyData.sys_config_crc. After a
+// reboot config_cbor_map_cache_request() only asks a node for its map again
+// if the CRC it reports has changed. Finding an entry and a key within it
+// are both constant time: entries live in an open addressing table and each
+// cached map carries a ConfigCborMapIndex, built once when stored.
+
+typedef struct {
+  uint64_t node_id;
+  uint32_t partition_id;
+  uint32_t crc;
+  bool valid;
+  uint8_t *cbor_data; // owned copy of the encoded map
+  ConfigCborMapIndex index; // over cbor_data, for the config_cbor_map_index getters
+} ConfigCborMapCacheEntry;
+
+typedef struct {
+  ConfigCborMapCacheEntry *entries;
+  size_t capacity;
+  size_t count;
+} ConfigCborMapCache;
+
+/*!
+ entries is caller storage for capacity entries; capacity must be a power of
+ two. The cache never holds more than capacity - 1 maps. Returns false, and
+ leaves a cache that stores nothing, if capacity is not a power of two.
+*/
+bool config_cbor_map_cache_init(ConfigCborMapCache *c,
+                                ConfigCborMapCacheEntry *entries,
+                                size_t capacity);
+
+/* frees every cached map */
+void config_cbor_map_cache_deinit(ConfigCborMapCache *c);
+
+/*!
+ Returns true, and fills request, if the map for node_id/partition_id is
+ not cached or was cached for a different crc.
+*/
+bool config_cbor_map_cache_request(const ConfigCborMapCache *c,
+                                   uint64_t node_id, uint32_t partition_id,
+                                   uint32_t crc,
+                                   ConfigCborMapRequestData *request);
+
+/*!
+ Copies an encoded config map (e.g. ConfigCborMapReplyData.cbor_data) into
+ the cache and indexes its keys, replacing any earlier map for the same
+ node and partition.
+
+ @return CborNoError on success
+         CborErrorIllegalType if cbor_data is not a map with text keys
+         CborErrorOutOfMemory if the cache is full or allocation fails
+*/
+CborError config_cbor_map_cache_store(ConfigCborMapCache *c, uint64_t node_id,
+                                      uint32_t partition_id, uint32_t crc,
+                                      const uint8_t *cbor_data, uint32_t len);
+
+const ConfigCborMapCacheEntry *
+config_cbor_map_cache_find(const ConfigCborMapCache *c, uint64_t node_id,
+                           uint32_t partition_id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,209 @@
+#include "config_cbor_map_index.h"
+#include "bm_messages_helper.h"
+#include <string.h>
+
+// Keys are indexed by the hash of their encoded CBOR item (header and text),
+// so a lookup compares bytes in place instead of decoding every candidate.
+
+CborError config_cbor_map_index_slots(const uint8_t *cbor_data, uint32_t len,
+                                      uint32_t *key_slots) {
+  CborParser parser;
+  CborValue map;
+  size_t num_keys = 0;
+  CborError err = cbor_parser_init(cbor_data, len, 0, &parser, &map);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (!cbor_value_is_map(&map) || !cbor_value_is_length_known(&map)) {
+    return CborErrorIllegalType;
+  }
+  if ((err = cbor_value_get_map_length(&map, &num_keys)) != CborNoError) {
+    return err;
+  }
+  if (num_keys > len / 2) {
+    /* every pair takes at least two bytes */
+    return CborErrorIllegalType;
+  }
+
+  uint32_t slots = num_keys ? 2 : 0;
+  while (slots && slots < 2 * num_keys) {
+    slots <<= 1;
+  }
+  *key_slots = slots;
+
+  return CborNoError;
+}
+
+CborError config_cbor_map_index_build(ConfigCborMapIndex *idx,
+                                      const uint8_t *cbor_data, uint32_t len,
+                                      ConfigCborMapIndexKey *keys,
+                                      uint32_t key_slots) {
+  uint32_t needed = 0;
+  CborError err = config_cbor_map_index_slots(cbor_data, len, &needed);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (key_slots < needed) {
+    return CborErrorOutOfMemory;
+  }
+
+  idx->cbor_data = cbor_data;
+  idx->cbor_data_len = len;
+  idx->num_keys = 0;
+  idx->key_slots = needed;
+  idx->keys = keys;
+  memset(keys, 0, needed * sizeof(*keys));
+
+  CborParser parser;
+  CborValue map, it;
+  if ((err = cbor_parser_init(cbor_data, len, 0, &parser, &map)) !=
+      CborNoError) {
+    return err;
+  }
+  if ((err = cbor_value_enter_container(&map, &it)) != CborNoError) {
+    return err;
+  }
+
+  while (!cbor_value_at_end(&it)) {
+    if (!cbor_value_is_text_string(&it)) {
+      return CborErrorIllegalType;
+    }
+    const uint8_t *key = cbor_value_get_next_byte(&it);
+    if ((err = cbor_value_advance(&it)) != CborNoError) {
+      return err;
+    }
+    const uint8_t *value = cbor_value_get_next_byte(&it);
+    if ((err = cbor_value_advance(&it)) != CborNoError) {
+      return err;
+    }
+
+    ConfigCborMapIndexKey k = {
+        .hash = bm_fnv1a(BM_FNV1A_INIT, key, (size_t)(value - key)),
+        .key_offset = (uint32_t)(key - cbor_data),
+        .value_offset = (uint32_t)(value - cbor_data),
+    };
+    uint32_t slot = k.hash & (needed - 1);
+    while (keys[slot].key_offset) {
+      slot = (slot + 1) & (needed - 1);
+    }
+    keys[slot] = k;
+    idx->num_keys++;
+  }
+
+  return cbor_value_leave_container(&map, &it);
+}
+
+CborError config_cbor_map_index_get(const ConfigCborMapIndex *idx,
+                                    const char *key, CborParser *parser,
+                                    CborValue *value) {
+  if (!idx->num_keys) {
+    return CborErrorImproperValue;
+  }
+
+  uint8_t header[9];
+  size_t header_len;
+  const size_t key_len = strlen(key);
+  const uint32_t hash = bm_cbor_key_hash(key, header, &header_len);
+
+  for (uint32_t slot = hash & (idx->key_slots - 1); idx->keys[slot].key_offset;
+       slot = (slot + 1) & (idx->key_slots - 1)) {
+    const ConfigCborMapIndexKey *k = &idx->keys[slot];
+    const uint8_t *encoded = &idx->cbor_data[k->key_offset];
+    if (k->hash == hash &&
+        k->value_offset - k->key_offset == header_len + key_len &&
+        memcmp(encoded, header, header_len) == 0 &&
+        memcmp(encoded + header_len, key, key_len) == 0) {
+      return cbor_parser_init(&idx->cbor_data[k->value_offset],
+                              idx->cbor_data_len - k->value_offset, 0, parser,
+                              value);
+    }
+  }
+
+  return CborErrorImproperValue;
+}
+
+CborError config_cbor_map_index_get_uint(const ConfigCborMapIndex *idx,
+                                         const char *key, uint64_t *out) {
+  CborParser parser;
+  CborValue value;
+  CborError err = config_cbor_map_index_get(idx, key, &parser, &value);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (!cbor_value_is_unsigned_integer(&value)) {
+    return CborErrorIllegalType;
+  }
+  return cbor_value_get_uint64(&value, out);
+}
+
+CborError config_cbor_map_index_get_int(const ConfigCborMapIndex *idx,
+                                        const char *key, int64_t *out) {
+  CborParser parser;
+  CborValue value;
+  CborError err = config_cbor_map_index_get(idx, key, &parser, &value);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (!cbor_value_is_integer(&value)) {
+    return CborErrorIllegalType;
+  }
+  return cbor_value_get_int64_checked(&value, out);
+}
+
+CborError config_cbor_map_index_get_float(const ConfigCborMapIndex *idx,
+                                          const char *key, float *out) {
+  CborParser parser;
+  CborValue value;
+  CborError err = config_cbor_map_index_get(idx, key, &parser, &value);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (cbor_value_is_float(&value)) {
+    return cbor_value_get_float(&value, out);
+  }
+  if (cbor_value_is_double(&value)) {
+    double d;
+    err = cbor_value_get_double(&value, &d);
+    *out = (float)d;
+    return err;
+  }
+  return CborErrorIllegalType;
+}
+
+/* definite length strings end with their bytes, so the view is the tail of the item */
+static CborError get_string_view(const ConfigCborMapIndex *idx,
+                                 const char *key, CborType type,
+                                 const uint8_t **ptr, size_t *len) {
+  CborParser parser;
+  CborValue value;
+  CborError err = config_cbor_map_index_get(idx, key, &parser, &value);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (cbor_value_get_type(&value) != type) {
+    return CborErrorIllegalType;
+  }
+  size_t n;
+  if ((err = cbor_value_get_string_length(&value, &n)) != CborNoError) {
+    return err;
+  }
+  if ((err = cbor_value_advance(&value)) != CborNoError) {
+    return err;
+  }
+  *ptr = cbor_value_get_next_byte(&value) - n;
+  *len = n;
+  return CborNoError;
+}
+
+CborError config_cbor_map_index_get_string(const ConfigCborMapIndex *idx,
+                                           const char *key, const char **str,
+                                           size_t *len) {
+  return get_string_view(idx, key, CborTextStringType, (const uint8_t **)str,
+                         len);
+}
+
+CborError config_cbor_map_index_get_bytes(const ConfigCborMapIndex *idx,
+                                          const char *key,
+                                          const uint8_t **bytes, size_t *len) {
+  return get_string_view(idx, key, CborByteStringType, bytes, len);
+}
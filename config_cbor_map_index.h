@@ -0,0 +1,84 @@
+#pragma once
+#include "cbor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Key lookup over an encoded config CBOR map, e.g.
+// ConfigCborMapReplyData.cbor_data.
+//
+// config_cbor_map_index_build() walks the map once and records, in a
+// caller supplied hash table, where each key's value starts. Every lookup
+// after that is O(1) regardless of the map size. Getters read values in
+// place: nothing is copied or allocated and string/bytes views point into
+// the map, which must outlive the index.
+
+typedef struct {
+  uint32_t hash;
+  uint32_t key_offset;   // encoded key item within cbor_data
+  uint32_t value_offset; // encoded value item within cbor_data
+} ConfigCborMapIndexKey;
+
+typedef struct {
+  const uint8_t *cbor_data;
+  uint32_t cbor_data_len;
+  uint32_t num_keys;
+  uint32_t key_slots; // power of two, 0 for an empty map
+  ConfigCborMapIndexKey *keys;
+} ConfigCborMapIndex;
+
+/*!
+ Number of ConfigCborMapIndexKey slots needed to index the map in
+ cbor_data. The table is kept at most half full.
+
+ @return CborNoError, or CborErrorIllegalType if cbor_data is not a
+         definite length map
+*/
+CborError config_cbor_map_index_slots(const uint8_t *cbor_data, uint32_t len,
+                                      uint32_t *key_slots);
+
+/*!
+ Index the map in cbor_data using keys, key_slots entries of caller storage.
+
+ @return CborNoError on success
+         CborErrorOutOfMemory if key_slots is less than
+         config_cbor_map_index_slots() asks for
+         CborErrorIllegalType if cbor_data is not a map with text keys
+*/
+CborError config_cbor_map_index_build(ConfigCborMapIndex *idx,
+                                      const uint8_t *cbor_data, uint32_t len,
+                                      ConfigCborMapIndexKey *keys,
+                                      uint32_t key_slots);
+
+/*!
+ Points value at the value stored under key. parser must outlive value.
+
+ @return CborNoError if found, CborErrorImproperValue if the key is absent
+*/
+CborError config_cbor_map_index_get(const ConfigCborMapIndex *idx,
+                                    const char *key, CborParser *parser,
+                                    CborValue *value);
+
+/*
+ * Typed getters. Each returns CborErrorImproperValue if the key is absent
+ * and CborErrorIllegalType if the value has another type. get_int accepts
+ * unsigned values that fit, get_float accepts single and double precision.
+ * String and bytes views are not zero terminated.
+ */
+CborError config_cbor_map_index_get_uint(const ConfigCborMapIndex *idx,
+                                         const char *key, uint64_t *out);
+CborError config_cbor_map_index_get_int(const ConfigCborMapIndex *idx,
+                                        const char *key, int64_t *out);
+CborError config_cbor_map_index_get_float(const ConfigCborMapIndex *idx,
+                                          const char *key, float *out);
+CborError config_cbor_map_index_get_string(const ConfigCborMapIndex *idx,
+                                           const char *key, const char **str,
+                                           size_t *len);
+CborError config_cbor_map_index_get_bytes(const ConfigCborMapIndex *idx,
+                                          const char *key,
+                                          const uint8_t **bytes, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
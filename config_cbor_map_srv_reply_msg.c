@@ -1,17 +1,26 @@
 #include "config_cbor_map_srv_reply_msg.h"
 #include "bm_config.h"
+#include <inttypes.h>
+#ifndef CI_TEST
 #include "bm_os.h"
+#else
+#include <stdlib.h>
+#define bm_malloc malloc
+#endif
 
-CborError config_cbor_map_reply_encode(ConfigCborMapReplyData *d,
-                                       uint8_t *cbor_buffer, size_t size,
-                                       size_t *encoded_len) {
+static CborError encode_reply(const ConfigCborMapReplyData *d, bool chunked,
+                              uint8_t *cbor_buffer, size_t size,
+                              size_t *encoded_len) {
   CborError err;
   CborEncoder encoder, map_encoder;
   cbor_encoder_init(&encoder, cbor_buffer, size, 0);
 
+  const uint32_t data_len = chunked ? d->chunk_len : d->cbor_encoded_map_len;
+
   do {
     err = cbor_encoder_create_map(&encoder, &map_encoder,
-                                  CONFIG_CBOR_MAP_REPLY_NUM_FIELDS);
+                                  chunked ? CONFIG_CBOR_MAP_REPLY_CHUNKED_NUM_FIELDS
+                                          : CONFIG_CBOR_MAP_REPLY_NUM_FIELDS);
     if (err != CborNoError) {
       bm_debug("cbor_encoder_create_map failed: %d\n", err);
       if (err != CborErrorOutOfMemory) {
@@ -87,6 +96,41 @@ CborError config_cbor_map_reply_encode(ConfigCborMapReplyData *d,
       }
     }
 
+    if (chunked) {
+      // offset
+      err = cbor_encode_text_stringz(&map_encoder, "offset");
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_text_stringz failed for offset key: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+      err = cbor_encode_uint(&map_encoder, d->offset);
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_uint failed for offset value: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+
+      // chunk_len
+      err = cbor_encode_text_stringz(&map_encoder, "chunk_len");
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_text_stringz failed for chunk_len key: %d\n",
+                 err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+      err = cbor_encode_uint(&map_encoder, d->chunk_len);
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_uint failed for chunk_len value: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+    }
+
     // cbor_data
     err = cbor_encode_text_stringz(&map_encoder, "cbor_data");
     if (err != CborNoError) {
@@ -95,8 +139,7 @@ CborError config_cbor_map_reply_encode(ConfigCborMapReplyData *d,
         break;
       }
     }
-    err = cbor_encode_byte_string(&map_encoder, d->cbor_data,
-                                  d->cbor_encoded_map_len);
+    err = cbor_encode_byte_string(&map_encoder, d->cbor_data, data_len);
     if (err != CborNoError) {
       bm_debug("cbor_encode_byte_string failed for partition_id value: %d\n",
                err);
@@ -125,7 +168,21 @@ CborError config_cbor_map_reply_encode(ConfigCborMapReplyData *d,
   return err;
 }
 
-// allocates memory for d.cbor_data, caller must free.
+CborError config_cbor_map_reply_encode(ConfigCborMapReplyData *d,
+                                       uint8_t *cbor_buffer, size_t size,
+                                       size_t *encoded_len) {
+  return encode_reply(d, false, cbor_buffer, size, encoded_len);
+}
+
+CborError config_cbor_map_reply_encode_chunk(ConfigCborMapReplyData *d,
+                                             uint8_t *cbor_buffer, size_t size,
+                                             size_t *encoded_len) {
+  return encode_reply(d, true, cbor_buffer, size, encoded_len);
+}
+
+// allocates memory for d.cbor_data, caller must free. For a chunked reply
+// only the chunk_len bytes of the chunk are allocated. A chunk that ends
+// past cbor_encoded_map_len is rejected with CborErrorImproperValue.
 CborError config_cbor_map_reply_decode(ConfigCborMapReplyData *d,
                                        const uint8_t *cbor_buffer,
                                        size_t size) {
@@ -153,10 +210,12 @@ CborError config_cbor_map_reply_decode(ConfigCborMapReplyData *d,
     if (err != CborNoError) {
       break;
     }
-    if (num_fields != CONFIG_CBOR_MAP_REPLY_NUM_FIELDS) {
+    if (num_fields != CONFIG_CBOR_MAP_REPLY_NUM_FIELDS &&
+        num_fields != CONFIG_CBOR_MAP_REPLY_CHUNKED_NUM_FIELDS) {
       err = CborErrorUnknownLength;
-      bm_debug("expected %d fields but got %zu\n",
-               CONFIG_CBOR_MAP_REPLY_NUM_FIELDS, num_fields);
+      bm_debug("expected %d or %d fields but got %zu\n",
+               CONFIG_CBOR_MAP_REPLY_NUM_FIELDS,
+               CONFIG_CBOR_MAP_REPLY_CHUNKED_NUM_FIELDS, num_fields);
       break;
     }
 
@@ -246,6 +305,56 @@ CborError config_cbor_map_reply_decode(ConfigCborMapReplyData *d,
       break;
     }
 
+    d->offset = 0;
+    d->chunk_len = d->cbor_encoded_map_len;
+    if (num_fields == CONFIG_CBOR_MAP_REPLY_CHUNKED_NUM_FIELDS) {
+      // offset
+      if (!cbor_value_is_text_string(&value)) {
+        err = CborErrorIllegalType;
+        bm_debug("expected string key but got something else\n");
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_get_uint64(&value, &tmp_uint64);
+      d->offset = (uint32_t)tmp_uint64;
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+
+      // chunk_len
+      if (!cbor_value_is_text_string(&value)) {
+        err = CborErrorIllegalType;
+        bm_debug("expected string key but got something else\n");
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_get_uint64(&value, &tmp_uint64);
+      d->chunk_len = (uint32_t)tmp_uint64;
+      if (err != CborNoError) {
+        break;
+      }
+      if ((uint64_t)d->offset + d->chunk_len > d->cbor_encoded_map_len) {
+        err = CborErrorImproperValue;
+        bm_debug("chunk at %" PRIu32 " of %" PRIu32 " bytes ends past the map\n",
+                 d->offset, d->chunk_len);
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+    }
+
     // cbor_data
     if (!cbor_value_is_text_string(&value)) {
       err = CborErrorIllegalType;
@@ -256,8 +365,8 @@ CborError config_cbor_map_reply_decode(ConfigCborMapReplyData *d,
     if (err != CborNoError) {
       break;
     }
-    if (d->cbor_encoded_map_len && d->success) {
-      size_t buflen = d->cbor_encoded_map_len;
+    if (d->chunk_len && d->success) {
+      size_t buflen = d->chunk_len;
       uint8_t *buf = (uint8_t *)bm_malloc(buflen);
       if (buf) {
         err = cbor_value_copy_byte_string(&value, buf, &buflen, NULL);
@@ -265,7 +374,7 @@ CborError config_cbor_map_reply_decode(ConfigCborMapReplyData *d,
         if (err != CborNoError) {
           break;
         }
-        if (buflen != d->cbor_encoded_map_len) {
+        if (buflen != d->chunk_len) {
           err = CborErrorIllegalType;
           break;
         }
@@ -6,18 +6,31 @@ extern "C" {
 #endif
 
 #define CONFIG_CBOR_MAP_REPLY_NUM_FIELDS 5
+#define CONFIG_CBOR_MAP_REPLY_CHUNKED_NUM_FIELDS 7
 
+// cbor_encoded_map_len is always the length of the whole encoded map.
+// config_cbor_map_reply_encode() sends all of it from cbor_data as the
+// original five-field message and ignores offset and chunk_len. A reply to
+// a paged request is sent with config_cbor_map_reply_encode_chunk() and
+// carries chunk_len bytes of the map starting at offset in cbor_data.
+// Decoding a whole-map reply sets offset 0 and chunk_len to the map length.
 typedef struct {
   uint64_t node_id;
   uint32_t partition_id;
   bool success;
   uint32_t cbor_encoded_map_len;
+  uint32_t offset;
+  uint32_t chunk_len;
   uint8_t *cbor_data;
 } ConfigCborMapReplyData;
 
 CborError config_cbor_map_reply_encode(ConfigCborMapReplyData *d, uint8_t *cbor_buffer,
                                        size_t size, size_t *encoded_len);
 
+CborError config_cbor_map_reply_encode_chunk(ConfigCborMapReplyData *d,
+                                             uint8_t *cbor_buffer, size_t size,
+                                             size_t *encoded_len);
+
 CborError config_cbor_map_reply_decode(ConfigCborMapReplyData *d, const uint8_t *cbor_buffer,
                                        size_t size);
 
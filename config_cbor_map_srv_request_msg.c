@@ -1,16 +1,17 @@
 #include "config_cbor_map_srv_request_msg.h"
 #include "bm_config.h"
 
-CborError config_cbor_map_request_encode(ConfigCborMapRequestData *d,
-                                         uint8_t *cbor_buffer, size_t size,
-                                         size_t *encoded_len) {
+static CborError encode_request(const ConfigCborMapRequestData *d, bool paged,
+                                uint8_t *cbor_buffer, size_t size,
+                                size_t *encoded_len) {
   CborError err;
   CborEncoder encoder, map_encoder;
   cbor_encoder_init(&encoder, cbor_buffer, size, 0);
 
   do {
     err = cbor_encoder_create_map(&encoder, &map_encoder,
-                                  CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS);
+                                  paged ? CONFIG_CBOR_MAP_REQUEST_PAGED_NUM_FIELDS
+                                        : CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS);
     if (err != CborNoError) {
       bm_debug("cbor_encoder_create_map failed: %d\n", err);
       if (err != CborErrorOutOfMemory) {
@@ -35,6 +36,40 @@ CborError config_cbor_map_request_encode(ConfigCborMapRequestData *d,
       }
     }
 
+    if (paged) {
+      // offset
+      err = cbor_encode_text_stringz(&map_encoder, "offset");
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_text_stringz failed for offset key: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+      err = cbor_encode_uint(&map_encoder, d->offset);
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_uint failed for offset value: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+
+      // length
+      err = cbor_encode_text_stringz(&map_encoder, "length");
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_text_stringz failed for length key: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+      err = cbor_encode_uint(&map_encoder, d->length);
+      if (err != CborNoError) {
+        bm_debug("cbor_encode_uint failed for length value: %d\n", err);
+        if (err != CborErrorOutOfMemory) {
+          break;
+        }
+      }
+    }
+
     if (err != CborNoError && err != CborErrorOutOfMemory) {
       break;
     }
@@ -55,6 +90,19 @@ CborError config_cbor_map_request_encode(ConfigCborMapRequestData *d,
   return err;
 }
 
+CborError config_cbor_map_request_encode(ConfigCborMapRequestData *d,
+                                         uint8_t *cbor_buffer, size_t size,
+                                         size_t *encoded_len) {
+  return encode_request(d, false, cbor_buffer, size, encoded_len);
+}
+
+CborError config_cbor_map_request_encode_paged(ConfigCborMapRequestData *d,
+                                               uint8_t *cbor_buffer,
+                                               size_t size,
+                                               size_t *encoded_len) {
+  return encode_request(d, true, cbor_buffer, size, encoded_len);
+}
+
 CborError config_cbor_map_request_decode(ConfigCborMapRequestData *d,
                                          const uint8_t *cbor_buffer,
                                          size_t size) {
@@ -80,12 +128,16 @@ CborError config_cbor_map_request_decode(ConfigCborMapRequestData *d,
     if (err != CborNoError) {
       break;
     }
-    if (num_fields != CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS) {
+    if (num_fields != CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS &&
+        num_fields != CONFIG_CBOR_MAP_REQUEST_PAGED_NUM_FIELDS) {
       err = CborErrorUnknownLength;
-      bm_debug("expected %d fields but got %zu\n",
-               CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS, num_fields);
+      bm_debug("expected %d or %d fields but got %zu\n",
+               CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS,
+               CONFIG_CBOR_MAP_REQUEST_PAGED_NUM_FIELDS, num_fields);
       break;
     }
+    d->offset = 0;
+    d->length = 0;
 
     CborValue value;
     err = cbor_value_enter_container(&map, &value);
@@ -113,6 +165,48 @@ CborError config_cbor_map_request_decode(ConfigCborMapRequestData *d,
       break;
     }
 
+    if (num_fields == CONFIG_CBOR_MAP_REQUEST_PAGED_NUM_FIELDS) {
+      // offset
+      if (!cbor_value_is_text_string(&value)) {
+        err = CborErrorIllegalType;
+        bm_debug("expected string key but got something else\n");
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_get_uint64(&value, &tmp_uint64);
+      d->offset = (uint32_t)tmp_uint64;
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+
+      // length
+      if (!cbor_value_is_text_string(&value)) {
+        err = CborErrorIllegalType;
+        bm_debug("expected string key but got something else\n");
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_get_uint64(&value, &tmp_uint64);
+      d->length = (uint32_t)tmp_uint64;
+      if (err != CborNoError) {
+        break;
+      }
+      err = cbor_value_advance(&value);
+      if (err != CborNoError) {
+        break;
+      }
+    }
+
     if (err == CborNoError) {
       err = cbor_value_leave_container(&map, &value);
       if (err != CborNoError) {
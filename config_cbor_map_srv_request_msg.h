@@ -6,14 +6,25 @@ extern "C" {
 #endif
 
 #define CONFIG_CBOR_MAP_REQUEST_NUM_FIELDS 1
+#define CONFIG_CBOR_MAP_REQUEST_PAGED_NUM_FIELDS 3
 
+// offset and length page through the encoded map. They are only sent by
+// config_cbor_map_request_encode_paged(); config_cbor_map_request_encode()
+// sends the original one-field message asking for the whole map. Decoding
+// an unpaged request sets both to zero.
 typedef struct {
   uint32_t partition_id;
+  uint32_t offset;
+  uint32_t length;
 } ConfigCborMapRequestData;
 
 CborError config_cbor_map_request_encode(ConfigCborMapRequestData *d, uint8_t *cbor_buffer,
                                          size_t size, size_t *encoded_len);
 
+CborError config_cbor_map_request_encode_paged(ConfigCborMapRequestData *d,
+                                               uint8_t *cbor_buffer, size_t size,
+                                               size_t *encoded_len);
+
 CborError config_cbor_map_request_decode(ConfigCborMapRequestData *d,
                                          const uint8_t *cbor_buffer, size_t size);
 
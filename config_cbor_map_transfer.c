@@ -0,0 +1,121 @@
+#include "config_cbor_map_transfer.h"
+#include "bm_config.h"
+#include <inttypes.h>
+#include <string.h>
+
+static uint32_t num_chunks(const ConfigCborMapAssembler *a) {
+  return (a->total_len + a->chunk_size - 1) / a->chunk_size;
+}
+
+static bool chunk_received(const ConfigCborMapAssembler *a, uint32_t chunk) {
+  return a->received[chunk / 32] & (1u << (chunk % 32));
+}
+
+bool config_cbor_map_reply_fill_chunk(ConfigCborMapReplyData *reply,
+                                      const ConfigCborMapRequestData *request,
+                                      const uint8_t *map, uint32_t map_len,
+                                      uint32_t max_chunk) {
+  if (request->offset > map_len) {
+    return false;
+  }
+
+  uint32_t len = map_len - request->offset;
+  if (request->length && request->length < len) {
+    len = request->length;
+  }
+  if (max_chunk && max_chunk < len) {
+    len = max_chunk;
+  }
+
+  reply->partition_id = request->partition_id;
+  reply->cbor_encoded_map_len = map_len;
+  reply->offset = request->offset;
+  reply->chunk_len = len;
+  reply->cbor_data = (uint8_t *)&map[request->offset];
+
+  return true;
+}
+
+void config_cbor_map_assembler_init(ConfigCborMapAssembler *a,
+                                    uint32_t partition_id, uint32_t chunk_size,
+                                    uint8_t *buffer, size_t capacity) {
+  memset(a, 0, sizeof(*a));
+  a->partition_id = partition_id;
+  a->chunk_size = chunk_size;
+  a->buffer = buffer;
+  a->capacity = capacity;
+}
+
+bool config_cbor_map_assembler_next_request(const ConfigCborMapAssembler *a,
+                                            ConfigCborMapRequestData *request) {
+  request->partition_id = a->partition_id;
+  request->length = a->chunk_size;
+
+  if (!a->started) {
+    request->offset = 0;
+    return true;
+  }
+
+  const uint32_t n = num_chunks(a);
+  for (uint32_t chunk = 0; chunk < n; chunk++) {
+    if (!chunk_received(a, chunk)) {
+      request->offset = chunk * a->chunk_size;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+CborError config_cbor_map_assembler_add(ConfigCborMapAssembler *a,
+                                        const ConfigCborMapReplyData *reply) {
+  if (reply->partition_id != a->partition_id || !reply->success) {
+    return CborErrorImproperValue;
+  }
+
+  if (!a->started) {
+    if (reply->cbor_encoded_map_len > a->capacity) {
+      bm_debug("config map of %" PRIu32 " bytes does not fit in %zu\n",
+               reply->cbor_encoded_map_len, a->capacity);
+      return CborErrorOutOfMemory;
+    }
+    if ((reply->cbor_encoded_map_len + a->chunk_size - 1) / a->chunk_size >
+        CONFIG_CBOR_MAP_TRANSFER_MAX_CHUNKS) {
+      return CborErrorOutOfMemory;
+    }
+    a->total_len = reply->cbor_encoded_map_len;
+    a->started = true;
+  } else if (reply->cbor_encoded_map_len != a->total_len) {
+    /* the map changed under us */
+    return CborErrorImproperValue;
+  }
+
+  if (!a->total_len) {
+    return CborNoError;
+  }
+
+  /* checked without forming offset + chunk_len, which could wrap */
+  if (reply->offset % a->chunk_size || reply->offset > a->total_len ||
+      reply->chunk_len > a->total_len - reply->offset || !reply->cbor_data) {
+    return CborErrorImproperValue;
+  }
+  /* a whole-map reply fills every chunk */
+  const uint32_t first = reply->offset / a->chunk_size;
+  const uint32_t end = reply->offset + reply->chunk_len;
+  if ((size_t)end > a->capacity ||
+      (end != a->total_len && reply->chunk_len % a->chunk_size)) {
+    return CborErrorImproperValue;
+  }
+
+  memcpy(&a->buffer[reply->offset], reply->cbor_data, reply->chunk_len);
+  for (uint32_t chunk = first; chunk * a->chunk_size < end; chunk++) {
+    a->received[chunk / 32] |= 1u << (chunk % 32);
+  }
+
+  return CborNoError;
+}
+
+bool config_cbor_map_assembler_done(const ConfigCborMapAssembler *a) {
+  ConfigCborMapRequestData unused;
+  return a->started && !config_cbor_map_assembler_next_request(a, &unused);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "config_cbor_map_srv_reply_msg.h"
+#include "config_cbor_map_srv_request_msg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Paged transfer of a config partition's encoded CBOR map.
+//
+// The receiver asks for the map chunk_size bytes at a time with paged
+// requests (config_cbor_map_request_encode_paged()) and assembles the
+// replies (config_cbor_map_reply_encode_chunk()) into its own buffer, so
+// neither side needs a message buffer as large as the partition. Chunks may
+// arrive in any order; a lost chunk is simply requested again.
+
+#define CONFIG_CBOR_MAP_TRANSFER_MAX_CHUNKS 256
+
+typedef struct {
+  uint32_t partition_id;
+  uint32_t chunk_size;
+  uint32_t total_len;
+  bool started; // total_len is known once the first reply arrives
+  uint8_t *buffer;
+  size_t capacity;
+  uint32_t received[CONFIG_CBOR_MAP_TRANSFER_MAX_CHUNKS / 32];
+} ConfigCborMapAssembler;
+
+/*!
+ Fills reply with the chunk of map that request asks for, at most
+ max_chunk bytes. A request without paging gets the whole map. cbor_data
+ points into map, so the reply must be encoded before map changes. Returns
+ false if the request starts beyond the end of the map.
+*/
+bool config_cbor_map_reply_fill_chunk(ConfigCborMapReplyData *reply,
+                                      const ConfigCborMapRequestData *request,
+                                      const uint8_t *map, uint32_t map_len,
+                                      uint32_t max_chunk);
+
+/* chunk_size must be non-zero */
+void config_cbor_map_assembler_init(ConfigCborMapAssembler *a,
+                                    uint32_t partition_id, uint32_t chunk_size,
+                                    uint8_t *buffer, size_t capacity);
+
+/*!
+ Fills request with the first chunk not yet received. Returns false once
+ the whole map has been assembled.
+*/
+bool config_cbor_map_assembler_next_request(const ConfigCborMapAssembler *a,
+                                            ConfigCborMapRequestData *request);
+
+/*!
+ Copies the chunk carried by a decoded reply into place. Duplicates are
+ harmless.
+
+ @return CborNoError on success
+         CborErrorImproperValue if the reply is for another partition, failed,
+         or does not match the chunk layout
+         CborErrorOutOfMemory if the map does not fit in the buffer or needs
+         more than CONFIG_CBOR_MAP_TRANSFER_MAX_CHUNKS chunks
+*/
+CborError config_cbor_map_assembler_add(ConfigCborMapAssembler *a,
+                                        const ConfigCborMapReplyData *reply);
+
+bool config_cbor_map_assembler_done(const ConfigCborMapAssembler *a);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,117 @@
+#include "device_test_svc_bench.h"
+#include "bm_config.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef CI_TEST
+#include "bm_os.h"
+#else
+#define bm_free free
+#endif
+
+static int compare_u64(const void *a, const void *b) {
+  const uint64_t x = *static_cast<const uint64_t *>(a);
+  const uint64_t y = *static_cast<const uint64_t *>(b);
+  return x < y ? -1 : x > y;
+}
+
+/* decoded data the decoder allocated rather than pointing into the frame */
+static bool is_allocated(const uint8_t *data, const uint8_t *frame,
+                         size_t frame_size) {
+  return data && (data < frame || data >= frame + frame_size);
+}
+
+CborError DeviceTestSvcBench::run(const Config &c, uint32_t payload_len,
+                                  Result &r) {
+  if (payload_len > c.payload_size ||
+      payload_len + FRAME_OVERHEAD > c.frame_size || !c.iterations) {
+    return CborErrorOutOfMemory;
+  }
+  for (uint32_t i = 0; i < payload_len; i++) {
+    c.payload[i] = static_cast<uint8_t>(i * 31u + 7u);
+  }
+
+  memset(&r, 0, sizeof(r));
+  r.payload_len = payload_len;
+  r.iterations = c.iterations;
+
+  uint64_t total_ns = 0;
+  uint32_t allocations = 0;
+  CborError err = CborNoError;
+  for (uint32_t i = 0; i < c.iterations && err == CborNoError; i++) {
+    DeviceTestSvcRequestMsg::Data request = {payload_len, c.payload};
+    DeviceTestSvcRequestMsg::Data node_request = {0, NULL};
+    DeviceTestSvcReplyMsg::Data reply = {false, 0, NULL};
+    DeviceTestSvcReplyMsg::Data received = {false, 0, NULL};
+    size_t len = 0;
+
+    const uint64_t start = c.now_ns();
+    do {
+      if ((err = DeviceTestSvcRequestMsg::encode(request, c.request_frame,
+                                                 c.frame_size, &len)) !=
+          CborNoError) {
+        break;
+      }
+      err = c.zero_copy ? DeviceTestSvcRequestMsg::decode_view(
+                              node_request, c.request_frame, len)
+                        : DeviceTestSvcRequestMsg::decode(node_request,
+                                                          c.request_frame, len);
+      if (err != CborNoError) {
+        break;
+      }
+      reply.success = true;
+      reply.data_len = node_request.data_len;
+      reply.data = node_request.data;
+      if ((err = DeviceTestSvcReplyMsg::encode(reply, c.reply_frame,
+                                               c.frame_size, &len)) !=
+          CborNoError) {
+        break;
+      }
+      err = c.zero_copy
+                ? DeviceTestSvcReplyMsg::decode_view(received, c.reply_frame,
+                                                     len)
+                : DeviceTestSvcReplyMsg::decode(received, c.reply_frame, len);
+    } while (0);
+    const uint64_t elapsed = c.now_ns() - start;
+
+    if (err == CborNoError &&
+        (!received.success || received.data_len != payload_len ||
+         (payload_len && memcmp(received.data, c.payload, payload_len)))) {
+      err = CborErrorImproperValue;
+    }
+
+    if (is_allocated(node_request.data, c.request_frame, c.frame_size)) {
+      bm_free(node_request.data);
+      allocations++;
+    }
+    if (is_allocated(received.data, c.reply_frame, c.frame_size)) {
+      bm_free(received.data);
+      allocations++;
+    }
+
+    c.latencies_ns[i] = elapsed;
+    total_ns += elapsed;
+  }
+  if (err != CborNoError) {
+    return err;
+  }
+
+  qsort(c.latencies_ns, c.iterations, sizeof(*c.latencies_ns), compare_u64);
+  r.p50_ns = c.latencies_ns[(c.iterations - 1) * 50 / 100];
+  r.p99_ns = c.latencies_ns[(c.iterations - 1) * 99 / 100];
+  r.bytes_per_s = total_ns ? static_cast<double>(payload_len) * c.iterations *
+                                 1e9 / static_cast<double>(total_ns)
+                           : 0;
+  r.allocations = allocations / c.iterations;
+  return CborNoError;
+}
+
+CborError DeviceTestSvcBench::sweep(const Config &c, const uint32_t *sizes,
+                                    size_t num_sizes, Result *results) {
+  for (size_t i = 0; i < num_sizes; i++) {
+    CborError err = run(c, sizes[i], results[i]);
+    if (err != CborNoError) {
+      return err;
+    }
+  }
+  return CborNoError;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "device_test_svc_reply_msg.h"
+#include "device_test_svc_request_msg.h"
+
+// Loopback round trip benchmark over the DeviceTestSvc messages.
+//
+// Each round trip encodes a request carrying payload_len bytes into
+// request_frame, decodes it as the node would, echoes the data back in a
+// reply encoded into reply_frame and decodes that. The two frames stand in
+// for the transport. Timing uses the caller's clock. Allocations counts the
+// payload buffers the decoders allocated; they are freed outside the timed
+// section. Only the unit tests build this, it is not part of bmmessages.
+
+namespace DeviceTestSvcBench {
+
+// payload sizes swept by default, bytes to tens of KB
+constexpr uint32_t SWEEP_SIZES[] = {1, 16, 128, 1024, 8192, 32768};
+constexpr size_t NUM_SWEEP_SIZES = sizeof(SWEEP_SIZES) / sizeof(SWEEP_SIZES[0]);
+
+// encoded messages are at most this much larger than their payload
+constexpr size_t FRAME_OVERHEAD = 64;
+
+struct Config {
+  uint8_t *request_frame;
+  uint8_t *reply_frame;
+  size_t frame_size; // each frame, payload_len + FRAME_OVERHEAD is enough
+  uint8_t *payload;  // test vector storage
+  size_t payload_size;
+  uint64_t *latencies_ns; // iterations entries
+  uint32_t iterations;
+  uint64_t (*now_ns)(void);
+  bool zero_copy; // decode with decode_view, data stays in the frames
+};
+
+struct Result {
+  uint32_t payload_len;
+  uint32_t iterations;
+  double bytes_per_s; // payload bytes round tripped per second
+  uint64_t p50_ns;
+  uint64_t p99_ns;
+  uint32_t allocations; // per round trip
+};
+
+// Runs c.iterations round trips of payload_len bytes.
+//
+// Returns CborErrorOutOfMemory if payload_len does not fit in c.payload or
+// the frames, CborErrorImproperValue if a reply does not carry the data
+// sent, or the first encode/decode error.
+CborError run(const Config &c, uint32_t payload_len, Result &r);
+
+// Runs each of sizes in turn, stopping at the first error.
+CborError sweep(const Config &c, const uint32_t *sizes, size_t num_sizes,
+                Result *results);
+
+} // namespace DeviceTestSvcBench
@@ -87,8 +87,10 @@ CborError DeviceTestSvcReplyMsg::encode(Data &d, uint8_t *cbor_buffer,
   return err;
 }
 
-CborError DeviceTestSvcReplyMsg::decode(Data &d, const uint8_t *cbor_buffer,
-                                        size_t size) {
+namespace DeviceTestSvcReplyMsg {
+
+static CborError decode_data(Data &d, const uint8_t *cbor_buffer, size_t size,
+                             bool copy_data) {
   CborParser parser;
   CborValue map;
   CborError err = cbor_parser_init(cbor_buffer, size, 0, &parser, &map);
@@ -173,7 +175,23 @@ CborError DeviceTestSvcReplyMsg::decode(Data &d, const uint8_t *cbor_buffer,
     if (err != CborNoError) {
       break;
     }
-    if (d.data_len) {
+    if (d.data_len && !copy_data) {
+      size_t buflen;
+      if (!cbor_value_is_byte_string(&value) ||
+          !cbor_value_is_length_known(&value)) {
+        err = CborErrorIllegalType;
+        break;
+      }
+      err = cbor_value_get_string_length(&value, &buflen);
+      if (err != CborNoError) {
+        break;
+      }
+      if (buflen != d.data_len) {
+        err = CborErrorIllegalType;
+        break;
+      }
+      d.data = NULL; // set once advanced past the string
+    } else if (d.data_len) {
       size_t buflen = d.data_len;
 #ifndef CI_TEST
       uint8_t *buf = static_cast<uint8_t *>(bm_malloc(buflen));
@@ -196,6 +214,11 @@ CborError DeviceTestSvcReplyMsg::decode(Data &d, const uint8_t *cbor_buffer,
     if (err != CborNoError) {
       break;
     }
+    if (d.data_len && !copy_data) {
+      // definite length strings end with their bytes
+      d.data = const_cast<uint8_t *>(cbor_value_get_next_byte(&value)) -
+               d.data_len;
+    }
 
     if (err == CborNoError) {
       err = cbor_value_leave_container(&map, &value);
@@ -211,3 +234,16 @@ CborError DeviceTestSvcReplyMsg::decode(Data &d, const uint8_t *cbor_buffer,
 
   return err;
 }
+
+} // namespace DeviceTestSvcReplyMsg
+
+CborError DeviceTestSvcReplyMsg::decode(Data &d, const uint8_t *cbor_buffer,
+                                        size_t size) {
+  return decode_data(d, cbor_buffer, size, true);
+}
+
+CborError DeviceTestSvcReplyMsg::decode_view(Data &d,
+                                             const uint8_t *cbor_buffer,
+                                             size_t size) {
+  return decode_data(d, cbor_buffer, size, false);
+}
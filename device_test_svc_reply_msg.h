@@ -16,4 +16,8 @@ CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
 
 CborError decode(Data &d, const uint8_t *cbor_buffer, size_t size);
 
+// Like decode, but d.data points into cbor_buffer instead of a heap copy. It
+// is only valid while cbor_buffer is, and must not be written or freed.
+CborError decode_view(Data &d, const uint8_t *cbor_buffer, size_t size);
+
 } // namespace DeviceTestSvcReplyMsg
@@ -71,8 +71,10 @@ CborError DeviceTestSvcRequestMsg::encode(Data &d, uint8_t *cbor_buffer,
   return err;
 }
 
-CborError DeviceTestSvcRequestMsg::decode(Data &d, const uint8_t *cbor_buffer,
-                                          size_t size) {
+namespace DeviceTestSvcRequestMsg {
+
+static CborError decode_data(Data &d, const uint8_t *cbor_buffer, size_t size,
+                             bool copy_data) {
   CborParser parser;
   CborValue map;
   CborError err = cbor_parser_init(cbor_buffer, size, 0, &parser, &map);
@@ -137,7 +139,23 @@ CborError DeviceTestSvcRequestMsg::decode(Data &d, const uint8_t *cbor_buffer,
     if (err != CborNoError) {
       break;
     }
-    if (d.data_len) {
+    if (d.data_len && !copy_data) {
+      size_t buflen;
+      if (!cbor_value_is_byte_string(&value) ||
+          !cbor_value_is_length_known(&value)) {
+        err = CborErrorIllegalType;
+        break;
+      }
+      err = cbor_value_get_string_length(&value, &buflen);
+      if (err != CborNoError) {
+        break;
+      }
+      if (buflen != d.data_len) {
+        err = CborErrorIllegalType;
+        break;
+      }
+      d.data = NULL; // set once advanced past the string
+    } else if (d.data_len) {
       size_t buflen = d.data_len;
 #ifndef CI_TEST
       uint8_t *buf = static_cast<uint8_t *>(bm_malloc(buflen));
@@ -160,6 +178,11 @@ CborError DeviceTestSvcRequestMsg::decode(Data &d, const uint8_t *cbor_buffer,
     if (err != CborNoError) {
       break;
     }
+    if (d.data_len && !copy_data) {
+      // definite length strings end with their bytes
+      d.data = const_cast<uint8_t *>(cbor_value_get_next_byte(&value)) -
+               d.data_len;
+    }
 
     if (err == CborNoError) {
       err = cbor_value_leave_container(&map, &value);
@@ -175,3 +198,16 @@ CborError DeviceTestSvcRequestMsg::decode(Data &d, const uint8_t *cbor_buffer,
 
   return err;
 }
+
+} // namespace DeviceTestSvcRequestMsg
+
+CborError DeviceTestSvcRequestMsg::decode(Data &d, const uint8_t *cbor_buffer,
+                                          size_t size) {
+  return decode_data(d, cbor_buffer, size, true);
+}
+
+CborError DeviceTestSvcRequestMsg::decode_view(Data &d,
+                                               const uint8_t *cbor_buffer,
+                                               size_t size) {
+  return decode_data(d, cbor_buffer, size, false);
+}
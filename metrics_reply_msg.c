@@ -1,29 +1,115 @@
 #include "metrics_reply_msg.h"
+#include <string.h>
 
-CborError metrics_reply_encode(const MetricsReplyData *d, uint8_t *cbor_buffer,
-                               size_t size, size_t *encoded_len) {
+/* a field's bit pattern, so it can be compared with the snapshot */
+static bool field_word(const BmEncoderTableEntry *f, uint64_t *word) {
+  const size_t n = bm_field_scalar_size(f->type);
+  if (n) {
+    *word = 0;
+    memcpy(word, f->value_source, n);
+    return true;
+  }
+
+  /* the rest are tracked by hash; a collision is fixed by the next full reply */
+  switch (f->type) {
+  case BM_FIELD_STRING:
+  case BM_FIELD_BYTES:
+  case BM_FIELD_ARRAY: {
+    const BmFieldBuffer *b = (const BmFieldBuffer *)f->value_source;
+    const size_t size = f->type == BM_FIELD_ARRAY ? bm_field_scalar_size(b->element) : 1;
+    uint32_t h = bm_fnv1a(BM_FNV1A_INIT, &b->len, sizeof(b->len));
+    *word = bm_fnv1a(h, b->data, b->len * size);
+    return true;
+  }
+  case BM_FIELD_HISTOGRAM:
+  case BM_FIELD_HISTOGRAM_MERGE:
+    *word = bm_fnv1a(BM_FNV1A_INIT, f->value_source, sizeof(BmHistogram));
+    return true;
+  case BM_FIELD_SUMMARY:
+  case BM_FIELD_SUMMARY_MERGE: {
+    /* member by member, the struct has padding */
+    const BmSummary *sm = (const BmSummary *)f->value_source;
+    uint32_t h = bm_fnv1a(BM_FNV1A_INIT, &sm->count, sizeof(sm->count));
+    h = bm_fnv1a(h, &sm->min, sizeof(sm->min));
+    h = bm_fnv1a(h, &sm->max, sizeof(sm->max));
+    *word = bm_fnv1a(h, &sm->sum, sizeof(sm->sum));
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+static bool field_changed(const BmEncoderTableEntry *f, uint64_t last) {
+  uint64_t word;
+  return !field_word(f, &word) || word != last;
+}
+
+static size_t num_changed_fields(const MetricsComponent *c,
+                                 const uint64_t *snapshot) {
+  size_t n = 0;
+  for (size_t j = 0; j < c->num_fields; j++) {
+    n += field_changed(&c->fields[j], snapshot[j]);
+  }
+  return n;
+}
+
+/* snapshot NULL encodes every field, otherwise only the ones that differ */
+static CborError encode_reply(const MetricsReplyData *d,
+                              const uint64_t *snapshot, uint8_t *cbor_buffer,
+                              size_t size, size_t *encoded_len) {
   CborError err;
   CborEncoder encoder, map_encoder, data_map, comp_map;
+  size_t num_components = d->num_components;
+  size_t base = 0;
+
+  if (snapshot) {
+    num_components = 0;
+    for (size_t i = 0; i < d->num_components; i++) {
+      num_components += num_changed_fields(&d->components[i], &snapshot[base]) != 0;
+      base += d->components[i].num_fields;
+    }
+  }
 
   err = encoder_message_create(&encoder, &map_encoder, cbor_buffer, size,
-                               METRICS_REPLY_NUM_FIELDS);
+                               snapshot ? METRICS_REPLY_DELTA_NUM_FIELDS
+                                        : METRICS_REPLY_NUM_FIELDS);
 
   check_and_encode_key(err, encode_key_value_uint8(&map_encoder, "version", d->version));
   check_and_encode_key(err, encode_key_value_uint64(&map_encoder, "node_id", d->node_id));
   check_and_encode_key(err, encode_key_value_uint32(&map_encoder, "uptime_ms", d->uptime_ms));
+  if (snapshot) {
+    check_and_encode_key(err, cbor_encode_text_stringz(&map_encoder, "delta"));
+    check_and_encode_key(err, cbor_encode_boolean(&map_encoder, true));
+  }
 
   // "data": { "<component key>": { <flat fields> }, ... }
   check_and_encode_key(err, cbor_encode_text_stringz(&map_encoder, "data"));
   check_and_encode_key(err, cbor_encoder_create_map(&map_encoder, &data_map,
-                                                     d->num_components));
+                                                     num_components));
+  base = 0;
   for (size_t i = 0; i < d->num_components; i++) {
     const MetricsComponent *c = &d->components[i];
-    check_and_encode_key(err, cbor_encode_text_stringz(&data_map, c->key));
-    check_and_encode_key(err, cbor_encoder_create_map(&data_map, &comp_map,
-                                                       c->num_fields));
-    check_and_encode_key(err, bm_encode_fields_from_table(&comp_map, c->fields,
-                                                          c->num_fields));
-    check_and_encode_key(err, cbor_encoder_close_container(&data_map, &comp_map));
+    const size_t num_fields =
+        snapshot ? num_changed_fields(c, &snapshot[base]) : c->num_fields;
+    if (num_fields) {
+      check_and_encode_key(err, cbor_encode_text_stringz(&data_map, c->key));
+      check_and_encode_key(err, cbor_encoder_create_map(&data_map, &comp_map,
+                                                         num_fields));
+      if (!snapshot) {
+        check_and_encode_key(err, bm_encode_fields_from_table(&comp_map, c->fields,
+                                                              c->num_fields));
+      } else {
+        for (size_t j = 0; j < c->num_fields; j++) {
+          if (field_changed(&c->fields[j], snapshot[base + j])) {
+            check_and_encode_key(err, bm_encode_fields_from_table(&comp_map,
+                                                                  &c->fields[j], 1));
+          }
+        }
+      }
+      check_and_encode_key(err, cbor_encoder_close_container(&data_map, &comp_map));
+    }
+    base += c->num_fields;
   }
   check_and_encode_key(err, cbor_encoder_close_container(&map_encoder, &data_map));
 
@@ -37,14 +123,68 @@ CborError metrics_reply_encode(const MetricsReplyData *d, uint8_t *cbor_buffer,
   return err;
 }
 
+CborError metrics_reply_encode(const MetricsReplyData *d, uint8_t *cbor_buffer,
+                               size_t size, size_t *encoded_len) {
+  return encode_reply(d, NULL, cbor_buffer, size, encoded_len);
+}
+
+void metrics_delta_init(MetricsDeltaState *s, uint64_t *snapshot,
+                        size_t snapshot_len, uint32_t max_deltas) {
+  memset(s, 0, sizeof(*s));
+  s->snapshot = snapshot;
+  s->snapshot_len = snapshot_len;
+  s->max_deltas = max_deltas;
+}
+
+void metrics_delta_force_full(MetricsDeltaState *s) { s->valid = false; }
+
+CborError metrics_reply_encode_delta(const MetricsReplyData *d,
+                                     MetricsDeltaState *s, uint8_t *cbor_buffer,
+                                     size_t size, size_t *encoded_len) {
+  size_t total = 0;
+  for (size_t i = 0; i < d->num_components; i++) {
+    total += d->components[i].num_fields;
+  }
+  if (total > s->snapshot_len) {
+    return CborErrorOutOfMemory;
+  }
+
+  const bool full = !s->valid || s->deltas_sent >= s->max_deltas;
+  CborError err = encode_reply(d, full ? NULL : s->snapshot, cbor_buffer, size,
+                               encoded_len);
+  if (err != CborNoError) {
+    return err;
+  }
+
+  uint64_t *snapshot = s->snapshot;
+  for (size_t i = 0; i < d->num_components; i++) {
+    const MetricsComponent *c = &d->components[i];
+    for (size_t j = 0; j < c->num_fields; j++, snapshot++) {
+      if (!field_word(&c->fields[j], snapshot)) {
+        *snapshot = 0;
+      }
+    }
+  }
+  s->deltas_sent = full ? 0 : s->deltas_sent + 1;
+  s->valid = true;
+
+  return CborNoError;
+}
+
 CborError metrics_reply_decode(const uint8_t *cbor_buffer, size_t size,
                                 MetricsReplyDecode *out) {
   CborParser parser;
-  CborValue map, value, data_map, comp, field;
+  CborValue map, value, data_map, field;
   CborError err;
-  
-  err = decoder_message_enter(&map, &value, &parser, (uint8_t *)cbor_buffer,
-                              size, METRICS_REPLY_NUM_FIELDS);
+  size_t num_fields = 0;
+
+  /* a delta reply carries one field more, pick the layout before entering */
+  err = decoder_message_num_fields(cbor_buffer, size, &num_fields);
+  out->delta = num_fields == METRICS_REPLY_DELTA_NUM_FIELDS;
+  check_and_decode_key(err, decoder_message_enter(&map, &value, &parser,
+                                                  (uint8_t *)cbor_buffer, size,
+                                                  out->delta ? METRICS_REPLY_DELTA_NUM_FIELDS
+                                                             : METRICS_REPLY_NUM_FIELDS));
 
   /* metadata, decoded in wire order */
   check_and_decode_key(err, decode_key_value_uint8(&out->version, &value, "version"));
@@ -54,6 +194,27 @@ CborError metrics_reply_decode(const uint8_t *cbor_buffer, size_t size,
     return err;
   }
 
+  if (out->delta) {
+    bool is_delta = false;
+    if ((err = cbor_value_text_string_equals(&value, "delta", &is_delta)) != CborNoError) {
+      return err;
+    }
+    if (!is_delta) {
+      return CborErrorImproperValue;
+    }
+    if ((err = cbor_value_advance(&value)) != CborNoError) {
+      return err;
+    }
+    if (!cbor_value_is_boolean(&value)) {
+      return CborErrorIllegalType;
+    }
+    check_and_decode_key(err, cbor_value_get_boolean(&value, &out->delta));
+    check_and_decode_key(err, cbor_value_advance(&value));
+    if (!check_acceptable_decode_errors(err)) {
+      return err;
+    }
+  }
+
   // "data": { "<component>": { ...flat fields... }, ... }
   if (!cbor_value_is_text_string(&value)) {
     return CborErrorIllegalType;
@@ -64,26 +225,109 @@ CborError metrics_reply_decode(const uint8_t *cbor_buffer, size_t size,
   if (!cbor_value_is_map(&value)) {
     return CborErrorIllegalType;
   }
-  data_map = value;
 
-  for (size_t i = 0; i < out->num_components; i++) {
-    const MetricsComponentDecode *c = &out->components[i];
-    if ((err = cbor_value_map_find_value(&data_map, c->key, &comp)) != CborNoError) {
-      return err;
+  /*
+   * One pass over the data map. Each component key is looked up in a small
+   * hash table of the requested components, matched on its encoded bytes,
+   * so the map is never rescanned per component.
+   */
+  uint32_t hashes[METRICS_REPLY_DECODE_MAX_COMPONENTS];
+  uint8_t headers[METRICS_REPLY_DECODE_MAX_COMPONENTS][9];
+  size_t header_lens[METRICS_REPLY_DECODE_MAX_COMPONENTS];
+  uint8_t slots[2 * METRICS_REPLY_DECODE_MAX_COMPONENTS] = {0};
+  const bool indexed = out->num_components <= METRICS_REPLY_DECODE_MAX_COMPONENTS;
+  if (indexed) {
+    for (size_t i = 0; i < out->num_components; i++) {
+      hashes[i] = bm_cbor_key_hash(out->components[i].key, headers[i], &header_lens[i]);
+      size_t slot = hashes[i] % (2 * METRICS_REPLY_DECODE_MAX_COMPONENTS);
+      while (slots[slot]) {
+        slot = (slot + 1) % (2 * METRICS_REPLY_DECODE_MAX_COMPONENTS);
+      }
+      slots[slot] = (uint8_t)(i + 1);
+    }
+  }
+
+  if ((err = cbor_value_enter_container(&value, &data_map)) != CborNoError) {
+    return err;
+  }
+  while (!cbor_value_at_end(&data_map)) {
+    if (!cbor_value_is_text_string(&data_map)) {
+      return CborErrorIllegalType;
+    }
+    const MetricsComponentDecode *c = NULL;
+    if (indexed) {
+      const CborValue key_value = data_map;
+      const uint8_t *key = cbor_value_get_next_byte(&data_map);
+      if ((err = cbor_value_advance(&data_map)) != CborNoError) {
+        return err;
+      }
+      const size_t key_len = (size_t)(cbor_value_get_next_byte(&data_map) - key);
+      const uint32_t hash = bm_fnv1a(BM_FNV1A_INIT, key, key_len);
+      for (size_t slot = hash % (2 * METRICS_REPLY_DECODE_MAX_COMPONENTS); slots[slot];
+           slot = (slot + 1) % (2 * METRICS_REPLY_DECODE_MAX_COMPONENTS)) {
+        const size_t i = slots[slot] - 1;
+        if (hashes[i] == hash && key_len >= header_lens[i] &&
+            memcmp(key, headers[i], header_lens[i]) == 0 &&
+            strlen(out->components[i].key) == key_len - header_lens[i] &&
+            memcmp(key + header_lens[i], out->components[i].key, key_len - header_lens[i]) == 0) {
+          c = &out->components[i];
+          break;
+        }
+      }
+      /*
+       * The index only knows the shortest definite length encoding of each
+       * key. A chunked key or one with an oversized length header can still
+       * name a requested component, so compare those by value.
+       */
+      size_t text_len = 0;
+      uint8_t header[9];
+      if (!c && (!cbor_value_is_length_known(&key_value) ||
+                 cbor_value_get_string_length(&key_value, &text_len) != CborNoError ||
+                 bm_cbor_text_header(text_len, header) + text_len != key_len)) {
+        for (size_t i = 0; i < out->num_components && !c; i++) {
+          bool equal = false;
+          if ((err = cbor_value_text_string_equals(&key_value, out->components[i].key,
+                                                   &equal)) != CborNoError) {
+            return err;
+          }
+          c = equal ? &out->components[i] : NULL;
+        }
+      }
+    } else {
+      for (size_t i = 0; i < out->num_components && !c; i++) {
+        bool equal = false;
+        if ((err = cbor_value_text_string_equals(&data_map, out->components[i].key, &equal)) !=
+            CborNoError) {
+          return err;
+        }
+        c = equal ? &out->components[i] : NULL;
+      }
+      if ((err = cbor_value_advance(&data_map)) != CborNoError) {
+        return err;
+      }
     }
-    if (!cbor_value_is_valid(&comp)) {
-      continue; /* component not present in this reply */
+
+    if (!c) {
+      /* not requested, skip it */
+      if ((err = cbor_value_advance(&data_map)) != CborNoError) {
+        return err;
+      }
+      continue;
     }
-    if (!cbor_value_is_map(&comp)) {
+    if (!cbor_value_is_map(&data_map)) {
       return CborErrorIllegalType;
     }
-    if ((err = cbor_value_enter_container(&comp, &field)) != CborNoError) {
+    if ((err = cbor_value_enter_container(&data_map, &field)) != CborNoError) {
       return err;
     }
     err = bm_decode_fields_from_table(&field, c->fields, c->num_fields);
     if (err != CborNoError && err != CborErrorUnsupportedType) {
       return err;
     }
+    if ((err = cbor_value_leave_container(&data_map, &field)) != CborNoError) {
+      return err;
+    }
   }
+
   return CborNoError;
 }
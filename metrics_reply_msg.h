@@ -23,6 +23,23 @@ typedef struct {
   size_t num_components;
 } MetricsReplyData;
 
+// Delta replies carry only the fields that changed since the last reply
+// sent through the same MetricsDeltaState and add a "delta" key to the
+// envelope. Full replies keep the plain encoding.
+#define METRICS_REPLY_DELTA_NUM_FIELDS 5 // version, node_id, uptime_ms, delta, data
+
+typedef struct {
+  uint64_t *snapshot;  // last sent value of every field, components in order
+  size_t snapshot_len; // number of entries in snapshot
+  uint32_t max_deltas; // delta replies allowed between full ones
+  uint32_t deltas_sent;
+  bool valid;          // snapshot holds the last sent reply
+} MetricsDeltaState;
+
+// metrics_reply_decode() matches components through a hash table of up to
+// this many requested components; more fall back to comparing each key.
+#define METRICS_REPLY_DECODE_MAX_COMPONENTS 32
+
 typedef struct {
   const char *key;
   const BmDecodeTableEntry *fields;
@@ -33,6 +50,7 @@ typedef struct {
   uint8_t version;
   uint64_t node_id;
   uint32_t uptime_ms;
+  bool delta; // only changed fields were sent, the rest keep their values
   const MetricsComponentDecode *components;
   size_t num_components;
 } MetricsReplyDecode;
@@ -40,6 +58,35 @@ typedef struct {
 CborError metrics_reply_encode(const MetricsReplyData *d, uint8_t *cbor_buffer,
                                size_t size, size_t *encoded_len);
 
+/*!
+ snapshot is caller storage with one entry per field across all components
+ of the replies encoded with this state. Every max_deltas + 1 replies, and
+ the first, are full.
+*/
+void metrics_delta_init(MetricsDeltaState *s, uint64_t *snapshot,
+                        size_t snapshot_len, uint32_t max_deltas);
+
+/* makes the next metrics_reply_encode_delta() send a full reply, e.g. after
+ * the component table changed or a receiver lost track */
+void metrics_delta_force_full(MetricsDeltaState *s);
+
+/*!
+ Encodes a reply holding only the fields of d that differ from the last
+ reply encoded with s, or a full reply when one is due. The snapshot is
+ only updated if encoding succeeds.
+
+ @return as metrics_reply_encode(), or CborErrorOutOfMemory if d has more
+         fields than the snapshot holds
+*/
+CborError metrics_reply_encode_delta(const MetricsReplyData *d,
+                                     MetricsDeltaState *s, uint8_t *cbor_buffer,
+                                     size_t size, size_t *encoded_len);
+
+/*!
+ Decodes full and delta replies. Fields absent from a delta reply are left
+ untouched, so decoding every reply into the same destinations keeps them
+ current once a full reply has been seen.
+*/
 CborError metrics_reply_decode(const uint8_t *cbor_buffer, size_t size,
                                MetricsReplyDecode *out);
 
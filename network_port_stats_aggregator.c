@@ -0,0 +1,146 @@
+#include "network_port_stats_aggregator.h"
+#include <string.h>
+
+#define SERIES_MASK (NETWORK_PORT_SERIES_LEN - 1)
+
+static size_t series_slot(uint64_t node_id, uint8_t port, size_t capacity) {
+  uint64_t h = (node_id ^ ((uint64_t)port << 56 | port)) * 0x9e3779b97f4a7c15ull;
+  return (size_t)(h >> 32) & (capacity - 1);
+}
+
+static NetworkPortSeries *find_slot(const NetworkPortAggregator *a,
+                                    uint64_t node_id, uint8_t port) {
+  if (a->capacity == 0) {
+    return NULL;
+  }
+  size_t i = series_slot(node_id, port, a->capacity);
+  /* at least one slot is always free, so this terminates */
+  while (a->series[i].valid &&
+         (a->series[i].node_id != node_id || a->series[i].port != port)) {
+    i = (i + 1) & (a->capacity - 1);
+  }
+  return &a->series[i];
+}
+
+bool network_port_aggregator_init(NetworkPortAggregator *a,
+                                  NetworkPortSeries *series, size_t capacity) {
+  memset(a, 0, sizeof(*a));
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    /* left empty, find_slot() needs the mask */
+    return false;
+  }
+  memset(series, 0, capacity * sizeof(*series));
+  a->series = series;
+  a->capacity = capacity;
+  return true;
+}
+
+static void series_add(NetworkPortSeries *s, uint64_t time_ms,
+                       const NetworkPortStatsData *d, uint8_t port) {
+  const uint16_t raw[NETWORK_PORT_NUM_COUNTERS] = {
+      d->rxe[port], d->sye[port], d->fc[port], d->len[port], d->algn[port]};
+  const uint32_t i = s->head;
+  const uint32_t prev = (i - 1) & SERIES_MASK;
+
+  s->time_ms[i] = time_ms;
+  s->sqi[i] = d->sqi[port];
+  s->lq[i] = d->lq[port];
+  s->mse[i] = d->mse[port];
+  for (size_t c = 0; c < NETWORK_PORT_NUM_COUNTERS; c++) {
+    s->counters[c][i] =
+        s->count ? s->counters[c][prev] + (uint16_t)(raw[c] - s->last_raw[c])
+                 : raw[c];
+    s->last_raw[c] = raw[c];
+  }
+
+  s->head = (i + 1) & SERIES_MASK;
+  if (s->count < NETWORK_PORT_SERIES_LEN) {
+    s->count++;
+  }
+}
+
+size_t network_port_aggregator_add(NetworkPortAggregator *a, uint64_t node_id,
+                                   uint64_t time_ms,
+                                   const NetworkPortStatsData *d) {
+  size_t added = 0;
+  for (uint8_t port = 0;
+       port < d->num_ports && port < NETWORK_PORT_STATS_MAX_PORTS; port++) {
+    NetworkPortSeries *s = find_slot(a, node_id, port);
+    if (!s) {
+      break;
+    }
+    if (!s->valid) {
+      if (a->count + 1 >= a->capacity) {
+        continue;
+      }
+      memset(s, 0, sizeof(*s));
+      s->node_id = node_id;
+      s->port = port;
+      s->valid = true;
+      a->count++;
+    }
+    series_add(s, time_ms, d, port);
+    added++;
+  }
+  return added;
+}
+
+static NetworkPortGauge gauge_u8(const uint8_t *v, uint32_t first, uint32_t n) {
+  uint32_t min = UINT8_MAX, max = 0, sum = 0;
+  for (uint32_t j = 0; j < n; j++) {
+    const uint32_t x = v[(first + j) & SERIES_MASK];
+    min = x < min ? x : min;
+    max = x > max ? x : max;
+    sum += x;
+  }
+  NetworkPortGauge g = {(float)min, (float)max, (float)sum / (float)n};
+  return g;
+}
+
+static NetworkPortGauge gauge_u16(const uint16_t *v, uint32_t first,
+                                  uint32_t n) {
+  uint32_t min = UINT16_MAX, max = 0, sum = 0;
+  for (uint32_t j = 0; j < n; j++) {
+    const uint32_t x = v[(first + j) & SERIES_MASK];
+    min = x < min ? x : min;
+    max = x > max ? x : max;
+    sum += x;
+  }
+  NetworkPortGauge g = {(float)min, (float)max, (float)sum / (float)n};
+  return g;
+}
+
+bool network_port_aggregator_trend(const NetworkPortAggregator *a,
+                                   uint64_t node_id, uint8_t port,
+                                   uint64_t window_ms, NetworkPortTrend *out) {
+  const NetworkPortSeries *s = find_slot(a, node_id, port);
+  if (!s || !s->valid || !s->count) {
+    return false;
+  }
+
+  /* samples within the window, walking back from the newest */
+  const uint32_t newest = (s->head - 1) & SERIES_MASK;
+  const uint64_t t_newest = s->time_ms[newest];
+  uint32_t n = 1;
+  while (n < s->count &&
+         t_newest - s->time_ms[(newest - n) & SERIES_MASK] <= window_ms) {
+    n++;
+  }
+  const uint32_t first = (newest - (n - 1)) & SERIES_MASK;
+
+  memset(out, 0, sizeof(*out));
+  out->samples = n;
+  out->sqi = gauge_u8(s->sqi, first, n);
+  out->lq = gauge_u8(s->lq, first, n);
+  out->mse = gauge_u16(s->mse, first, n);
+
+  const uint64_t dt_ms = t_newest - s->time_ms[first];
+  if (n > 1 && dt_ms) {
+    for (size_t c = 0; c < NETWORK_PORT_NUM_COUNTERS; c++) {
+      out->error_rate[c] =
+          (float)(s->counters[c][newest] - s->counters[c][first]) * 1000.0f /
+          (float)dt_ms;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "network_port_stats_msg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Trend views over the NetworkPortStats replies of many nodes.
+//
+// Every (node_id, port) gets a series: a ring of the last
+// NETWORK_PORT_SERIES_LEN samples, stored as one array per metric so a
+// query over a window streams through contiguous memory. Error counters
+// are unwrapped to 32 bits as they are added, so rates stay correct across
+// the 16 bit wrap of the message fields (a counter reset on reboot reads as
+// a wrap). Series live in caller storage, found through an open addressing
+// table like ConfigCborMapCache.
+
+#define NETWORK_PORT_SERIES_LEN 32 // power of two
+#define NETWORK_PORT_NUM_COUNTERS 5 // rxe, sye, fc, len, algn
+
+typedef struct {
+  uint64_t node_id;
+  uint8_t port;
+  bool valid;
+  uint32_t head;  // next slot to write
+  uint32_t count; // samples held, up to NETWORK_PORT_SERIES_LEN
+  uint16_t last_raw[NETWORK_PORT_NUM_COUNTERS];
+  uint64_t time_ms[NETWORK_PORT_SERIES_LEN];
+  uint8_t sqi[NETWORK_PORT_SERIES_LEN];
+  uint8_t lq[NETWORK_PORT_SERIES_LEN];
+  uint16_t mse[NETWORK_PORT_SERIES_LEN];
+  uint32_t counters[NETWORK_PORT_NUM_COUNTERS][NETWORK_PORT_SERIES_LEN];
+} NetworkPortSeries;
+
+typedef struct {
+  NetworkPortSeries *series;
+  size_t capacity;
+  size_t count;
+} NetworkPortAggregator;
+
+typedef struct {
+  float min;
+  float max;
+  float mean;
+} NetworkPortGauge;
+
+typedef struct {
+  uint32_t samples; // samples within the window
+  NetworkPortGauge sqi;
+  NetworkPortGauge mse;
+  NetworkPortGauge lq;
+  // errors per second over the window, in the order rxe, sye, fc, len, algn
+  float error_rate[NETWORK_PORT_NUM_COUNTERS];
+} NetworkPortTrend;
+
+/*!
+ series is caller storage for capacity series; capacity must be a power of
+ two. The aggregator tracks at most capacity - 1 ports. Returns false, and
+ leaves an aggregator that records nothing, if capacity is not a power of two.
+*/
+bool network_port_aggregator_init(NetworkPortAggregator *a,
+                                  NetworkPortSeries *series, size_t capacity);
+
+/*!
+ Adds one decoded reply from node_id, taken at time_ms. Returns the number
+ of its ports recorded; ports without room for a new series are dropped.
+*/
+size_t network_port_aggregator_add(NetworkPortAggregator *a, uint64_t node_id,
+                                   uint64_t time_ms,
+                                   const NetworkPortStatsData *d);
+
+/*!
+ Trend of the samples of node_id/port taken within window_ms of its newest
+ sample. Rates need two samples and are 0 otherwise. Returns false if the
+ port has no samples.
+*/
+bool network_port_aggregator_trend(const NetworkPortAggregator *a,
+                                   uint64_t node_id, uint8_t port,
+                                   uint64_t window_ms, NetworkPortTrend *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,184 @@
+#include "network_port_stats_msg.h"
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+  const char *key;
+  size_t offset;
+} PortArray;
+
+static const PortArray counters[] = {
+    {"rxe", offsetof(NetworkPortStatsData, rxe)},
+    {"sye", offsetof(NetworkPortStatsData, sye)},
+    {"fc", offsetof(NetworkPortStatsData, fc)},
+    {"len", offsetof(NetworkPortStatsData, len)},
+    {"algn", offsetof(NetworkPortStatsData, algn)},
+};
+
+#define NUM_COUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+static const uint16_t *counter(const NetworkPortStatsData *d, size_t i) {
+  return (const uint16_t *)((const uint8_t *)d + counters[i].offset);
+}
+
+/* last NULL encodes the counters as they are, otherwise as deltas */
+static CborError encode_stats(const NetworkPortStatsData *d,
+                              const NetworkPortStatsData *last,
+                              uint8_t *cbor_buffer, size_t size,
+                              size_t *encoded_len) {
+  CborError err;
+  CborEncoder encoder, map_encoder;
+  const uint8_t n = d->num_ports;
+
+  if (n > NETWORK_PORT_STATS_MAX_PORTS) {
+    return CborErrorDataTooLarge;
+  }
+
+  err = encoder_message_create(&encoder, &map_encoder, cbor_buffer, size,
+                               last ? NETWORK_PORT_STATS_DELTA_NUM_FIELDS
+                                    : NETWORK_PORT_STATS_NUM_FIELDS);
+
+  check_and_encode_key(err, encode_key_value_uint8(&map_encoder, "num_ports", n));
+  if (last) {
+    check_and_encode_key(err, cbor_encode_text_stringz(&map_encoder, "delta"));
+    check_and_encode_key(err, cbor_encode_boolean(&map_encoder, true));
+  }
+  check_and_encode_key(err, encode_key_value_uint8_typed_array(&map_encoder, "sqi", d->sqi, n));
+  check_and_encode_key(err, encode_key_value_uint16_typed_array(&map_encoder, "mse", d->mse, n));
+  check_and_encode_key(err, encode_key_value_uint8_typed_array(&map_encoder, "lq", d->lq, n));
+  for (size_t c = 0; c < NUM_COUNTERS; c++) {
+    uint16_t values[NETWORK_PORT_STATS_MAX_PORTS];
+    for (size_t i = 0; i < n; i++) {
+      values[i] = last ? (uint16_t)(counter(d, c)[i] - counter(last, c)[i])
+                       : counter(d, c)[i];
+    }
+    check_and_encode_key(err, encode_key_value_uint16_typed_array(
+                                  &map_encoder, counters[c].key, values, n));
+  }
+
+  if (check_acceptable_encode_errors(err)) {
+    err = encoder_message_finish(&encoder, &map_encoder);
+    *encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+  }
+
+  encoder_message_check_memory(&encoder, err);
+
+  return err;
+}
+
+CborError network_port_stats_encode(const NetworkPortStatsData *d,
+                                    uint8_t *cbor_buffer, size_t size,
+                                    size_t *encoded_len) {
+  return encode_stats(d, NULL, cbor_buffer, size, encoded_len);
+}
+
+void network_port_stats_delta_init(NetworkPortStatsDeltaState *s,
+                                   uint32_t max_deltas) {
+  memset(s, 0, sizeof(*s));
+  s->max_deltas = max_deltas;
+}
+
+CborError network_port_stats_encode_delta(const NetworkPortStatsData *d,
+                                          NetworkPortStatsDeltaState *s,
+                                          uint8_t *cbor_buffer, size_t size,
+                                          size_t *encoded_len) {
+  const bool full = !s->valid || s->deltas_sent >= s->max_deltas ||
+                    s->last.num_ports != d->num_ports;
+  CborError err = encode_stats(d, full ? NULL : &s->last, cbor_buffer, size,
+                               encoded_len);
+  if (err != CborNoError) {
+    return err;
+  }
+  s->last = *d;
+  s->deltas_sent = full ? 0 : s->deltas_sent + 1;
+  s->valid = true;
+  return CborNoError;
+}
+
+/* every array must hold exactly num_ports elements */
+static CborError check_count(CborError err, size_t count, uint8_t num_ports) {
+  if (err == CborNoError && count != num_ports) {
+    err = CborErrorImproperValue;
+  }
+  return err;
+}
+
+CborError network_port_stats_decode(NetworkPortStatsData *d, bool *delta,
+                                    const uint8_t *cbor_buffer, size_t size) {
+  CborParser parser;
+  CborValue map, value;
+  CborError err;
+  bool is_delta = false;
+  size_t count;
+  size_t num_fields = 0;
+
+  /* a delta reply carries one field more, pick the layout before entering */
+  err = decoder_message_num_fields(cbor_buffer, size, &num_fields);
+  is_delta = num_fields == NETWORK_PORT_STATS_DELTA_NUM_FIELDS;
+  check_and_decode_key(err, decoder_message_enter(&map, &value, &parser,
+                                                  (uint8_t *)cbor_buffer, size,
+                                                  is_delta ? NETWORK_PORT_STATS_DELTA_NUM_FIELDS
+                                                           : NETWORK_PORT_STATS_NUM_FIELDS));
+
+  /* decoded aside, so d is only updated by a valid reply */
+  NetworkPortStatsData r;
+  if (is_delta) {
+    r = *d;
+  } else {
+    memset(&r, 0, sizeof(r));
+  }
+  check_and_decode_key(err, decode_key_value_uint8(&r.num_ports, &value, "num_ports"));
+  if (err == CborNoError && r.num_ports > NETWORK_PORT_STATS_MAX_PORTS) {
+    err = CborErrorOutOfMemory;
+  }
+  /* deltas only apply to the ports they were taken against, and the encoder
+     sends a full reply whenever the port count changes */
+  if (err == CborNoError && is_delta && r.num_ports != d->num_ports) {
+    err = CborErrorImproperValue;
+  }
+  if (err == CborNoError && is_delta) {
+    bool equal = false;
+    err = cbor_value_text_string_equals(&value, "delta", &equal);
+    if (err == CborNoError && !equal) {
+      err = CborErrorImproperValue;
+    }
+    check_and_decode_key(err, cbor_value_advance(&value));
+    if (err == CborNoError && !cbor_value_is_boolean(&value)) {
+      err = CborErrorIllegalType;
+    }
+    check_and_decode_key(err, cbor_value_get_boolean(&value, &is_delta));
+    check_and_decode_key(err, cbor_value_advance(&value));
+  }
+
+  count = NETWORK_PORT_STATS_MAX_PORTS;
+  check_and_decode_key(err, decode_key_value_uint8_typed_array(r.sqi, &count, &value, "sqi"));
+  err = check_count(err, count, r.num_ports);
+  count = NETWORK_PORT_STATS_MAX_PORTS;
+  check_and_decode_key(err, decode_key_value_uint16_typed_array(r.mse, &count, &value, "mse"));
+  err = check_count(err, count, r.num_ports);
+  count = NETWORK_PORT_STATS_MAX_PORTS;
+  check_and_decode_key(err, decode_key_value_uint8_typed_array(r.lq, &count, &value, "lq"));
+  err = check_count(err, count, r.num_ports);
+
+  for (size_t c = 0; c < NUM_COUNTERS && err == CborNoError; c++) {
+    uint16_t values[NETWORK_PORT_STATS_MAX_PORTS];
+    uint16_t *out = (uint16_t *)counter(&r, c);
+    count = NETWORK_PORT_STATS_MAX_PORTS;
+    err = decode_key_value_uint16_typed_array(values, &count, &value, counters[c].key);
+    err = check_count(err, count, r.num_ports);
+    for (size_t i = 0; err == CborNoError && i < count; i++) {
+      out[i] = is_delta ? (uint16_t)(out[i] + values[i]) : values[i];
+    }
+  }
+
+  check_and_decode_key(err, decoder_message_leave(&value, &map));
+
+  if (err == CborNoError) {
+    *d = r;
+    if (delta) {
+      *delta = is_delta;
+    }
+  }
+
+  return err;
+}
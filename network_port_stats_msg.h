@@ -0,0 +1,74 @@
+#pragma once
+#include "bm_messages_helper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-port link statistics, see msg/network_port_stats.msg.
+//
+// Each array holds num_ports elements and travels as an RFC 8746 typed
+// array, a tag and one byte string of packed elements, rather than one CBOR
+// item per element. uint16 arrays whose values all fit in a byte are sent
+// as uint8 arrays.
+//
+// The error counters rxe, sye, fc, len and algn can also be sent as deltas
+// against the last reply from the same NetworkPortStatsDeltaState. Delta
+// replies add a "delta" key after num_ports; the receiver adds the deltas,
+// modulo 2^16, to the counters it holds from earlier replies.
+
+#define NETWORK_PORT_STATS_MAX_PORTS 16
+#define NETWORK_PORT_STATS_NUM_FIELDS 9
+#define NETWORK_PORT_STATS_DELTA_NUM_FIELDS 10
+
+typedef struct {
+  uint8_t num_ports;
+  uint8_t sqi[NETWORK_PORT_STATS_MAX_PORTS];
+  uint16_t mse[NETWORK_PORT_STATS_MAX_PORTS];
+  uint8_t lq[NETWORK_PORT_STATS_MAX_PORTS];
+  uint16_t rxe[NETWORK_PORT_STATS_MAX_PORTS];
+  uint16_t sye[NETWORK_PORT_STATS_MAX_PORTS];
+  uint16_t fc[NETWORK_PORT_STATS_MAX_PORTS];
+  uint16_t len[NETWORK_PORT_STATS_MAX_PORTS];
+  uint16_t algn[NETWORK_PORT_STATS_MAX_PORTS];
+} NetworkPortStatsData;
+
+typedef struct {
+  NetworkPortStatsData last; // counters of the last reply sent
+  uint32_t max_deltas;       // delta replies allowed between full ones
+  uint32_t deltas_sent;
+  bool valid;                // last holds the last reply sent
+} NetworkPortStatsDeltaState;
+
+CborError network_port_stats_encode(const NetworkPortStatsData *d,
+                                    uint8_t *cbor_buffer, size_t size,
+                                    size_t *encoded_len);
+
+/*!
+ Decodes a full or delta reply into d without allocating. For a delta reply
+ d must hold the counters decoded so far for the same node. delta, if not
+ NULL, tells which kind was received.
+
+ @return CborErrorOutOfMemory if num_ports exceeds NETWORK_PORT_STATS_MAX_PORTS
+         CborErrorImproperValue if an array does not hold num_ports elements,
+         or a delta reply's num_ports differs from d->num_ports
+*/
+CborError network_port_stats_decode(NetworkPortStatsData *d, bool *delta,
+                                    const uint8_t *cbor_buffer, size_t size);
+
+void network_port_stats_delta_init(NetworkPortStatsDeltaState *s,
+                                   uint32_t max_deltas);
+
+/*!
+ Encodes a delta reply, or a full one when it is due: the first reply,
+ every max_deltas + 1 replies, and whenever num_ports changes. The state
+ only advances if encoding succeeds.
+*/
+CborError network_port_stats_encode_delta(const NetworkPortStatsData *d,
+                                          NetworkPortStatsDeltaState *s,
+                                          uint8_t *cbor_buffer, size_t size,
+                                          size_t *encoded_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #include "cbor.h"
 #include "sensor_header_msg.h"
+#include "sensor_stats_msg.h"
 
 // For the PME dissolved oxygen sensor
 
@@ -18,6 +19,17 @@ struct Data {
   float salinity_ppt;
 };
 
+// Fields summarized by SensorStatsMsg::Accumulator
+inline constexpr SensorStatsMsg::Field<Data> STATS_FIELDS[] = {
+    SENSOR_STATS_FIELD(Data, temperature_deg_c),
+    SENSOR_STATS_FIELD(Data, do_mg_per_l),
+    SENSOR_STATS_FIELD(Data, quality),
+    SENSOR_STATS_FIELD(Data, do_saturation_pct),
+    SENSOR_STATS_FIELD(Data, salinity_ppt),
+};
+using StatsAccumulator =
+    SensorStatsMsg::Accumulator<Data, sizeof(STATS_FIELDS) / sizeof(STATS_FIELDS[0])>;
+
 CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
                  size_t *encoded_len);
 
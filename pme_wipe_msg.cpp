@@ -4,6 +4,16 @@
 
 namespace PmeWipeMsg {
 
+const BmTemplateField TEMPLATE_FIELDS[NUM_FIELDS] = {
+    SENSOR_HEADER_FIELD_OFFSETS(Data),
+    {"wipe_time_sec", BM_FIELD_DOUBLE, offsetof(Data, wipe_time_sec)},
+    {"start1_mA", BM_FIELD_DOUBLE, offsetof(Data, start1_mA)},
+    {"avg_mA", BM_FIELD_DOUBLE, offsetof(Data, avg_mA)},
+    {"start2_mA", BM_FIELD_DOUBLE, offsetof(Data, start2_mA)},
+    {"final_mA", BM_FIELD_DOUBLE, offsetof(Data, final_mA)},
+    {"rsource", BM_FIELD_DOUBLE, offsetof(Data, rsource)},
+};
+
 CborError encode(Data &w, uint8_t *cbor_buffer, size_t size,
                  size_t *encoded_len) {
   CborError err;
@@ -1,5 +1,6 @@
 #pragma once
 #include "cbor.h"
+#include "bm_template_encoder.h"
 #include "sensor_header_msg.h"
 
 // For the wipe data from the PME dissolved oxygen sensor
@@ -19,6 +20,9 @@ struct Data {
   double rsource;
 };
 
+// Field table for bm_template_encoder, in encode order.
+extern const BmTemplateField TEMPLATE_FIELDS[NUM_FIELDS];
+
 CborError encode(Data &w, uint8_t *cbor_buffer, size_t size,
                  size_t *encoded_len);
 
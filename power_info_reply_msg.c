@@ -1,5 +1,15 @@
 #include "power_info_reply_msg.h"
 #include "bm_messages_helper.h"
+#include <stddef.h>
+
+const BmTemplateField
+    power_info_reply_template_fields[power_info_reply_msg_num_fields] = {
+        {"total_on_s", BM_FIELD_UINT32, offsetof(PowerInfoReplyData, total_on_s)},
+        {"remaining_on_s", BM_FIELD_UINT32,
+         offsetof(PowerInfoReplyData, remaining_on_s)},
+        {"upcoming_off_s", BM_FIELD_UINT32,
+         offsetof(PowerInfoReplyData, upcoming_off_s)},
+};
 
 CborError power_info_reply_encode(PowerInfoReplyData *d, uint8_t *cbor_buffer,
                                   size_t size, size_t *encoded_len) {
@@ -1,6 +1,7 @@
 #ifndef __POWER_INFO_REPLY_MSG_H__
 #define __POWER_INFO_REPLY_MSG_H__
 
+#include "bm_template_encoder.h"
 #include "cbor.h"
 #include <stdint.h>
 
@@ -16,6 +17,10 @@ typedef struct {
   uint32_t upcoming_off_s;
 } PowerInfoReplyData;
 
+// Field table for bm_template_encoder, in encode order.
+extern const BmTemplateField
+    power_info_reply_template_fields[power_info_reply_msg_num_fields];
+
 CborError power_info_reply_encode(PowerInfoReplyData *d, uint8_t *cbor_buffer,
                                   size_t size, size_t *encoded_len);
 CborError power_info_reply_decode(PowerInfoReplyData *d,
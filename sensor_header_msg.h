@@ -1,7 +1,33 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 #include "cbor.h"
 
+// Applies entry(type, key, BmField, member) to each header field of a message
+// struct with a `header` member, in encode order.
+#define SENSOR_HEADER_FIELDS(entry, type)                                      \
+  entry(type, "version", BM_FIELD_UINT32, version),                            \
+      entry(type, "reading_time_utc_ms", BM_FIELD_UINT64,                      \
+            reading_time_utc_ms),                                              \
+      entry(type, "reading_uptime_millis", BM_FIELD_UINT64,                    \
+            reading_uptime_millis),                                            \
+      entry(type, "sensor_reading_time_ms", BM_FIELD_UINT64,                   \
+            sensor_reading_time_ms)
+
+#define SENSOR_HEADER_OFFSET_ENTRY(type, key, field, member)                   \
+  { key, field, offsetof(type, header.member) }
+#define SENSOR_HEADER_STRUCT_ENTRY(type, key, field, member)                   \
+  { key, field, offsetof(type, header.member), NULL }
+
+// {key, BmField, offset} initializers for the header fields, used by the
+// field tables of the template encoder and the columnar archive.
+#define SENSOR_HEADER_FIELD_OFFSETS(type)                                      \
+  SENSOR_HEADER_FIELDS(SENSOR_HEADER_OFFSET_ENTRY, type)
+
+// The same header fields as BmStructField initializers, for struct tables.
+#define SENSOR_HEADER_STRUCT_FIELDS(type)                                      \
+  SENSOR_HEADER_FIELDS(SENSOR_HEADER_STRUCT_ENTRY, type)
+
 #ifdef __cplusplus
 namespace SensorHeaderMsg {
 
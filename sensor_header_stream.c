@@ -0,0 +1,295 @@
+#include "sensor_header_stream.h"
+#include <string.h>
+
+#if __has_include("bm_config.h")
+#include "bm_config.h"
+#else
+#define bm_debug printf
+#endif
+
+#define SENSOR_HEADER_STREAM_HEADER_FIELDS (4)
+#define SENSOR_HEADER_STREAM_KEYFRAME_LEN (5)
+#define SENSOR_HEADER_STREAM_DELTA_LEN (4)
+
+typedef struct {
+  uint32_t version;
+  uint64_t reading_time_utc_ms;
+  uint64_t reading_uptime_millis;
+  uint64_t sensor_reading_time_ms;
+} StreamHeader;
+
+static void read_header(const SensorHeaderStream *s, const void *src,
+                        StreamHeader *h) {
+  const uint8_t *base = (const uint8_t *)src;
+  memcpy(&h->version, base + s->fields[0].offset, sizeof(h->version));
+  memcpy(&h->reading_time_utc_ms, base + s->fields[1].offset,
+         sizeof(h->reading_time_utc_ms));
+  memcpy(&h->reading_uptime_millis, base + s->fields[2].offset,
+         sizeof(h->reading_uptime_millis));
+  memcpy(&h->sensor_reading_time_ms, base + s->fields[3].offset,
+         sizeof(h->sensor_reading_time_ms));
+}
+
+static void write_header(const SensorHeaderStream *s, void *dst,
+                         const StreamHeader *h) {
+  uint8_t *base = (uint8_t *)dst;
+  memcpy(base + s->fields[0].offset, &h->version, sizeof(h->version));
+  memcpy(base + s->fields[1].offset, &h->reading_time_utc_ms,
+         sizeof(h->reading_time_utc_ms));
+  memcpy(base + s->fields[2].offset, &h->reading_uptime_millis,
+         sizeof(h->reading_uptime_millis));
+  memcpy(base + s->fields[3].offset, &h->sensor_reading_time_ms,
+         sizeof(h->sensor_reading_time_ms));
+}
+
+static void save_context(SensorHeaderStream *s, const StreamHeader *h) {
+  s->version = h->version;
+  s->reading_time_utc_ms = h->reading_time_utc_ms;
+  s->reading_uptime_millis = h->reading_uptime_millis;
+  s->sensor_reading_time_ms = h->sensor_reading_time_ms;
+  s->synced = true;
+}
+
+CborError sensor_header_stream_init(SensorHeaderStream *s,
+                                    const BmTemplateField *fields,
+                                    size_t num_fields,
+                                    uint16_t keyframe_interval) {
+  static const BmField header_types[SENSOR_HEADER_STREAM_HEADER_FIELDS] = {
+      BM_FIELD_UINT32, BM_FIELD_UINT64, BM_FIELD_UINT64, BM_FIELD_UINT64};
+
+  if (num_fields < SENSOR_HEADER_STREAM_HEADER_FIELDS ||
+      num_fields > BM_TEMPLATE_MAX_FIELDS) {
+    bm_debug("error: %s: unsupported number of fields: %zu\r\n", __func__,
+             num_fields);
+    return CborErrorImproperValue;
+  }
+  for (size_t i = 0; i < SENSOR_HEADER_STREAM_HEADER_FIELDS; i++) {
+    if (fields[i].type != header_types[i]) {
+      bm_debug("error: %s: table does not start with the sensor header\r\n",
+               __func__);
+      return CborErrorImproperValue;
+    }
+  }
+
+  memset(s, 0, sizeof(*s));
+  s->fields = fields;
+  s->num_fields = num_fields;
+  s->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+  return CborNoError;
+}
+
+void sensor_header_stream_reset(SensorHeaderStream *s) {
+  s->synced = false;
+  s->since_keyframe = 0;
+}
+
+static CborError encode_header(CborEncoder *map_encoder, const StreamHeader *h,
+                               const SensorHeaderStream *s, uint16_t seq,
+                               bool delta) {
+  CborError err;
+  CborEncoder array_encoder;
+
+  err = cbor_encode_text_stringz(map_encoder, SENSOR_HEADER_STREAM_KEY);
+  check_and_encode_key(
+      err, cbor_encoder_create_array(map_encoder, &array_encoder,
+                                     delta ? SENSOR_HEADER_STREAM_DELTA_LEN
+                                           : SENSOR_HEADER_STREAM_KEYFRAME_LEN));
+  check_and_encode_key(err, cbor_encode_uint(&array_encoder,
+                                             ((uint32_t)seq << 1) | delta));
+  if (delta) {
+    // unsigned differences wrap, the decoder adds them back modulo 2^64
+    check_and_encode_key(
+        err, cbor_encode_int(&array_encoder,
+                             (int64_t)(h->reading_time_utc_ms -
+                                       s->reading_time_utc_ms)));
+    check_and_encode_key(
+        err, cbor_encode_int(&array_encoder,
+                             (int64_t)(h->reading_uptime_millis -
+                                       s->reading_uptime_millis)));
+    check_and_encode_key(
+        err, cbor_encode_int(&array_encoder,
+                             (int64_t)(h->sensor_reading_time_ms -
+                                       s->sensor_reading_time_ms)));
+  } else {
+    check_and_encode_key(err, cbor_encode_uint(&array_encoder, h->version));
+    check_and_encode_key(
+        err, cbor_encode_uint(&array_encoder, h->reading_time_utc_ms));
+    check_and_encode_key(
+        err, cbor_encode_uint(&array_encoder, h->reading_uptime_millis));
+    check_and_encode_key(
+        err, cbor_encode_uint(&array_encoder, h->sensor_reading_time_ms));
+  }
+  check_and_encode_key(err,
+                       cbor_encoder_close_container(map_encoder, &array_encoder));
+
+  return err;
+}
+
+CborError sensor_header_stream_encode(SensorHeaderStream *s, const void *src,
+                                      uint8_t *cbor_buffer, size_t size,
+                                      size_t *encoded_len) {
+  CborError err;
+  CborEncoder encoder, map_encoder;
+  BmEncoderTableEntry body[BM_TEMPLATE_MAX_FIELDS];
+  const size_t body_len = s->num_fields - SENSOR_HEADER_STREAM_HEADER_FIELDS;
+  const uint8_t *base = (const uint8_t *)src;
+  StreamHeader h;
+
+  read_header(s, src, &h);
+  const bool delta = s->synced && s->version == h.version &&
+                     s->since_keyframe < s->keyframe_interval;
+
+  for (size_t i = 0; i < body_len; i++) {
+    const BmTemplateField *f = &s->fields[SENSOR_HEADER_STREAM_HEADER_FIELDS + i];
+    body[i].key = f->key;
+    body[i].type = f->type;
+    body[i].value_source = base + f->offset;
+  }
+
+  err = encoder_message_create(&encoder, &map_encoder, cbor_buffer, size,
+                               body_len + 1);
+  check_and_encode_key(err, encode_header(&map_encoder, &h, s, s->seq, delta));
+  check_and_encode_key(err, bm_encode_fields_from_table(&map_encoder, body, body_len));
+  if (check_acceptable_encode_errors(err)) {
+    err = encoder_message_finish(&encoder, &map_encoder);
+  }
+
+  encoder_message_check_memory(&encoder, err);
+
+  // Only a frame that was actually produced moves the stream forward
+  if (err == CborNoError) {
+    *encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+    s->since_keyframe = delta ? s->since_keyframe + 1 : 1;
+    s->seq++;
+    save_context(s, &h);
+  }
+
+  return err;
+}
+
+static CborError decode_header(CborValue *value, SensorHeaderStream *s,
+                               StreamHeader *h, uint16_t *seq) {
+  CborError err;
+  CborValue array;
+  size_t len;
+  uint64_t tag;
+
+  if (!cbor_value_is_text_string(value)) {
+    bm_debug("error: %s: expected string key but got something else\r\n",
+             __func__);
+    return CborErrorIllegalType;
+  }
+  bool is_header_key = false;
+  err = cbor_value_text_string_equals(value, SENSOR_HEADER_STREAM_KEY,
+                                      &is_header_key);
+  if (err != CborNoError) {
+    return err;
+  }
+  if (!is_header_key) {
+    bm_debug("error: %s: expected %s key\r\n", __func__,
+             SENSOR_HEADER_STREAM_KEY);
+    return CborErrorImproperValue;
+  }
+  if ((err = cbor_value_advance(value)) != CborNoError) {
+    return err;
+  }
+  if (!cbor_value_is_array(value)) {
+    return CborErrorIllegalType;
+  }
+  if ((err = cbor_value_get_array_length(value, &len)) != CborNoError) {
+    return err;
+  }
+  if ((err = cbor_value_enter_container(value, &array)) != CborNoError) {
+    return err;
+  }
+  if (!cbor_value_is_unsigned_integer(&array)) {
+    return CborErrorIllegalType;
+  }
+  cbor_value_get_uint64(&array, &tag);
+  if ((err = cbor_value_advance(&array)) != CborNoError) {
+    return err;
+  }
+  *seq = (uint16_t)(tag >> 1);
+
+  if (tag & 1) {
+    int64_t d[3];
+    if (len != SENSOR_HEADER_STREAM_DELTA_LEN) {
+      return CborErrorImproperValue;
+    }
+    for (size_t i = 0; i < 3; i++) {
+      if (!cbor_value_is_integer(&array)) {
+        return CborErrorIllegalType;
+      }
+      cbor_value_get_int64(&array, &d[i]);
+      if ((err = cbor_value_advance(&array)) != CborNoError) {
+        return err;
+      }
+    }
+    if (!s->synced || *seq != (uint16_t)(s->seq + 1)) {
+      bm_debug("error: %s: delta frame %u without context (last %u, synced %d)\r\n",
+               __func__, *seq, s->seq, s->synced);
+      s->synced = false;
+      return CborErrorImproperValue;
+    }
+    h->version = s->version;
+    h->reading_time_utc_ms = s->reading_time_utc_ms + (uint64_t)d[0];
+    h->reading_uptime_millis = s->reading_uptime_millis + (uint64_t)d[1];
+    h->sensor_reading_time_ms = s->sensor_reading_time_ms + (uint64_t)d[2];
+  } else {
+    uint64_t v[4];
+    if (len != SENSOR_HEADER_STREAM_KEYFRAME_LEN) {
+      return CborErrorImproperValue;
+    }
+    for (size_t i = 0; i < 4; i++) {
+      if (!cbor_value_is_unsigned_integer(&array)) {
+        return CborErrorIllegalType;
+      }
+      cbor_value_get_uint64(&array, &v[i]);
+      if ((err = cbor_value_advance(&array)) != CborNoError) {
+        return err;
+      }
+    }
+    if (v[0] > UINT32_MAX) {
+      return CborErrorDataTooLarge;
+    }
+    h->version = (uint32_t)v[0];
+    h->reading_time_utc_ms = v[1];
+    h->reading_uptime_millis = v[2];
+    h->sensor_reading_time_ms = v[3];
+  }
+
+  return cbor_value_leave_container(value, &array);
+}
+
+CborError sensor_header_stream_decode(SensorHeaderStream *s, void *dst,
+                                      const uint8_t *cbor_buffer, size_t size) {
+  CborError err;
+  CborParser parser;
+  CborValue map, value;
+  BmDecodeTableEntry body[BM_TEMPLATE_MAX_FIELDS];
+  const size_t body_len = s->num_fields - SENSOR_HEADER_STREAM_HEADER_FIELDS;
+  uint8_t *base = (uint8_t *)dst;
+  StreamHeader h;
+  uint16_t seq = 0;
+
+  for (size_t i = 0; i < body_len; i++) {
+    const BmTemplateField *f = &s->fields[SENSOR_HEADER_STREAM_HEADER_FIELDS + i];
+    body[i].key = f->key;
+    body[i].type = f->type;
+    body[i].value_desitination = base + f->offset;
+  }
+
+  err = decoder_message_enter(&map, &value, &parser, (uint8_t *)cbor_buffer,
+                              size, body_len + 1);
+  check_and_decode_key(err, decode_header(&value, s, &h, &seq));
+  check_and_decode_key(err, bm_decode_fields_from_table(&value, body, body_len));
+  check_and_decode_key(err, decoder_message_leave(&value, &map));
+
+  if (err == CborNoError) {
+    write_header(s, dst, &h);
+    s->seq = seq;
+    save_context(s, &h);
+  }
+
+  return err;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "bm_template_encoder.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stateful stream codec for sensor messages sent repeatedly over one link.
+//
+// The four SensorHeaderMsg fields are replaced by a single "hdr" entry
+// holding an array. A keyframe carries the full header:
+//   [seq << 1, version, reading_time_utc_ms, reading_uptime_millis,
+//    sensor_reading_time_ms]
+// and a delta frame carries the signed differences of the three timestamps
+// against the previous frame on the same stream:
+//   [(seq << 1) | 1, d_reading_time_utc_ms, d_reading_uptime_millis,
+//    d_sensor_reading_time_ms]
+// The remaining fields are encoded as usual. seq is a 16 bit frame counter.
+//
+// The encoder sends a keyframe on the first frame, every keyframe_interval
+// frames, after a reset and whenever the version changes. The decoder
+// rejects delta frames with CborErrorImproperValue unless it holds the
+// context of the immediately preceding frame, and stays unsynced until the
+// next keyframe.
+//
+// Both ends are set up with the same field table, e.g. one of the
+// TEMPLATE_FIELDS tables, which must start with SENSOR_HEADER_FIELD_OFFSETS.
+
+#define SENSOR_HEADER_STREAM_KEY "hdr"
+#define SENSOR_HEADER_STREAM_DEFAULT_KEYFRAME_INTERVAL (64)
+
+typedef struct {
+  const BmTemplateField *fields;
+  size_t num_fields;
+  uint16_t keyframe_interval;
+  uint16_t seq;            // encoder: next seq to send, decoder: last seq received
+  uint16_t since_keyframe; // frames sent since the last keyframe
+  bool synced;             // holds the previous frame's header
+
+  // header of the previous frame
+  uint32_t version;
+  uint64_t reading_time_utc_ms;
+  uint64_t reading_uptime_millis;
+  uint64_t sensor_reading_time_ms;
+} SensorHeaderStream;
+
+CborError sensor_header_stream_init(SensorHeaderStream *s,
+                                    const BmTemplateField *fields,
+                                    size_t num_fields,
+                                    uint16_t keyframe_interval);
+
+// Drops the context; the encoder sends a keyframe next and the decoder waits
+// for one.
+void sensor_header_stream_reset(SensorHeaderStream *s);
+
+CborError sensor_header_stream_encode(SensorHeaderStream *s, const void *src,
+                                      uint8_t *cbor_buffer, size_t size,
+                                      size_t *encoded_len);
+
+CborError sensor_header_stream_decode(SensorHeaderStream *s, void *dst,
+                                      const uint8_t *cbor_buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
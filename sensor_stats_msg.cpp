@@ -0,0 +1,144 @@
+#include "sensor_stats_msg.h"
+#include "bm_config.h"
+#include "bm_messages_helper.h"
+
+namespace SensorStatsMsg {
+
+static CborError encode_field_stats(CborEncoder &map_encoder, const FieldStats &s) {
+  CborError err;
+  CborEncoder array_encoder;
+
+  err = cbor_encode_text_stringz(&map_encoder, s.key);
+  check_and_encode_key(err,
+                       cbor_encoder_create_array(&map_encoder, &array_encoder, NUM_VALUES));
+  check_and_encode_key(err, cbor_encode_float(&array_encoder, s.mean));
+  check_and_encode_key(err, cbor_encode_float(&array_encoder, s.min));
+  check_and_encode_key(err, cbor_encode_float(&array_encoder, s.max));
+  check_and_encode_key(err, cbor_encode_float(&array_encoder, s.stdev));
+  check_and_encode_key(err, cbor_encoder_close_container(&map_encoder, &array_encoder));
+
+  return err;
+}
+
+static CborError decode_field_stats(CborValue &value, FieldStats &s) {
+  CborError err;
+  CborValue array;
+  size_t len = MAX_KEY_LEN - 1;
+  float *out[NUM_VALUES] = {&s.mean, &s.min, &s.max, &s.stdev};
+
+  if (!cbor_value_is_text_string(&value)) {
+    bm_debug("expected string key but got something else\n");
+    return CborErrorIllegalType;
+  }
+  err = cbor_value_copy_text_string(&value, s.key, &len, NULL);
+  if (err != CborNoError) {
+    bm_debug("field stats key too long\n");
+    return err;
+  }
+  s.key[len] = '\0';
+  if ((err = cbor_value_advance(&value)) != CborNoError) {
+    return err;
+  }
+
+  if (!cbor_value_is_array(&value)) {
+    bm_debug("expected array but got something else\n");
+    return CborErrorIllegalType;
+  }
+  if ((err = cbor_value_get_array_length(&value, &len)) != CborNoError) {
+    return err;
+  }
+  if (len != NUM_VALUES) {
+    return CborErrorImproperValue;
+  }
+  if ((err = cbor_value_enter_container(&value, &array)) != CborNoError) {
+    return err;
+  }
+  for (size_t i = 0; i < NUM_VALUES; i++) {
+    if (!cbor_value_is_float(&array)) {
+      return CborErrorIllegalType;
+    }
+    cbor_value_get_float(&array, out[i]);
+    if ((err = cbor_value_advance(&array)) != CborNoError) {
+      return err;
+    }
+  }
+
+  return cbor_value_leave_container(&value, &array);
+}
+
+CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
+                 size_t *encoded_len) {
+  CborError err;
+  CborEncoder encoder, map_encoder;
+
+  if (d.num_fields > MAX_FIELDS) {
+    return CborErrorTooManyItems;
+  }
+
+  err = encoder_message_create(&encoder, &map_encoder, cbor_buffer, size,
+                               NUM_FIXED_FIELDS + d.num_fields);
+
+  check_and_encode_key(err, SensorHeaderMsg::encode(map_encoder, d.header));
+  check_and_encode_key(err, encode_key_value_uint32(&map_encoder, NUM_SAMPLES, d.num_samples));
+  check_and_encode_key(err, encode_key_value_uint64(&map_encoder, WINDOW_START_UTC_MS,
+                                                    d.window_start_utc_ms));
+  for (size_t i = 0; i < d.num_fields; i++) {
+    check_and_encode_key(err, encode_field_stats(map_encoder, d.fields[i]));
+  }
+
+  if (check_acceptable_encode_errors(err)) {
+    err = encoder_message_finish(&encoder, &map_encoder);
+    *encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+  }
+
+  encoder_message_check_memory(&encoder, err);
+
+  return err;
+}
+
+CborError decode(Data &d, const uint8_t *cbor_buffer, size_t size) {
+  CborParser parser;
+  CborValue map, value;
+  size_t num_fields = 0;
+
+  CborError err = cbor_parser_init(cbor_buffer, size, 0, &parser, &map);
+  check_and_decode_key(err, cbor_value_validate_basic(&map));
+  if (err == CborNoError && !cbor_value_is_map(&map)) {
+    err = CborErrorIllegalType;
+  }
+  check_and_decode_key(err, cbor_value_get_map_length(&map, &num_fields));
+  if (err != CborNoError) {
+    return err;
+  }
+  if (num_fields < NUM_FIXED_FIELDS || num_fields - NUM_FIXED_FIELDS > MAX_FIELDS) {
+    bm_debug("unexpected number of fields: %zu\n", num_fields);
+    return CborErrorUnknownLength;
+  }
+  d.num_fields = num_fields - NUM_FIXED_FIELDS;
+
+  err = cbor_value_enter_container(&map, &value);
+  check_and_decode_key(err, SensorHeaderMsg::decode(value, d.header));
+  check_and_decode_key(err, decode_key_value_uint32(&d.num_samples, &value, NUM_SAMPLES));
+  check_and_decode_key(err, decode_key_value_uint64(&d.window_start_utc_ms, &value,
+                                                    WINDOW_START_UTC_MS));
+  for (size_t i = 0; i < d.num_fields; i++) {
+    check_and_decode_key(err, decode_field_stats(value, d.fields[i]));
+  }
+
+  if (check_acceptable_decode_errors(err)) {
+    err = decoder_message_leave(&value, &map);
+  }
+
+  return err;
+}
+
+const FieldStats *find(const Data &d, const char *key) {
+  for (size_t i = 0; i < d.num_fields && i < MAX_FIELDS; i++) {
+    if (strncmp(d.fields[i].key, key, MAX_KEY_LEN) == 0) {
+      return &d.fields[i];
+    }
+  }
+  return nullptr;
+}
+
+} // namespace SensorStatsMsg
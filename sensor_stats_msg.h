@@ -0,0 +1,138 @@
+#pragma once
+#include "cbor.h"
+#include "sensor_header_msg.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Periodic summary of a sensor's readings.
+//
+// An Accumulator is driven by a compile-time list of the numeric fields of a
+// message's Data struct (see STATS_FIELDS in the message headers) and keeps
+// count/mean/min/max/stdev for each of them using Welford's method. The
+// summary message carries, per field, a 4 element float array
+// [mean, min, max, stdev] keyed by the field name.
+
+namespace SensorStatsMsg {
+
+constexpr uint32_t VERSION = 1;
+constexpr size_t NUM_FIXED_FIELDS = 2 + SensorHeaderMsg::NUM_FIELDS;
+constexpr size_t MAX_FIELDS = 16;
+constexpr size_t MAX_KEY_LEN = 32;
+constexpr size_t NUM_VALUES = 4;
+static constexpr char NUM_SAMPLES[] = "num_samples";
+static constexpr char WINDOW_START_UTC_MS[] = "window_start_utc_ms";
+
+struct FieldStats {
+  char key[MAX_KEY_LEN];
+  float mean;
+  float min;
+  float max;
+  float stdev;
+};
+
+struct Data {
+  // header of the last sample in the window, with version set to VERSION
+  SensorHeaderMsg::Data header;
+  uint32_t num_samples;
+  uint64_t window_start_utc_ms;
+  size_t num_fields;
+  FieldStats fields[MAX_FIELDS];
+};
+
+CborError encode(Data &d, uint8_t *cbor_buffer, size_t size,
+                 size_t *encoded_len);
+
+CborError decode(Data &d, const uint8_t *cbor_buffer, size_t size);
+
+// Returns the stats of the named field, or nullptr if there are none.
+const FieldStats *find(const Data &d, const char *key);
+
+template <typename D> struct Field {
+  const char *key;
+  double (*get)(const D &);
+};
+
+template <typename D, auto Member> double get(const D &d) {
+  return static_cast<double>(d.*Member);
+}
+
+#define SENSOR_STATS_FIELD(type, member)                                       \
+  SensorStatsMsg::Field<type> {                                                \
+    #member, &SensorStatsMsg::get<type, &type::member>                         \
+  }
+
+template <typename D, size_t N> struct Accumulator {
+  static_assert(N <= MAX_FIELDS, "too many fields for a summary");
+  const Field<D> *fields;
+  uint32_t num_samples;
+  uint64_t window_start_utc_ms;
+  SensorHeaderMsg::Data last_header;
+  double mean[N];
+  double m2[N];
+  double min[N];
+  double max[N];
+};
+
+template <typename D, size_t N>
+void accumulator_reset(Accumulator<D, N> &a) {
+  a.num_samples = 0;
+  a.window_start_utc_ms = 0;
+  memset(&a.last_header, 0, sizeof(a.last_header));
+  for (size_t i = 0; i < N; i++) {
+    a.mean[i] = 0;
+    a.m2[i] = 0;
+    a.min[i] = DBL_MAX;
+    a.max[i] = -DBL_MAX;
+  }
+}
+
+template <typename D, size_t N>
+void accumulator_init(Accumulator<D, N> &a, const Field<D> (&fields)[N]) {
+  a.fields = fields;
+  accumulator_reset(a);
+}
+
+template <typename D, size_t N>
+void accumulator_add(Accumulator<D, N> &a, const D &d) {
+  if (a.num_samples == 0) {
+    a.window_start_utc_ms = d.header.reading_time_utc_ms;
+  }
+  a.num_samples++;
+  a.last_header = d.header;
+  for (size_t i = 0; i < N; i++) {
+    const double x = a.fields[i].get(d);
+    const double delta = x - a.mean[i];
+    a.mean[i] += delta / a.num_samples;
+    a.m2[i] += delta * (x - a.mean[i]);
+    a.min[i] = x < a.min[i] ? x : a.min[i];
+    a.max[i] = x > a.max[i] ? x : a.max[i];
+  }
+}
+
+// Fills a summary message from the samples added since the last reset.
+template <typename D, size_t N>
+void accumulator_summary(const Accumulator<D, N> &a, Data &summary) {
+  summary.header = a.last_header;
+  summary.header.version = VERSION;
+  summary.num_samples = a.num_samples;
+  summary.window_start_utc_ms = a.window_start_utc_ms;
+  summary.num_fields = N;
+  for (size_t i = 0; i < N; i++) {
+    FieldStats &s = summary.fields[i];
+    strncpy(s.key, a.fields[i].key, MAX_KEY_LEN - 1);
+    s.key[MAX_KEY_LEN - 1] = '\0';
+    if (a.num_samples == 0) {
+      s.mean = s.min = s.max = s.stdev = NAN;
+      continue;
+    }
+    s.mean = static_cast<float>(a.mean[i]);
+    s.min = static_cast<float>(a.min[i]);
+    s.max = static_cast<float>(a.max[i]);
+    s.stdev = a.num_samples > 1
+                  ? static_cast<float>(sqrt(a.m2[i] / (a.num_samples - 1)))
+                  : 0.0f;
+  }
+}
+
+} // namespace SensorStatsMsg
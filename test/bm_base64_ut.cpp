@@ -0,0 +1,120 @@
+#include "bm_base64.h"
+#include "bm_messages_helper.h"
+#include "gtest/gtest.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The fixture for testing class
+class Base64Test : public ::testing::Test {
+protected:
+  uint8_t src[300];
+  char encoded[bm_base64_encoded_len(300)];
+  uint8_t decoded[300];
+  Base64Test() {}
+  ~Base64Test() override {}
+  void SetUp() override {
+    srand(1234);
+    for (size_t i = 0; i < sizeof(src); i++) {
+      src[i] = (uint8_t)rand();
+    }
+  }
+  void TearDown() override {}
+};
+
+TEST_F(Base64Test, KnownVectors) {
+  const char *plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+  const char *expected[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+  for (size_t i = 0; i < 7; i++) {
+    size_t n = bm_base64_encode((const uint8_t *)plain[i], strlen(plain[i]), encoded);
+    ASSERT_EQ(n, strlen(expected[i]));
+    EXPECT_EQ(memcmp(encoded, expected[i], n), 0);
+
+    size_t out_len = 0;
+    ASSERT_TRUE(bm_base64_decode(expected[i], n, decoded, &out_len));
+    EXPECT_EQ(out_len, strlen(plain[i]));
+    EXPECT_EQ(bm_base64_decoded_len(expected[i], n), strlen(plain[i]));
+    EXPECT_EQ(memcmp(decoded, plain[i], out_len), 0);
+  }
+}
+
+TEST_F(Base64Test, RoundTripAllLengths) {
+  // long enough to cover the SIMD blocks and every scalar tail after them
+  for (size_t len = 0; len <= sizeof(src); len++) {
+    size_t n = bm_base64_encode(src, len, encoded);
+    ASSERT_EQ(n, bm_base64_encoded_len(len));
+
+    memset(decoded, 0xa5, sizeof(decoded));
+    size_t out_len = 0;
+    ASSERT_TRUE(bm_base64_decode(encoded, n, decoded, &out_len)) << len;
+    ASSERT_EQ(out_len, len);
+    ASSERT_EQ(memcmp(decoded, src, len), 0) << len;
+    if (len < sizeof(decoded)) {
+      EXPECT_EQ(decoded[len], 0xa5) << "wrote past the output at " << len;
+    }
+
+    // unpadded input decodes the same
+    size_t unpadded = n;
+    while (unpadded && encoded[unpadded - 1] == '=') {
+      unpadded--;
+    }
+    ASSERT_TRUE(bm_base64_decode(encoded, unpadded, decoded, &out_len));
+    ASSERT_EQ(out_len, len);
+    ASSERT_EQ(memcmp(decoded, src, len), 0);
+  }
+}
+
+TEST_F(Base64Test, RejectsInvalidInput) {
+  size_t n = bm_base64_encode(src, 120, encoded);
+  size_t out_len = 0;
+
+  // a bad character anywhere, including inside a SIMD block
+  for (size_t i = 0; i < n; i += 7) {
+    char saved = encoded[i];
+    encoded[i] = '*';
+    EXPECT_FALSE(bm_base64_decode(encoded, n, decoded, &out_len)) << i;
+    encoded[i] = ' ';
+    EXPECT_FALSE(bm_base64_decode(encoded, n, decoded, &out_len)) << i;
+    encoded[i] = saved;
+  }
+  ASSERT_TRUE(bm_base64_decode(encoded, n, decoded, &out_len));
+
+  // padding only at the end
+  encoded[40] = '=';
+  EXPECT_FALSE(bm_base64_decode(encoded, n, decoded, &out_len));
+
+  // a single dangling character cannot encode a byte
+  EXPECT_FALSE(bm_base64_decode("Zm9vY", 5, decoded, &out_len));
+  EXPECT_FALSE(bm_base64_decode("Zg===", 5, decoded, &out_len));
+}
+
+TEST_F(Base64Test, DecodeKeyValueBothWireFormats) {
+  const size_t len = 100;
+  size_t n = bm_base64_encode(src, len, encoded);
+
+  uint8_t cbor_buffer[512];
+  CborEncoder encoder, map;
+  cbor_encoder_init(&encoder, cbor_buffer, sizeof(cbor_buffer), 0);
+  ASSERT_EQ(cbor_encoder_create_map(&encoder, &map, 2), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map, "text"), CborNoError);
+  ASSERT_EQ(cbor_encode_text_string(&map, encoded, n), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map, "bytes"), CborNoError);
+  ASSERT_EQ(cbor_encode_byte_string(&map, src, len), CborNoError);
+  ASSERT_EQ(cbor_encoder_close_container(&encoder, &map), CborNoError);
+  size_t cbor_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+
+  CborParser parser;
+  CborValue it, value;
+  ASSERT_EQ(cbor_parser_init(cbor_buffer, cbor_len, 0, &parser, &it), CborNoError);
+  ASSERT_EQ(cbor_value_enter_container(&it, &value), CborNoError);
+
+  size_t out_len = sizeof(decoded);
+  ASSERT_EQ(decode_key_value_base64(decoded, &out_len, &value, "text"), CborNoError);
+  EXPECT_EQ(out_len, len);
+  EXPECT_EQ(memcmp(decoded, src, len), 0);
+
+  // too small a buffer reports the size needed
+  out_len = 10;
+  ASSERT_EQ(decode_key_value_base64(decoded, &out_len, &value, "bytes"),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(out_len, len);
+}
@@ -1,7 +1,13 @@
 #include "bm_borealis.h"
+#include "borealis_bands.h"
+#include "borealis_level_sketch.h"
 #include "gtest/gtest.h"
 #include <cbor.h>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 // The fixture for testing class
 class BorealisMessages : public ::testing::Test {
@@ -42,6 +48,9 @@ TEST_F(BorealisMessages, BorealisSpectrumMessage) {
   EXPECT_FLOAT_EQ(decode.dt, 1234.9875);
   EXPECT_FLOAT_EQ(decode.df, 24012.99887766);
   EXPECT_EQ(decode.bands_per_octave, 128);
+  ASSERT_EQ(decode.spectrum_length, strlen(spectrum_str));
+  EXPECT_STREQ(decode.spectrum_as_base64, spectrum_str);
+  EXPECT_EQ(decode.spectrum, nullptr);
   free(decode.spectrum_as_base64);
 }
 
@@ -68,7 +77,9 @@ TEST_F(BorealisMessages, BorealisLevelsMessage) {
   EXPECT_EQ(decode.header.sensor_reading_time_ms, 0xdeadc0de);
   EXPECT_FLOAT_EQ(decode.dt, 1234.9875);
   EXPECT_EQ(decode.first_band_index, 128);
-  EXPECT_EQ(strncmp(d.levels, levels_str, strlen(levels_str)), 0);
+  ASSERT_EQ(decode.levels_length, strlen(levels_str));
+  EXPECT_STREQ(decode.levels, levels_str);
+  EXPECT_EQ(decode.level_data, nullptr);
   free(decode.levels);
 }
 
@@ -101,7 +112,394 @@ TEST_F(BorealisMessages, BorealisLevelStatisticsMessage) {
   EXPECT_FLOAT_EQ(decode.dt, 1234.9875);
   EXPECT_FLOAT_EQ(decode.dt_report, 111.1111);
   EXPECT_EQ(decode.first_band_index, 128);
-  EXPECT_EQ(strncmp(d.levels, levels_str, strlen(levels_str)), 0);
+  ASSERT_EQ(decode.levels_length, strlen(levels_str));
+  EXPECT_STREQ(decode.levels, levels_str);
+  EXPECT_EQ(decode.level_data, nullptr);
   EXPECT_FLOAT_EQ(decode.max_iqr, 0.12345);
   free(decode.levels);
 }
+
+TEST_F(BorealisMessages, BorealisSpectrumBinaryAndBase64Versions) {
+  uint8_t spectrum[256];
+  for (size_t i = 0; i < sizeof(spectrum); i++) {
+    spectrum[i] = (uint8_t)(i * 7);
+  }
+
+  struct borealis_spectrum_data d = {};
+  d.header.version = BOREALIS_SPECTRUM_MSG_VERSION_BINARY;
+  d.dt = 1.0;
+  d.df = 2.0;
+  d.bands_per_octave = 3;
+  d.spectrum = spectrum;
+  d.spectrum_length = sizeof(spectrum);
+
+  uint8_t cbor_buffer[1024];
+  size_t binary_len = 0;
+  ASSERT_EQ(borealis_spectrum_data_encode(&d, cbor_buffer, sizeof(cbor_buffer), &binary_len),
+            CborNoError);
+
+  struct borealis_spectrum_data decode = {};
+  ASSERT_EQ(borealis_spectrum_data_decode(&decode, cbor_buffer, binary_len), CborNoError);
+  EXPECT_EQ(decode.header.version, BOREALIS_SPECTRUM_MSG_VERSION_BINARY);
+  ASSERT_EQ(decode.spectrum_length, sizeof(spectrum));
+  EXPECT_EQ(memcmp(decode.spectrum, spectrum, sizeof(spectrum)), 0);
+  EXPECT_EQ(decode.spectrum_as_base64, nullptr);
+  free(decode.spectrum);
+
+  // version 1 senders are still understood
+  d.header.version = BOREALIS_SPECTRUM_MSG_VERSION;
+  d.spectrum_as_base64 = (char *)spectrum_str;
+  d.spectrum_length = strlen(spectrum_str);
+  size_t base64_len = 0;
+  ASSERT_EQ(borealis_spectrum_data_encode(&d, cbor_buffer, sizeof(cbor_buffer), &base64_len),
+            CborNoError);
+  decode = {};
+  ASSERT_EQ(borealis_spectrum_data_decode(&decode, cbor_buffer, base64_len), CborNoError);
+  EXPECT_EQ(decode.header.version, BOREALIS_SPECTRUM_MSG_VERSION);
+  EXPECT_STREQ(decode.spectrum_as_base64, spectrum_str);
+  free(decode.spectrum_as_base64);
+
+  // the same 256 bytes as base64 are 344 characters
+  char spectrum_base64[345];
+  memset(spectrum_base64, 'A', 344);
+  d.spectrum_as_base64 = spectrum_base64;
+  d.spectrum_length = 344;
+  ASSERT_EQ(borealis_spectrum_data_encode(&d, cbor_buffer, sizeof(cbor_buffer), &base64_len),
+            CborNoError);
+  EXPECT_EQ(base64_len - binary_len, 344u - sizeof(spectrum));
+}
+
+TEST_F(BorealisMessages, BorealisLevelsBinary) {
+  const uint8_t levels[] = {0x00, 0x01, 0xff, 0x7f, 0x80, 0x00, 0x10};
+
+  struct borealis_levels d = {};
+  d.header.version = BOREALIS_LEVELS_MSG_VERSION_BINARY;
+  d.first_band_index = 4;
+  d.level_data = (uint8_t *)levels;
+  d.levels_length = sizeof(levels);
+
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+  ASSERT_EQ(borealis_levels_encode(&d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+
+  struct borealis_levels decode = {};
+  ASSERT_EQ(borealis_levels_decode(&decode, cbor_buffer, len), CborNoError);
+  ASSERT_EQ(decode.levels_length, sizeof(levels));
+  EXPECT_EQ(memcmp(decode.level_data, levels, sizeof(levels)), 0);
+  free(decode.level_data);
+
+  struct borealis_level_statistics s = {};
+  s.header.version = BOREALIS_LEVEL_STATISTICS_MSG_VERSION;
+  s.levels = (char *)levels_str;
+  s.levels_length = strlen(levels_str);
+  ASSERT_EQ(borealis_levels_statistics_encode(&s, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  struct borealis_level_statistics decode_stats = {};
+  ASSERT_EQ(borealis_levels_statistics_decode(&decode_stats, cbor_buffer, len), CborNoError);
+  EXPECT_STREQ(decode_stats.levels, levels_str);
+  free(decode_stats.levels);
+}
+
+TEST_F(BorealisMessages, BorealisDecodeBinaryIntoCallerBuffer) {
+  // levels_str is 32 bytes as base64
+  struct borealis_levels d = {};
+  d.header.version = BOREALIS_LEVELS_MSG_VERSION;
+  d.first_band_index = 9;
+  d.levels = (char *)levels_str;
+  d.levels_length = strlen(levels_str);
+
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+  ASSERT_EQ(borealis_levels_encode(&d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+
+  uint8_t from_base64[32];
+  struct borealis_levels decode = {};
+  ASSERT_EQ(borealis_levels_decode_binary(&decode, from_base64, sizeof(from_base64),
+                                          cbor_buffer, len),
+            CborNoError);
+  EXPECT_EQ(decode.first_band_index, 9);
+  EXPECT_EQ(decode.level_data, from_base64);
+  ASSERT_EQ(decode.levels_length, sizeof(from_base64));
+
+  // re-sent as version 2 bytes, the binary decode yields the same payload
+  d.header.version = BOREALIS_LEVELS_MSG_VERSION_BINARY;
+  d.level_data = from_base64;
+  d.levels_length = sizeof(from_base64);
+  ASSERT_EQ(borealis_levels_encode(&d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+  uint8_t from_bytes[32];
+  ASSERT_EQ(borealis_levels_decode_binary(&decode, from_bytes, sizeof(from_bytes),
+                                          cbor_buffer, len),
+            CborNoError);
+  EXPECT_EQ(memcmp(from_bytes, from_base64, sizeof(from_bytes)), 0);
+
+  // a short buffer reports the size needed
+  ASSERT_EQ(borealis_levels_decode_binary(&decode, from_bytes, 16, cbor_buffer, len),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(decode.levels_length, 32u);
+
+  struct borealis_spectrum_data s = {};
+  s.header.version = BOREALIS_SPECTRUM_MSG_VERSION;
+  s.spectrum_as_base64 = (char *)spectrum_str;
+  s.spectrum_length = strlen(spectrum_str);
+  ASSERT_EQ(borealis_spectrum_data_encode(&s, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  uint8_t spectrum[64];
+  struct borealis_spectrum_data decode_spectrum = {};
+  ASSERT_EQ(borealis_spectrum_data_decode_binary(&decode_spectrum, spectrum, sizeof(spectrum),
+                                                 cbor_buffer, len),
+            CborNoError);
+  EXPECT_EQ(decode_spectrum.spectrum_length, 64u);
+}
+
+TEST_F(BorealisMessages, BorealisLevelSketch) {
+  const uint8_t num_bands = 8;
+  static struct borealis_level_sketch sketch;
+  borealis_level_sketch_reset(&sketch);
+
+  struct borealis_levels d = {};
+  d.header.version = BOREALIS_LEVELS_MSG_VERSION_BINARY;
+  d.dt = 0.5;
+  d.first_band_index = 12;
+  uint8_t payload[num_bands * BOREALIS_LEVEL_BYTES_PER_BAND];
+  d.level_data = payload;
+  d.levels_length = sizeof(payload);
+
+  // band b is uniform over [60 + b, 60 + b + 2 * (b + 1)] dB, so its
+  // interquartile range is b + 1 dB
+  std::vector<float> history[num_bands];
+  srand(42);
+  for (int n = 0; n < 2000; n++) {
+    float db[num_bands];
+    for (uint8_t b = 0; b < num_bands; b++) {
+      db[b] = 60.0f + b + 2.0f * (b + 1) * (float)rand() / RAND_MAX;
+    }
+    borealis_levels_pack_db(db, num_bands, payload);
+    borealis_levels_unpack_db(payload, num_bands, db);
+    for (uint8_t b = 0; b < num_bands; b++) {
+      history[b].push_back(db[b]);
+    }
+    d.header.reading_time_utc_ms = 1000 + n * 500;
+    ASSERT_TRUE(borealis_level_sketch_add(&sketch, &d));
+
+    // exact while the sketch is still filling
+    if (n == 4) {
+      std::vector<float> sorted = history[3];
+      std::sort(sorted.begin(), sorted.end());
+      EXPECT_FLOAT_EQ(borealis_level_sketch_quantile(&sketch, 3, 0.5f), sorted[2]);
+      EXPECT_FLOAT_EQ(borealis_level_sketch_quantile(&sketch, 3, 0.25f), sorted[1]);
+    }
+  }
+
+  for (uint8_t b = 0; b < num_bands; b++) {
+    std::vector<float> sorted = history[b];
+    std::sort(sorted.begin(), sorted.end());
+    const float tolerance = 0.05f * (b + 1);
+    EXPECT_NEAR(borealis_level_sketch_quantile(&sketch, b, 0.25f), sorted[500], tolerance);
+    EXPECT_NEAR(borealis_level_sketch_quantile(&sketch, b, 0.5f), sorted[1000], tolerance);
+    EXPECT_NEAR(borealis_level_sketch_quantile(&sketch, b, 0.75f), sorted[1500], tolerance);
+  }
+  EXPECT_TRUE(isnan(borealis_level_sketch_quantile(&sketch, num_bands, 0.5f)));
+
+  // records with a different band layout are refused
+  d.first_band_index = 11;
+  EXPECT_FALSE(borealis_level_sketch_add(&sketch, &d));
+  d.first_band_index = 12;
+  d.levels_length = sizeof(payload) - 2;
+  EXPECT_FALSE(borealis_level_sketch_add(&sketch, &d));
+
+  uint8_t medians[num_bands * BOREALIS_LEVEL_BYTES_PER_BAND];
+  struct borealis_level_statistics stats = {};
+  EXPECT_FALSE(borealis_level_sketch_report(&sketch, &stats, medians, sizeof(medians) - 1));
+  ASSERT_TRUE(borealis_level_sketch_report(&sketch, &stats, medians, sizeof(medians)));
+  EXPECT_EQ(stats.header.version, BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY);
+  EXPECT_EQ(stats.header.reading_time_utc_ms, 1000u + 1999u * 500u);
+  EXPECT_FLOAT_EQ(stats.dt_report, 1000.0f);
+  EXPECT_EQ(stats.first_band_index, 12);
+  EXPECT_NEAR(stats.max_iqr, 8.0f, 0.4f);
+
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+  ASSERT_EQ(borealis_levels_statistics_encode(&stats, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  struct borealis_level_statistics decode = {};
+  ASSERT_EQ(borealis_levels_statistics_decode(&decode, cbor_buffer, len), CborNoError);
+  ASSERT_EQ(decode.levels_length, sizeof(medians));
+  float median_db[num_bands];
+  borealis_levels_unpack_db(decode.level_data, num_bands, median_db);
+  EXPECT_NEAR(median_db[0], 61.0f, 0.1f);
+  EXPECT_NEAR(median_db[7], 75.0f, 0.5f);
+  free(decode.level_data);
+
+  // version 1 records are decoded from base64
+  borealis_level_sketch_reset(&sketch);
+  struct borealis_levels v1 = {};
+  v1.header.version = BOREALIS_LEVELS_MSG_VERSION;
+  v1.levels = (char *)levels_str;
+  v1.levels_length = strlen(levels_str);
+  ASSERT_TRUE(borealis_level_sketch_add(&sketch, &v1));
+  EXPECT_EQ(sketch.num_bands, 16);
+}
+
+TEST_F(BorealisMessages, BorealisDecodeIntoCallerBuffer) {
+  // one buffer serves every message
+  char buffer[128];
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+
+  struct borealis_recording_status status = {};
+  status.header.version = BOREALIS_RECORDING_STATUS_MSG_VERSION;
+  status.flags = 1;
+  status.filename = (char *)"20240101T000000.wav";
+  status.filename_length = strlen(status.filename);
+  status.seconds_written = 12.5;
+  status.seconds_free = 1e6;
+  ASSERT_EQ(borealis_recording_status_encode(&status, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+
+  struct borealis_recording_status decode_status = {};
+  ASSERT_EQ(borealis_recording_status_decode_into(&decode_status, buffer, sizeof(buffer),
+                                                  cbor_buffer, len),
+            CborNoError);
+  EXPECT_EQ(decode_status.filename, buffer);
+  EXPECT_STREQ(decode_status.filename, "20240101T000000.wav");
+  EXPECT_EQ(decode_status.filename_length, strlen("20240101T000000.wav"));
+  EXPECT_FLOAT_EQ(decode_status.seconds_free, 1e6);
+
+  // too small reports the capacity needed, terminator included
+  ASSERT_EQ(borealis_recording_status_decode_into(&decode_status, buffer, 8, cbor_buffer, len),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(decode_status.filename_length, strlen("20240101T000000.wav") + 1);
+  ASSERT_EQ(borealis_recording_status_decode_into(&decode_status, buffer,
+                                                  decode_status.filename_length, cbor_buffer,
+                                                  len),
+            CborNoError);
+
+  struct borealis_spectrum_data spectrum = {};
+  spectrum.header.version = BOREALIS_SPECTRUM_MSG_VERSION;
+  spectrum.spectrum_as_base64 = (char *)spectrum_str;
+  spectrum.spectrum_length = strlen(spectrum_str);
+  ASSERT_EQ(borealis_spectrum_data_encode(&spectrum, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  struct borealis_spectrum_data decode_spectrum = {};
+  ASSERT_EQ(borealis_spectrum_data_decode_into(&decode_spectrum, buffer, sizeof(buffer),
+                                               cbor_buffer, len),
+            CborNoError);
+  EXPECT_STREQ(decode_spectrum.spectrum_as_base64, spectrum_str);
+
+  const uint8_t raw[] = {1, 2, 3, 4, 5};
+  struct borealis_levels levels = {};
+  levels.header.version = BOREALIS_LEVELS_MSG_VERSION_BINARY;
+  levels.level_data = (uint8_t *)raw;
+  levels.levels_length = sizeof(raw);
+  ASSERT_EQ(borealis_levels_encode(&levels, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  struct borealis_levels decode_levels = {};
+  ASSERT_EQ(borealis_levels_decode_into(&decode_levels, buffer, sizeof(raw), cbor_buffer, len),
+            CborNoError);
+  ASSERT_EQ(decode_levels.levels_length, sizeof(raw));
+  EXPECT_EQ(memcmp(decode_levels.level_data, raw, sizeof(raw)), 0);
+
+  struct borealis_level_statistics stats = {};
+  stats.header.version = BOREALIS_LEVEL_STATISTICS_MSG_VERSION_BINARY;
+  stats.level_data = (uint8_t *)raw;
+  stats.levels_length = sizeof(raw);
+  stats.max_iqr = 3.0;
+  ASSERT_EQ(borealis_levels_statistics_encode(&stats, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  struct borealis_level_statistics decode_stats = {};
+  ASSERT_EQ(borealis_levels_statistics_decode_into(&decode_stats, buffer, 4, cbor_buffer, len),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(decode_stats.levels_length, sizeof(raw));
+  ASSERT_EQ(borealis_levels_statistics_decode_into(&decode_stats, buffer, sizeof(buffer),
+                                                   cbor_buffer, len),
+            CborNoError);
+  EXPECT_FLOAT_EQ(decode_stats.max_iqr, 3.0);
+  EXPECT_EQ(memcmp(decode_stats.level_data, raw, sizeof(raw)), 0);
+
+  // a binary version message whose payload arrives as a text string is rejected
+  ASSERT_EQ(borealis_levels_encode(&levels, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  const uint8_t key[] = {0x66, 'l', 'e', 'v', 'e', 'l', 's', 0x40 | sizeof(raw)};
+  uint8_t *payload = std::search(cbor_buffer, cbor_buffer + len, key, key + sizeof(key));
+  ASSERT_NE(payload, cbor_buffer + len);
+  payload[sizeof(key) - 1] = 0x60 | sizeof(raw);
+  EXPECT_EQ(borealis_levels_decode_into(&decode_levels, buffer, sizeof(buffer), cbor_buffer, len),
+            CborErrorIllegalType);
+  EXPECT_EQ(decode_levels.level_data, nullptr);
+}
+
+TEST_F(BorealisMessages, BorealisBandLevels) {
+  const size_t num_bins = 2049;
+  static float psd[num_bins];
+  static struct borealis_band_table table;
+  ASSERT_TRUE(borealis_band_table_init(&table, 12.5f, 3, num_bins));
+
+  // third octave band 30 is centered on 1 kHz
+  EXPECT_FLOAT_EQ(borealis_band_center_hz(3, 30), 1000.0f);
+  EXPECT_NEAR(borealis_band_center_hz(3, 33), 2000.0f, 0.01f);
+  ASSERT_GT(table.num_bands, 10);
+  // the lowest band clears the DC bin and the highest fits below the last bin
+  const float half_band = exp2f(1.0f / 6.0f);
+  const uint8_t first = table.first_band_index;
+  EXPECT_GE(borealis_band_center_hz(3, first) / half_band, 12.5f / 2);
+  EXPECT_LT(borealis_band_center_hz(3, first - 1) / half_band, 12.5f / 2);
+  EXPECT_LE(borealis_band_center_hz(3, first + table.num_bands - 1) * half_band,
+            12.5f * (num_bins - 0.5f));
+
+  // a flat spectrum gives each band exactly its bandwidth in power
+  for (size_t i = 0; i < num_bins; i++) {
+    psd[i] = 1.0f;
+  }
+  float db[BOREALIS_BAND_TABLE_MAX_BANDS];
+  borealis_band_levels_db(&table, psd, db);
+  for (uint8_t i = 0; i < table.num_bands; i++) {
+    const float center = borealis_band_center_hz(3, first + i);
+    const float bandwidth = center * half_band - center / half_band;
+    EXPECT_NEAR(db[i], 10.0f * log10f(bandwidth), 0.001f) << (int)i;
+  }
+
+  // a tone lands in the band containing it
+  memset(psd, 0, sizeof(psd));
+  psd[80] = 4.0f; // 1 kHz
+  borealis_band_levels_db(&table, psd, db);
+  for (uint8_t i = 0; i < table.num_bands; i++) {
+    if (first + i == 30) {
+      EXPECT_FLOAT_EQ(db[i], 10.0f * log10f(4.0f * 12.5f));
+    } else {
+      EXPECT_TRUE(isinf(db[i]));
+    }
+  }
+
+  struct borealis_spectrum_data spectrum = {};
+  spectrum.header.version = BOREALIS_SPECTRUM_MSG_VERSION;
+  spectrum.header.reading_time_utc_ms = 42;
+  spectrum.dt = 0.25;
+  spectrum.df = 12.5;
+  spectrum.bands_per_octave = 3;
+
+  uint8_t levels_buffer[BOREALIS_BAND_TABLE_MAX_BANDS * BOREALIS_LEVEL_BYTES_PER_BAND];
+  struct borealis_levels levels = {};
+  ASSERT_TRUE(borealis_band_levels(&table, &spectrum, psd, &levels, levels_buffer,
+                                   sizeof(levels_buffer)));
+  EXPECT_EQ(levels.header.version, BOREALIS_LEVELS_MSG_VERSION_BINARY);
+  EXPECT_EQ(levels.header.reading_time_utc_ms, 42u);
+  EXPECT_FLOAT_EQ(levels.dt, 0.25);
+  EXPECT_EQ(levels.first_band_index, first);
+  EXPECT_EQ(levels.levels_length, table.num_bands * BOREALIS_LEVEL_BYTES_PER_BAND);
+
+  uint8_t cbor_buffer[512];
+  size_t len = 0;
+  ASSERT_EQ(borealis_levels_encode(&levels, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+  struct borealis_levels decode = {};
+  ASSERT_EQ(borealis_levels_decode(&decode, cbor_buffer, len), CborNoError);
+  float decoded_db[BOREALIS_BAND_TABLE_MAX_BANDS];
+  borealis_levels_unpack_db(decode.level_data, table.num_bands, decoded_db);
+  EXPECT_NEAR(decoded_db[30 - first], 10.0f * log10f(50.0f), 0.005f);
+  free(decode.level_data);
+
+  // a spectrum with another resolution needs its own table
+  spectrum.df = 25.0;
+  EXPECT_FALSE(borealis_band_levels(&table, &spectrum, psd, &levels, levels_buffer,
+                                    sizeof(levels_buffer)));
+  EXPECT_FALSE(borealis_band_table_init(&table, 12.5f, 0, num_bins));
+}
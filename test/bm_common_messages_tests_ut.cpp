@@ -1,19 +1,27 @@
 #include "bm_config.h"
 
 #include "aanderaa_conductivity_msg.h"
+#include "aanderaa_current_meter_averager.h"
 #include "aanderaa_current_meter_msg.h"
 #include "barometric_pressure_data_msg.h"
 #include "bm_common_pub_sub.h"
+#include "bm_common_pub_sub_dispatch.h"
 #include "bm_rbr_data_msg.h"
 #include "bm_rbr_pressure_difference_signal_msg.h"
 #include "bm_seapoint_turbidity_data_msg.h"
 #include "bm_soft_data_msg.h"
+#include "bm_template_encoder.h"
 #include "bm_messages_helper.h"
+#include "bm_print_batch.h"
+#include "bm_print_publication.h"
 #include "config_cbor_map_srv_reply_msg.h"
 #include "config_cbor_map_srv_request_msg.h"
+#include "device_test_svc_bench.h"
 #include "device_test_svc_reply_msg.h"
 #include "device_test_svc_request_msg.h"
 #include "metrics_reply_msg.h"
+#include "network_port_stats_aggregator.h"
+#include "network_port_stats_msg.h"
 #include "pme_dissolved_oxygen_msg.h"
 #include "pme_wipe_msg.h"
 #include "power_battery_averages_msg.h"
@@ -25,6 +33,9 @@
 #include "sensor_header_msg.h"
 #include "sys_info_svc_reply_msg.h"
 #include "gtest/gtest.h"
+#include <string>
+#include <vector>
+#include <chrono>
 #include <cmath>
 #include <math.h>
 
@@ -261,6 +272,157 @@ TEST_F(BmCommonTest, bmSeapointTurbidityTest) {
   EXPECT_EQ(decode.r_signal, 4000.4);
 }
 
+TEST_F(BmCommonTest, bmSeapointTurbidityTemplateTest) {
+  uint8_t template_buffer[256];
+  BmTemplateEncoder t;
+  EXPECT_EQ(bm_template_encoder_init(&t, BmSeapointTurbidityDataMsg::TEMPLATE_FIELDS,
+                                     BmSeapointTurbidityDataMsg::NUM_FIELDS,
+                                     template_buffer, sizeof(template_buffer)),
+            CborNoError);
+
+  BmSeapointTurbidityDataMsg::Data d;
+  d.header.version = BmSeapointTurbidityDataMsg::VERSION;
+  d.header.reading_time_utc_ms = 123456789;
+  d.header.reading_uptime_millis = 987654321;
+  d.header.sensor_reading_time_ms = 0xdeadc0de;
+  d.s_signal = 0.1234;
+  d.r_signal = 4000.4;
+
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+  EXPECT_EQ(bm_template_encode(&t, &d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+  EXPECT_EQ(len, t.len);
+
+  BmSeapointTurbidityDataMsg::Data decode;
+  EXPECT_EQ(BmSeapointTurbidityDataMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.header.version, BmSeapointTurbidityDataMsg::VERSION);
+  EXPECT_EQ(decode.header.reading_time_utc_ms, 123456789);
+  EXPECT_EQ(decode.header.reading_uptime_millis, 987654321);
+  EXPECT_EQ(decode.header.sensor_reading_time_ms, 0xdeadc0de);
+  EXPECT_EQ(decode.s_signal, 0.1234);
+  EXPECT_EQ(decode.r_signal, 4000.4);
+
+  // Patching in place keeps the layout; only the values change
+  d.header.reading_time_utc_ms = UINT64_MAX;
+  d.header.sensor_reading_time_ms = 0;
+  d.r_signal = -1.5;
+  bm_template_encoder_patch(&t, cbor_buffer, &d);
+  EXPECT_EQ(BmSeapointTurbidityDataMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.header.reading_time_utc_ms, UINT64_MAX);
+  EXPECT_EQ(decode.header.sensor_reading_time_ms, 0);
+  EXPECT_EQ(decode.r_signal, -1.5);
+
+  EXPECT_EQ(bm_template_encode(&t, &d, cbor_buffer, len - 1, &len), CborErrorOutOfMemory);
+}
+
+TEST_F(BmCommonTest, AanderaaCurrentMeterTemplateTest) {
+  uint8_t template_buffer[512];
+  BmTemplateEncoder t;
+  EXPECT_EQ(bm_template_encoder_init(&t, AanderaaCurrentMeterMsg::TEMPLATE_FIELDS,
+                                     AanderaaCurrentMeterMsg::NUM_FIELDS,
+                                     template_buffer, sizeof(template_buffer)),
+            CborNoError);
+  EXPECT_EQ(bm_template_encoder_init(&t, AanderaaCurrentMeterMsg::TEMPLATE_FIELDS,
+                                     AanderaaCurrentMeterMsg::NUM_FIELDS,
+                                     template_buffer, 64),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(bm_template_encoder_init(&t, AanderaaCurrentMeterMsg::TEMPLATE_FIELDS,
+                                     AanderaaCurrentMeterMsg::NUM_FIELDS,
+                                     template_buffer, sizeof(template_buffer)),
+            CborNoError);
+
+  AanderaaCurrentMeterMsg::Data d = {};
+  d.header.version = AanderaaCurrentMeterMsg::VERSION;
+  d.header.reading_time_utc_ms = 1;
+  d.header.reading_uptime_millis = 2;
+  d.header.sensor_reading_time_ms = 3;
+  d.abs_speed_cm_s = 10.5;
+  d.direction_deg_m = 359.9;
+  d.north_cm_s = -3.25;
+  d.east_cm_s = 7.0;
+  d.ping_count = 150;
+  d.temperature_deg_c = 12.345;
+
+  // In place: the template buffer itself becomes the encoded message
+  size_t len = 0;
+  EXPECT_EQ(bm_template_encode(&t, &d, template_buffer, sizeof(template_buffer), &len),
+            CborNoError);
+
+  AanderaaCurrentMeterMsg::Data decode;
+  EXPECT_EQ(AanderaaCurrentMeterMsg::decode(decode, template_buffer, len), CborNoError);
+  EXPECT_EQ(decode.header.version, AanderaaCurrentMeterMsg::VERSION);
+  EXPECT_EQ(decode.header.reading_time_utc_ms, 1);
+  EXPECT_EQ(decode.header.sensor_reading_time_ms, 3);
+  EXPECT_EQ(decode.abs_speed_cm_s, 10.5);
+  EXPECT_EQ(decode.direction_deg_m, 359.9);
+  EXPECT_EQ(decode.north_cm_s, -3.25);
+  EXPECT_EQ(decode.east_cm_s, 7.0);
+  EXPECT_EQ(decode.tilt_x_deg, 0);
+  EXPECT_EQ(decode.ping_count, 150);
+  EXPECT_EQ(decode.temperature_deg_c, 12.345);
+}
+
+TEST_F(BmCommonTest, AanderaaCurrentMeterAveragerTest) {
+  AanderaaCurrentMeterMsg::Averager a;
+  AanderaaCurrentMeterMsg::averager_reset(a);
+
+  AanderaaCurrentMeterMsg::Data avg = {};
+  EXPECT_FALSE(AanderaaCurrentMeterMsg::averager_result(a, avg));
+
+  // Two equal currents either side of north, headings either side of 0
+  const double direction[] = {350.0, 10.0};
+  const double heading[] = {355.0, 5.0};
+  for (int i = 0; i < 2; i++) {
+    AanderaaCurrentMeterMsg::Data d = {};
+    d.header.version = AanderaaCurrentMeterMsg::VERSION;
+    d.header.reading_time_utc_ms = 1000 * (i + 1);
+    d.abs_speed_cm_s = 20.0;
+    d.direction_deg_m = direction[i];
+    d.north_cm_s = 20.0 * cos(direction[i] * M_PI / 180.0);
+    d.east_cm_s = 20.0 * sin(direction[i] * M_PI / 180.0);
+    d.heading_deg_m = heading[i];
+    d.single_ping_std_cm_s = i == 0 ? 3.0 : 4.0;
+    d.ping_count = 150;
+    d.tilt_x_deg = i;
+    d.max_tilt_deg = i == 0 ? 7.0 : 2.0;
+    d.temperature_deg_c = 10.0 + i;
+    AanderaaCurrentMeterMsg::averager_add(a, d);
+  }
+
+  ASSERT_TRUE(AanderaaCurrentMeterMsg::averager_result(a, avg));
+  EXPECT_EQ(avg.header.reading_time_utc_ms, 2000);
+  EXPECT_NEAR(avg.direction_deg_m, 0.0, 1e-9);
+  EXPECT_NEAR(avg.heading_deg_m, 0.0, 1e-9);
+  EXPECT_NEAR(avg.east_cm_s, 0.0, 1e-9);
+  EXPECT_NEAR(avg.abs_speed_cm_s, 20.0 * cos(10.0 * M_PI / 180.0), 1e-9);
+  EXPECT_DOUBLE_EQ(avg.single_ping_std_cm_s, sqrt(12.5));
+  EXPECT_DOUBLE_EQ(avg.ping_count, 300);
+  EXPECT_DOUBLE_EQ(avg.tilt_x_deg, 0.5);
+  EXPECT_DOUBLE_EQ(avg.max_tilt_deg, 7.0);
+  EXPECT_DOUBLE_EQ(avg.temperature_deg_c, 10.5);
+
+  // Opposing westward currents average to west, not east
+  AanderaaCurrentMeterMsg::averager_reset(a);
+  AanderaaCurrentMeterMsg::Data d = {};
+  d.north_cm_s = 5.0;
+  d.east_cm_s = -10.0;
+  AanderaaCurrentMeterMsg::averager_add(a, d);
+  d.north_cm_s = -5.0;
+  AanderaaCurrentMeterMsg::averager_add(a, d);
+  ASSERT_TRUE(AanderaaCurrentMeterMsg::averager_result(a, avg));
+  EXPECT_NEAR(avg.direction_deg_m, 270.0, 1e-9);
+  EXPECT_NEAR(avg.abs_speed_cm_s, 10.0, 1e-9);
+
+  // The result encodes as a regular current meter message
+  uint8_t cbor_buffer[1024];
+  size_t len = 0;
+  EXPECT_EQ(AanderaaCurrentMeterMsg::encode(avg, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  AanderaaCurrentMeterMsg::Data decode;
+  EXPECT_EQ(AanderaaCurrentMeterMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.direction_deg_m, avg.direction_deg_m);
+}
+
 TEST_F(BmCommonTest, BmRbrPressureDifferenceSignalMsgTest) {
   BmRbrPressureDifferenceSignalMsg::Data d;
   d.header.version = BmRbrPressureDifferenceSignalMsg::VERSION;
@@ -419,6 +581,50 @@ TEST_F(BmCommonTest, PmeWipeMsgTest) {
   EXPECT_EQ(decode.rsource, 90);
 }
 
+TEST_F(BmCommonTest, PmeWipeMsgTemplateTest) {
+  uint8_t template_buffer[256];
+  BmTemplateEncoder t;
+  ASSERT_EQ(bm_template_encoder_init(&t, PmeWipeMsg::TEMPLATE_FIELDS, PmeWipeMsg::NUM_FIELDS,
+                                     template_buffer, sizeof(template_buffer)),
+            CborNoError);
+
+  PmeWipeMsg::Data d;
+  d.header.version = PmeWipeMsg::VERSION;
+  d.header.reading_time_utc_ms = 123456789;
+  d.header.reading_uptime_millis = 987654321;
+  d.header.sensor_reading_time_ms = 0xdeadc0de;
+  d.wipe_time_sec = 5.8;
+  d.start1_mA = 90.3;
+  d.avg_mA = 90.1;
+  d.start2_mA = 95.6;
+  d.final_mA = 95.3;
+  d.rsource = 90;
+
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+  ASSERT_EQ(bm_template_encode(&t, &d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+  EXPECT_EQ(len, t.len);
+
+  PmeWipeMsg::Data decode;
+  ASSERT_EQ(PmeWipeMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.header.version, PmeWipeMsg::VERSION);
+  EXPECT_EQ(decode.header.reading_time_utc_ms, 123456789);
+  EXPECT_EQ(decode.header.reading_uptime_millis, 987654321);
+  EXPECT_EQ(decode.header.sensor_reading_time_ms, 0xdeadc0de);
+  EXPECT_EQ(decode.wipe_time_sec, 5.8);
+  EXPECT_EQ(decode.start1_mA, 90.3);
+  EXPECT_EQ(decode.avg_mA, 90.1);
+  EXPECT_EQ(decode.start2_mA, 95.6);
+  EXPECT_EQ(decode.final_mA, 95.3);
+  EXPECT_EQ(decode.rsource, 90);
+
+  // the template is too big for a buffer one byte short of it
+  BmTemplateEncoder small;
+  EXPECT_EQ(bm_template_encoder_init(&small, PmeWipeMsg::TEMPLATE_FIELDS,
+                                     PmeWipeMsg::NUM_FIELDS, template_buffer, t.len - 1),
+            CborErrorOutOfMemory);
+}
+
 TEST_F(BmCommonTest, barometricPressureMsgTest) {
   BarometricPressureDataMsg::Data d;
   d.header.version = BarometricPressureDataMsg::VERSION;
@@ -1594,8 +1800,8 @@ TEST_F(BmCommonTest, BmDecodeFieldsFromTableTypeMismatchTest) {
 }
 
 TEST_F(BmCommonTest, BmEncodeFieldsFromTableUnsupportedTypeTest) {
-  const char *text = "hello";
-  BmEncoderTableEntry encode_table[] = {{"text", BM_FIELD_STRING, text}};
+  const uint32_t number = 1;
+  BmEncoderTableEntry encode_table[] = {{"number", (BmField)0x7f, &number}};
 
   uint8_t cbor_buffer[128] = {0};
   CborEncoder encoder;
@@ -1610,6 +1816,468 @@ TEST_F(BmCommonTest, BmEncodeFieldsFromTableUnsupportedTypeTest) {
   EXPECT_EQ(err, CborErrorUnsupportedType);
 }
 
+TEST_F(BmCommonTest, BmEncodeDecodeAllFieldTypesFromTable) {
+  const int8_t i8 = -100;
+  const int16_t i16 = -30000;
+  const int32_t i32 = -2000000000;
+  const int64_t i64 = -9000000000000LL;
+  const bool flag = true;
+  const float half = 1.5f;
+  char name[] = "bristlemouth";
+  uint8_t blob[] = {0x00, 0xff, 0x10};
+  uint16_t mse[] = {100, 65535, 0};
+  float temps[] = {-1.25f, 3.5f};
+  BmFieldBuffer name_buf = {name, strlen(name), 0, BM_FIELD_STRING};
+  BmFieldBuffer blob_buf = {blob, sizeof(blob), 0, BM_FIELD_BYTES};
+  BmFieldBuffer mse_buf = {mse, 3, 0, BM_FIELD_UINT16};
+  BmFieldBuffer temps_buf = {temps, 2, 0, BM_FIELD_FLOAT};
+
+  BmEncoderTableEntry encode_table[] = {
+      {"i8", BM_FIELD_INT8, &i8},         {"i16", BM_FIELD_INT16, &i16},
+      {"i32", BM_FIELD_INT32, &i32},      {"i64", BM_FIELD_INT64, &i64},
+      {"flag", BM_FIELD_BOOL, &flag},     {"half", BM_FIELD_HALF, &half},
+      {"name", BM_FIELD_STRING, &name_buf}, {"blob", BM_FIELD_BYTES, &blob_buf},
+      {"mse", BM_FIELD_ARRAY, &mse_buf},  {"temps", BM_FIELD_ARRAY, &temps_buf},
+  };
+  const size_t n = sizeof(encode_table) / sizeof(encode_table[0]);
+
+  uint8_t cbor_buffer[256] = {0};
+  CborEncoder encoder;
+  CborEncoder map_encoder;
+  EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer), n),
+            CborNoError);
+  EXPECT_EQ(bm_encode_fields_from_table(&map_encoder, encode_table, n), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+
+  int8_t got_i8 = 0;
+  int16_t got_i16 = 0;
+  int32_t got_i32 = 0;
+  int64_t got_i64 = 0;
+  bool got_flag = false;
+  float got_half = 0;
+  char got_name[13];
+  uint8_t got_blob[8];
+  uint16_t got_mse[4];
+  float got_temps[2];
+  BmFieldBuffer got_name_buf = {got_name, 0, sizeof(got_name), BM_FIELD_STRING};
+  BmFieldBuffer got_blob_buf = {got_blob, 0, sizeof(got_blob), BM_FIELD_BYTES};
+  BmFieldBuffer got_mse_buf = {got_mse, 0, 4, BM_FIELD_UINT16};
+  BmFieldBuffer got_temps_buf = {got_temps, 0, 2, BM_FIELD_FLOAT};
+  BmDecodeTableEntry decode_table[] = {
+      {"i8", BM_FIELD_INT8, &got_i8},         {"i16", BM_FIELD_INT16, &got_i16},
+      {"i32", BM_FIELD_INT32, &got_i32},      {"i64", BM_FIELD_INT64, &got_i64},
+      {"flag", BM_FIELD_BOOL, &got_flag},     {"half", BM_FIELD_HALF, &got_half},
+      {"name", BM_FIELD_STRING, &got_name_buf}, {"blob", BM_FIELD_BYTES, &got_blob_buf},
+      {"mse", BM_FIELD_ARRAY, &got_mse_buf},  {"temps", BM_FIELD_ARRAY, &got_temps_buf},
+  };
+
+  CborParser parser;
+  CborValue map;
+  CborValue value;
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, n),
+            CborNoError);
+  EXPECT_EQ(bm_decode_fields_from_table(&value, decode_table, n), CborNoError);
+  EXPECT_EQ(decoder_message_leave(&value, &map), CborNoError);
+
+  EXPECT_EQ(got_i8, i8);
+  EXPECT_EQ(got_i16, i16);
+  EXPECT_EQ(got_i32, i32);
+  EXPECT_EQ(got_i64, i64);
+  EXPECT_TRUE(got_flag);
+  EXPECT_EQ(got_half, 1.5f);
+  EXPECT_EQ(got_name_buf.len, strlen(name));
+  EXPECT_STREQ(got_name, name);
+  EXPECT_EQ(got_blob_buf.len, sizeof(blob));
+  EXPECT_EQ(memcmp(got_blob, blob, sizeof(blob)), 0);
+  ASSERT_EQ(got_mse_buf.len, 3u);
+  EXPECT_EQ(memcmp(got_mse, mse, sizeof(mse)), 0);
+  ASSERT_EQ(got_temps_buf.len, 2u);
+  EXPECT_EQ(got_temps[0], -1.25f);
+  EXPECT_EQ(got_temps[1], 3.5f);
+
+  // the string does not fit with its terminator, nor do the arrays
+  char short_name[12];
+  BmFieldBuffer short_name_buf = {short_name, 0, sizeof(short_name), BM_FIELD_STRING};
+  BmFieldBuffer short_mse_buf = {got_mse, 0, 2, BM_FIELD_UINT16};
+  BmDecodeTableEntry small_table[] = {
+      {"name", BM_FIELD_STRING, &short_name_buf},
+      {"mse", BM_FIELD_ARRAY, &short_mse_buf},
+  };
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, n),
+            CborNoError);
+  EXPECT_EQ(bm_decode_fields_from_table(&value, small_table, 2), CborErrorOutOfMemory);
+  EXPECT_EQ(short_name_buf.len, sizeof(got_name));
+  EXPECT_EQ(short_mse_buf.len, 3u);
+
+  // i16 does not fit an int8, mse elements are not floats
+  int8_t narrow = 7;
+  BmFieldBuffer wrong_buf = {got_temps, 0, 4, BM_FIELD_FLOAT};
+  BmDecodeTableEntry wrong_table[] = {
+      {"i16", BM_FIELD_INT8, &narrow},
+      {"mse", BM_FIELD_ARRAY, &wrong_buf},
+  };
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, n),
+            CborNoError);
+  EXPECT_EQ(bm_decode_fields_from_table(&value, wrong_table, 2), CborErrorImproperValue);
+  EXPECT_EQ(narrow, 7);
+  EXPECT_EQ(wrong_buf.len, 0u);
+}
+
+TEST_F(BmCommonTest, BmHalfFloatFieldRounding) {
+  const float values[] = {0.0f, -2.0f, 65504.0f, 1e6f, 5.960464477539063e-8f, 1e-9f,
+                          0.1f, 3.14159f, INFINITY, -INFINITY};
+  const float expected[] = {0.0f, -2.0f, 65504.0f, INFINITY, 5.960464477539063e-8f, 0.0f,
+                            0.0999755859375f, 3.140625f, INFINITY, -INFINITY};
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    BmEncoderTableEntry encode_table[] = {{"h", BM_FIELD_HALF, &values[i]}};
+    uint8_t cbor_buffer[32] = {0};
+    CborEncoder encoder;
+    CborEncoder map_encoder;
+    EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer), 1),
+              CborNoError);
+    EXPECT_EQ(bm_encode_fields_from_table(&map_encoder, encode_table, 1), CborNoError);
+    EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+    const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+    EXPECT_EQ(encoded_len, 6u); // a1 61 68 f9 xx xx
+
+    float got = -1.0f;
+    BmDecodeTableEntry decode_table[] = {{"h", BM_FIELD_HALF, &got}};
+    CborParser parser;
+    CborValue map;
+    CborValue value;
+    EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 1),
+              CborNoError);
+    EXPECT_EQ(bm_decode_fields_from_table(&value, decode_table, 1), CborNoError);
+    EXPECT_EQ(got, expected[i]) << values[i];
+  }
+}
+
+static const BmStructField soft_data_fields[] = {
+    SENSOR_HEADER_STRUCT_FIELDS(BmSoftDataMsg::Data),
+    {"temperature_deg_c", BM_FIELD_DOUBLE, offsetof(BmSoftDataMsg::Data, temperature_deg_c),
+     NULL},
+};
+static const BmStructTable soft_data_table = {soft_data_fields, 5, sizeof(BmSoftDataMsg::Data)};
+
+TEST_F(BmCommonTest, BmStructTableMatchesHandWrittenMessage) {
+  BmSoftDataMsg::Data d = {};
+  d.header.version = BmSoftDataMsg::VERSION;
+  d.header.reading_time_utc_ms = 1700000000000ULL;
+  d.header.reading_uptime_millis = 123456;
+  d.header.sensor_reading_time_ms = 1700000000010ULL;
+  d.temperature_deg_c = 12.375;
+
+  uint8_t expected[128];
+  size_t expected_len = 0;
+  ASSERT_EQ(BmSoftDataMsg::encode(d, expected, sizeof(expected), &expected_len), CborNoError);
+
+  uint8_t cbor_buffer[128] = {0};
+  CborEncoder encoder;
+  CborEncoder map_encoder;
+  EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer),
+                                   BmSoftDataMsg::NUM_FIELDS),
+            CborNoError);
+  EXPECT_EQ(bm_encode_struct(&map_encoder, &soft_data_table, &d), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+  ASSERT_EQ(encoded_len, expected_len);
+  EXPECT_EQ(memcmp(cbor_buffer, expected, expected_len), 0);
+
+  BmSoftDataMsg::Data got = {};
+  CborParser parser;
+  CborValue map;
+  CborValue value;
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len,
+                                  BmSoftDataMsg::NUM_FIELDS),
+            CborNoError);
+  EXPECT_EQ(bm_decode_struct(&value, &soft_data_table, &got), CborNoError);
+  EXPECT_EQ(decoder_message_leave(&value, &map), CborNoError);
+  EXPECT_EQ(got.header.reading_time_utc_ms, d.header.reading_time_utc_ms);
+  EXPECT_EQ(got.header.sensor_reading_time_ms, d.header.sensor_reading_time_ms);
+  EXPECT_EQ(got.temperature_deg_c, d.temperature_deg_c);
+}
+
+namespace {
+struct TreePort {
+  uint8_t sqi;
+  uint16_t mse;
+};
+struct TreeGps {
+  double lat;
+  double lon;
+};
+struct TreeMsg {
+  SensorHeaderMsg::Data header;
+  TreeGps gps;
+  BmStructArray ports;
+};
+const BmStructField tree_port_fields[] = {
+    {"sqi", BM_FIELD_UINT8, offsetof(TreePort, sqi), NULL},
+    {"mse", BM_FIELD_UINT16, offsetof(TreePort, mse), NULL},
+};
+const BmStructTable tree_port_table = {tree_port_fields, 2, sizeof(TreePort)};
+const BmStructField tree_gps_fields[] = {
+    {"lat", BM_FIELD_DOUBLE, offsetof(TreeGps, lat), NULL},
+    {"lon", BM_FIELD_DOUBLE, offsetof(TreeGps, lon), NULL},
+};
+const BmStructTable tree_gps_table = {tree_gps_fields, 2, sizeof(TreeGps)};
+const BmStructField tree_fields[] = {
+    SENSOR_HEADER_STRUCT_FIELDS(TreeMsg),
+    {"gps", BM_FIELD_MAP, offsetof(TreeMsg, gps), &tree_gps_table},
+    {"ports", BM_FIELD_STRUCT_ARRAY, offsetof(TreeMsg, ports), &tree_port_table},
+};
+const BmStructTable tree_table = {tree_fields, 6, sizeof(TreeMsg)};
+} // namespace
+
+TEST_F(BmCommonTest, BmStructTableNestedMapAndStructArray) {
+  TreePort ports[3] = {{7, 100}, {5, 2000}, {0, 65535}};
+  TreeMsg d = {};
+  d.header.version = 2;
+  d.header.reading_uptime_millis = 99;
+  d.gps = {41.5, -71.25};
+  d.ports = {ports, 3, 3};
+
+  uint8_t cbor_buffer[256] = {0};
+  CborEncoder encoder;
+  CborEncoder map_encoder;
+  EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer), 6),
+            CborNoError);
+  EXPECT_EQ(bm_encode_struct(&map_encoder, &tree_table, &d), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+
+  TreePort got_ports[4] = {};
+  TreeMsg got = {};
+  got.ports = {got_ports, 0, 4};
+  CborParser parser;
+  CborValue map;
+  CborValue value;
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 6),
+            CborNoError);
+  EXPECT_EQ(bm_decode_struct(&value, &tree_table, &got), CborNoError);
+  EXPECT_EQ(decoder_message_leave(&value, &map), CborNoError);
+  EXPECT_EQ(got.header.version, 2u);
+  EXPECT_EQ(got.header.reading_uptime_millis, 99u);
+  EXPECT_EQ(got.gps.lat, 41.5);
+  EXPECT_EQ(got.gps.lon, -71.25);
+  ASSERT_EQ(got.ports.len, 3u);
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(got_ports[i].sqi, ports[i].sqi);
+    EXPECT_EQ(got_ports[i].mse, ports[i].mse);
+  }
+
+  // too few elements of storage: the rest of the tree still decodes
+  TreeMsg small = {};
+  small.ports = {got_ports, 0, 2};
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 6),
+            CborNoError);
+  EXPECT_EQ(bm_decode_struct(&value, &tree_table, &small), CborErrorOutOfMemory);
+  EXPECT_EQ(small.ports.len, 3u);
+  EXPECT_EQ(small.gps.lon, -71.25);
+
+  // the same nested map through plain tables
+  double lat = 0, lon = 0;
+  BmDecodeTableEntry gps_dec[] = {{"lat", BM_FIELD_DOUBLE, &lat}, {"lon", BM_FIELD_DOUBLE, &lon}};
+  BmDecodeTable gps_table = {gps_dec, 2};
+  BmDecodeTableEntry top_dec[] = {{"gps", BM_FIELD_MAP, &gps_table}};
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 6),
+            CborNoError);
+  // the header and ports are not in the table
+  EXPECT_EQ(bm_decode_fields_from_table(&value, top_dec, 1), CborErrorUnsupportedType);
+  EXPECT_EQ(lat, 41.5);
+  EXPECT_EQ(lon, -71.25);
+
+  BmEncoderTableEntry gps_enc[] = {{"lat", BM_FIELD_DOUBLE, &d.gps.lat},
+                                   {"lon", BM_FIELD_DOUBLE, &d.gps.lon}};
+  BmEncoderTable gps_enc_table = {gps_enc, 2};
+  BmEncoderTableEntry top_enc[] = {{"gps", BM_FIELD_MAP, &gps_enc_table}};
+  uint8_t table_buffer[64] = {0};
+  EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, table_buffer, sizeof(table_buffer), 1),
+            CborNoError);
+  EXPECT_EQ(bm_encode_fields_from_table(&map_encoder, top_enc, 1), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  TreeGps gps_only = {};
+  BmStructField gps_only_fields[] = {{"gps", BM_FIELD_MAP, 0, &tree_gps_table}};
+  BmStructTable gps_only_table = {gps_only_fields, 1, sizeof(TreeGps)};
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, table_buffer,
+                                  cbor_encoder_get_buffer_size(&encoder, table_buffer), 1),
+            CborNoError);
+  EXPECT_EQ(bm_decode_struct(&value, &gps_only_table, &gps_only), CborNoError);
+  EXPECT_EQ(gps_only.lat, 41.5);
+}
+
+TEST_F(BmCommonTest, BmHistogramAndSummaryHelpers) {
+  BmHistogram h = {};
+  EXPECT_EQ(bm_histogram_quantile(&h, 0.5f), 0u);
+  for (uint32_t v = 1; v <= 100; v++) {
+    bm_histogram_add(&h, v);
+  }
+  bm_histogram_add(&h, 0);
+  EXPECT_EQ(h.counts[0], 1u);
+  EXPECT_EQ(h.counts[1], 1u);  // 1
+  EXPECT_EQ(h.counts[7], 37u); // 64..100
+  EXPECT_EQ(bm_histogram_quantile(&h, 0.0f), 0u);
+  EXPECT_EQ(bm_histogram_quantile(&h, 0.5f), 63u);
+  EXPECT_EQ(bm_histogram_quantile(&h, 0.99f), 127u);
+
+  BmHistogram other = {};
+  bm_histogram_add(&other, UINT32_MAX);
+  bm_histogram_merge(&h, &other);
+  EXPECT_EQ(h.counts[32], 1u);
+  EXPECT_EQ(bm_histogram_quantile(&h, 1.0f), (uint64_t)UINT32_MAX);
+
+  BmSummary a = {}, b = {};
+  bm_summary_add(&a, 3.0f);
+  bm_summary_add(&a, -1.0f);
+  bm_summary_merge(&b, &a);
+  bm_summary_add(&b, 10.0f);
+  EXPECT_EQ(b.count, 3u);
+  EXPECT_EQ(b.min, -1.0f);
+  EXPECT_EQ(b.max, 10.0f);
+  EXPECT_EQ(b.sum, 12.0);
+}
+
+TEST_F(BmCommonTest, BmEncodeDecodeHistogramAndSummaryFromTable) {
+  BmHistogram hist = {}, empty_hist = {};
+  bm_histogram_add(&hist, 100);
+  bm_histogram_add(&hist, 120);
+  bm_histogram_add(&hist, 3000);
+  BmSummary summary = {}, empty_summary = {};
+  bm_summary_add(&summary, 1.5f);
+  bm_summary_add(&summary, 4.5f);
+
+  BmEncoderTableEntry encode_table[] = {
+      {"lat", BM_FIELD_HISTOGRAM, &hist},
+      {"none", BM_FIELD_HISTOGRAM, &empty_hist},
+      {"temp", BM_FIELD_SUMMARY, &summary},
+      {"idle", BM_FIELD_SUMMARY, &empty_summary},
+  };
+  const size_t n = sizeof(encode_table) / sizeof(encode_table[0]);
+
+  uint8_t cbor_buffer[256] = {0};
+  CborEncoder encoder;
+  CborEncoder map_encoder;
+  CborError err = encoder_message_create(&encoder, &map_encoder, cbor_buffer,
+                                         sizeof(cbor_buffer), n);
+  EXPECT_EQ(err, CborNoError);
+  EXPECT_EQ(bm_encode_fields_from_table(&map_encoder, encode_table, n), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+  // only buckets 7..12 are sent for "lat": [7, 2, 0, 0, 0, 0, 1]
+  EXPECT_LT(encoded_len, 64u);
+
+  BmHistogram got_hist, got_empty_hist;
+  BmSummary got_summary, got_empty_summary;
+  memset(&got_hist, 0xff, sizeof(got_hist));
+  memset(&got_empty_hist, 0xff, sizeof(got_empty_hist));
+  memset(&got_summary, 0xff, sizeof(got_summary));
+  memset(&got_empty_summary, 0xff, sizeof(got_empty_summary));
+  BmDecodeTableEntry decode_table[] = {
+      {"lat", BM_FIELD_HISTOGRAM, &got_hist},
+      {"none", BM_FIELD_HISTOGRAM, &got_empty_hist},
+      {"temp", BM_FIELD_SUMMARY, &got_summary},
+      {"idle", BM_FIELD_SUMMARY, &got_empty_summary},
+  };
+
+  CborParser parser;
+  CborValue map;
+  CborValue value;
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, n),
+            CborNoError);
+  EXPECT_EQ(bm_decode_fields_from_table(&value, decode_table, n), CborNoError);
+  EXPECT_EQ(decoder_message_leave(&value, &map), CborNoError);
+
+  EXPECT_EQ(memcmp(&got_hist, &hist, sizeof(hist)), 0);
+  EXPECT_EQ(memcmp(&got_empty_hist, &empty_hist, sizeof(empty_hist)), 0);
+  EXPECT_EQ(got_summary.count, 2u);
+  EXPECT_EQ(got_summary.min, 1.5f);
+  EXPECT_EQ(got_summary.max, 4.5f);
+  EXPECT_EQ(got_summary.sum, 6.0);
+  EXPECT_EQ(got_empty_summary.count, 0u);
+}
+
+TEST_F(BmCommonTest, BmDecodeHistogramAndSummaryMergeIntoDestination) {
+  BmHistogram hist = {};
+  bm_histogram_add(&hist, 100);
+  bm_histogram_add(&hist, 3000);
+  BmSummary summary = {};
+  bm_summary_add(&summary, 1.5f);
+  bm_summary_add(&summary, 4.5f);
+
+  BmEncoderTableEntry encode_table[] = {
+      {"lat", BM_FIELD_HISTOGRAM, &hist},
+      {"temp", BM_FIELD_SUMMARY, &summary},
+  };
+  const size_t n = sizeof(encode_table) / sizeof(encode_table[0]);
+
+  uint8_t cbor_buffer[128] = {0};
+  CborEncoder encoder;
+  CborEncoder map_encoder;
+  EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer,
+                                   sizeof(cbor_buffer), n),
+            CborNoError);
+  EXPECT_EQ(bm_encode_fields_from_table(&map_encoder, encode_table, n), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+
+  // the receiver already holds one sample of its own
+  BmHistogram got_hist = {};
+  bm_histogram_add(&got_hist, 100);
+  BmSummary got_summary = {};
+  bm_summary_add(&got_summary, 0.5f);
+  BmDecodeTableEntry decode_table[] = {
+      {"lat", BM_FIELD_HISTOGRAM_MERGE, &got_hist},
+      {"temp", BM_FIELD_SUMMARY_MERGE, &got_summary},
+  };
+
+  for (int i = 0; i < 2; i++) {
+    CborParser parser;
+    CborValue map;
+    CborValue value;
+    EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, n),
+              CborNoError);
+    EXPECT_EQ(bm_decode_fields_from_table(&value, decode_table, n), CborNoError);
+    EXPECT_EQ(decoder_message_leave(&value, &map), CborNoError);
+  }
+
+  BmHistogram want_hist = {};
+  bm_histogram_add(&want_hist, 100);
+  bm_histogram_merge(&want_hist, &hist);
+  bm_histogram_merge(&want_hist, &hist);
+  EXPECT_EQ(memcmp(&got_hist, &want_hist, sizeof(want_hist)), 0);
+  EXPECT_EQ(got_summary.count, 5u);
+  EXPECT_EQ(got_summary.min, 0.5f);
+  EXPECT_EQ(got_summary.max, 4.5f);
+  EXPECT_EQ(got_summary.sum, 12.5);
+}
+
+TEST_F(BmCommonTest, BmDecodeHistogramRejectsTooManyBuckets) {
+  uint8_t cbor_buffer[128] = {0};
+  CborEncoder encoder, map_encoder, array;
+  EXPECT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer), 1),
+            CborNoError);
+  EXPECT_EQ(cbor_encode_text_stringz(&map_encoder, "lat"), CborNoError);
+  EXPECT_EQ(cbor_encoder_create_array(&map_encoder, &array, 3), CborNoError);
+  EXPECT_EQ(cbor_encode_uint(&array, BM_HISTOGRAM_NUM_BUCKETS - 1), CborNoError);
+  EXPECT_EQ(cbor_encode_uint(&array, 1), CborNoError);
+  EXPECT_EQ(cbor_encode_uint(&array, 1), CborNoError);
+  EXPECT_EQ(cbor_encoder_close_container(&map_encoder, &array), CborNoError);
+  EXPECT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+
+  BmHistogram got = {};
+  got.counts[0] = 5;
+  BmDecodeTableEntry decode_table[] = {{"lat", BM_FIELD_HISTOGRAM, &got}};
+  CborParser parser;
+  CborValue map;
+  CborValue value;
+  EXPECT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 1),
+            CborNoError);
+  EXPECT_EQ(bm_decode_fields_from_table(&value, decode_table, 1), CborErrorImproperValue);
+  EXPECT_EQ(got.counts[0], 5u);
+}
+
 TEST_F(BmCommonTest, MetricsReplyEncodeDecodeEnvelope) {
   uint8_t num_ports = 1;
   uint8_t sqi_1 = 5;
@@ -1695,6 +2363,59 @@ TEST_F(BmCommonTest, MetricsReplyDecodeSkipsAbsentComponent) {
   EXPECT_EQ(got_num_ports, 0xAA); // untouched: component absent
 }
 
+TEST_F(BmCommonTest, MetricsReplyDecodeChunkedAndNonMinimalKeys) {
+  uint8_t num_ports = 3;
+  BmEncoderTableEntry enc_fields[1];
+  enc_fields[0] = {"num_ports", BM_FIELD_UINT8, &num_ports};
+
+  MetricsComponent comp = {};
+  comp.key = "network_port_stats";
+  comp.fields = enc_fields;
+  comp.num_fields = 1;
+
+  MetricsReplyData d = {};
+  d.version = METRICS_REPLY_VERSION;
+  d.node_id = 7;
+  d.uptime_ms = 1;
+  d.components = &comp;
+  d.num_components = 1;
+
+  uint8_t cbor_buffer[128];
+  size_t len = 0;
+  ASSERT_EQ(metrics_reply_encode(&d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+
+  // the component key as a definite length text string with a 1 byte header
+  const std::string minimal = std::string("\x72") + "network_port_stats";
+  const std::string encoded((const char *)cbor_buffer, len);
+  const size_t at = encoded.find(minimal);
+  ASSERT_NE(at, std::string::npos);
+
+  const std::string rewritten_keys[] = {
+      // indefinite length, two chunks
+      std::string("\x7f\x67") + "network" + "\x6b" + "_port_stats" + "\xff",
+      // definite length with a needless 1 byte length argument
+      std::string("\x78\x12") + "network_port_stats",
+  };
+  for (const std::string &key : rewritten_keys) {
+    std::string msg = encoded;
+    msg.replace(at, minimal.size(), key);
+
+    uint8_t got_num_ports = 0;
+    BmDecodeTableEntry dec_fields[1];
+    dec_fields[0] = {"num_ports", BM_FIELD_UINT8, &got_num_ports};
+    MetricsComponentDecode dcomp = {};
+    dcomp.key = "network_port_stats";
+    dcomp.fields = dec_fields;
+    dcomp.num_fields = 1;
+    MetricsReplyDecode out = {};
+    out.components = &dcomp;
+    out.num_components = 1;
+
+    EXPECT_EQ(metrics_reply_decode((const uint8_t *)msg.data(), msg.size(), &out), CborNoError);
+    EXPECT_EQ(got_num_ports, num_ports);
+  }
+}
+
 TEST_F(BmCommonTest, MetricsReplyMultipleComponentsAndPorts) {
   uint8_t num_ports = 2;
   uint8_t sqi_1 = 7, sqi_2 = 6;
@@ -1768,6 +2489,159 @@ TEST_F(BmCommonTest, MetricsReplyMultipleComponentsAndPorts) {
   EXPECT_EQ(got_heap, 54321u);
 }
 
+TEST_F(BmCommonTest, MetricsReplyDeltaEncodeDecode) {
+  uint32_t rx = 10, tx = 20;
+  float temp = 21.5f;
+  BmEncoderTableEntry net_fields[2];
+  net_fields[0] = {"rx", BM_FIELD_UINT32, &rx};
+  net_fields[1] = {"tx", BM_FIELD_UINT32, &tx};
+  BmEncoderTableEntry sys_fields[1];
+  sys_fields[0] = {"temp", BM_FIELD_FLOAT, &temp};
+
+  MetricsComponent comps[2] = {};
+  comps[0] = {"net", net_fields, 2};
+  comps[1] = {"sys", sys_fields, 1};
+
+  MetricsReplyData d = {};
+  d.version = METRICS_REPLY_VERSION;
+  d.node_id = 42;
+  d.components = comps;
+  d.num_components = 2;
+
+  uint64_t snapshot[3];
+  MetricsDeltaState state;
+  metrics_delta_init(&state, snapshot, 3, 2);
+
+  uint32_t got_rx = 0, got_tx = 0;
+  float got_temp = 0;
+  BmDecodeTableEntry net_dec[2];
+  net_dec[0] = {"rx", BM_FIELD_UINT32, &got_rx};
+  net_dec[1] = {"tx", BM_FIELD_UINT32, &got_tx};
+  BmDecodeTableEntry sys_dec[1];
+  sys_dec[0] = {"temp", BM_FIELD_FLOAT, &got_temp};
+  MetricsComponentDecode dcomps[2] = {};
+  dcomps[0] = {"net", net_dec, 2};
+  dcomps[1] = {"sys", sys_dec, 1};
+  MetricsReplyDecode out = {};
+  out.components = dcomps;
+  out.num_components = 2;
+
+  uint8_t cbor_buffer[256];
+  size_t full_len = 0, len = 0;
+
+  // the first reply is full and identical to the plain encoding
+  ASSERT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &full_len),
+            CborNoError);
+  uint8_t plain[256];
+  ASSERT_EQ(metrics_reply_encode(&d, plain, sizeof(plain), &len), CborNoError);
+  ASSERT_EQ(len, full_len);
+  EXPECT_EQ(memcmp(plain, cbor_buffer, len), 0);
+  ASSERT_EQ(metrics_reply_decode(cbor_buffer, full_len, &out), CborNoError);
+  EXPECT_FALSE(out.delta);
+  EXPECT_EQ(got_rx, 10u);
+  EXPECT_EQ(got_tx, 20u);
+  EXPECT_EQ(got_temp, 21.5f);
+
+  // only rx changed, so only it is sent and merged
+  rx = 11;
+  got_tx = 0;
+  got_temp = 0;
+  ASSERT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_LT(len, full_len);
+  ASSERT_EQ(metrics_reply_decode(cbor_buffer, len, &out), CborNoError);
+  EXPECT_TRUE(out.delta);
+  EXPECT_EQ(out.node_id, 42u);
+  EXPECT_EQ(got_rx, 11u);
+  EXPECT_EQ(got_tx, 0u);
+  EXPECT_EQ(got_temp, 0.0f);
+
+  // nothing changed: a delta with an empty data map
+  ASSERT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(metrics_reply_decode(cbor_buffer, len, &out), CborNoError);
+  EXPECT_TRUE(out.delta);
+  EXPECT_EQ(got_rx, 11u);
+
+  // max_deltas reached, the next reply is full again
+  ASSERT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(metrics_reply_decode(cbor_buffer, len, &out), CborNoError);
+  EXPECT_FALSE(out.delta);
+  EXPECT_EQ(got_tx, 20u);
+  EXPECT_EQ(got_temp, 21.5f);
+
+  // a failed encode leaves the snapshot alone
+  temp = 22.0f;
+  EXPECT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, 8, &len), CborErrorOutOfMemory);
+  ASSERT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  got_temp = 0;
+  ASSERT_EQ(metrics_reply_decode(cbor_buffer, len, &out), CborNoError);
+  EXPECT_TRUE(out.delta);
+  EXPECT_EQ(got_temp, 22.0f);
+
+  metrics_delta_force_full(&state);
+  ASSERT_EQ(metrics_reply_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(metrics_reply_decode(cbor_buffer, len, &out), CborNoError);
+  EXPECT_FALSE(out.delta);
+
+  // snapshot too small for the component table
+  MetricsDeltaState small;
+  metrics_delta_init(&small, snapshot, 2, 2);
+  EXPECT_EQ(metrics_reply_encode_delta(&d, &small, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborErrorOutOfMemory);
+}
+
+TEST_F(BmCommonTest, MetricsReplyDecodeManyComponentsSinglePass) {
+  // more components on the wire than requested, in a different order, and
+  // more requested than fit the hash table
+  const size_t num_sent = 48;
+  std::vector<std::string> keys(num_sent);
+  std::vector<uint32_t> values(num_sent);
+  std::vector<BmEncoderTableEntry> enc_fields(num_sent);
+  std::vector<MetricsComponent> comps(num_sent);
+  for (size_t i = 0; i < num_sent; i++) {
+    keys[i] = "component_" + std::to_string(i);
+    values[i] = 1000 + i;
+    enc_fields[i] = {"value", BM_FIELD_UINT32, &values[i]};
+    comps[i] = {keys[i].c_str(), &enc_fields[i], 1};
+  }
+
+  MetricsReplyData d = {};
+  d.version = METRICS_REPLY_VERSION;
+  d.node_id = 3;
+  d.components = comps.data();
+  d.num_components = num_sent;
+
+  uint8_t cbor_buffer[2048];
+  size_t len = 0;
+  ASSERT_EQ(metrics_reply_encode(&d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+
+  for (size_t num_requested : {(size_t)20, (size_t)METRICS_REPLY_DECODE_MAX_COMPONENTS,
+                               (size_t)40}) {
+    std::vector<uint32_t> got(num_requested, 0);
+    std::vector<BmDecodeTableEntry> dec_fields(num_requested);
+    std::vector<MetricsComponentDecode> dcomps(num_requested);
+    for (size_t j = 0; j < num_requested; j++) {
+      // last first, plus one that is not sent
+      const size_t i = num_sent - 1 - j;
+      dec_fields[j] = {"value", BM_FIELD_UINT32, &got[j]};
+      dcomps[j] = {j == 0 ? "not_sent" : keys[i].c_str(), &dec_fields[j], 1};
+    }
+
+    MetricsReplyDecode out = {};
+    out.components = dcomps.data();
+    out.num_components = num_requested;
+    ASSERT_EQ(metrics_reply_decode(cbor_buffer, len, &out), CborNoError) << num_requested;
+    EXPECT_EQ(got[0], 0u);
+    for (size_t j = 1; j < num_requested; j++) {
+      EXPECT_EQ(got[j], 1000 + num_sent - 1 - j) << num_requested << " " << j;
+    }
+  }
+}
+
 TEST_F(BmCommonTest, MetricsReplyDecodeToleratesExtraComponentFields) {
   uint8_t num_ports = 1;
   uint8_t sqi_1 = 9;
@@ -1813,3 +2687,576 @@ TEST_F(BmCommonTest, MetricsReplyDecodeToleratesExtraComponentFields) {
   EXPECT_EQ(got_num_ports, num_ports);
   EXPECT_EQ(got_sqi, sqi_1);
 }
+
+static NetworkPortStatsData make_port_stats(uint8_t num_ports) {
+  NetworkPortStatsData d = {};
+  d.num_ports = num_ports;
+  for (uint8_t i = 0; i < num_ports; i++) {
+    d.sqi[i] = 7 - i;
+    d.mse[i] = 100 + 1000 * i;
+    d.lq[i] = 3;
+    d.rxe[i] = 65530 + i;
+    d.sye[i] = 1000 + i;
+    d.fc[i] = 300;
+    d.len[i] = 255;
+    d.algn[i] = 256;
+  }
+  return d;
+}
+
+TEST_F(BmCommonTest, NetworkPortStatsEncodeDecode) {
+  NetworkPortStatsData d = make_port_stats(4);
+  uint8_t cbor_buffer[256];
+  size_t len = 0;
+  ASSERT_EQ(network_port_stats_encode(&d, cbor_buffer, sizeof(cbor_buffer), &len), CborNoError);
+  // one typed byte string per array: key, tag and string header plus
+  // 4 bytes for the uint8 arrays and len, 8 for the others
+  EXPECT_LT(len, 130u);
+
+  NetworkPortStatsData got;
+  memset(&got, 0xff, sizeof(got));
+  bool delta = true;
+  ASSERT_EQ(network_port_stats_decode(&got, &delta, cbor_buffer, len), CborNoError);
+  EXPECT_FALSE(delta);
+  EXPECT_EQ(got.num_ports, 4);
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(got.sqi[i], d.sqi[i]);
+    EXPECT_EQ(got.mse[i], d.mse[i]);
+    EXPECT_EQ(got.lq[i], d.lq[i]);
+    EXPECT_EQ(got.rxe[i], d.rxe[i]);
+    EXPECT_EQ(got.sye[i], d.sye[i]);
+    EXPECT_EQ(got.fc[i], d.fc[i]);
+    EXPECT_EQ(got.len[i], d.len[i]);
+    EXPECT_EQ(got.algn[i], d.algn[i]);
+  }
+
+  // no ports at all
+  NetworkPortStatsData none = make_port_stats(0);
+  ASSERT_EQ(network_port_stats_encode(&none, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(network_port_stats_decode(&got, NULL, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(got.num_ports, 0);
+
+  // too many ports to encode
+  none.num_ports = NETWORK_PORT_STATS_MAX_PORTS + 1;
+  EXPECT_EQ(network_port_stats_encode(&none, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborErrorDataTooLarge);
+}
+
+TEST_F(BmCommonTest, NetworkPortStatsDecodeRejectsBadArrays) {
+  // num_ports says 2 but sqi holds 3 bytes
+  uint8_t cbor_buffer[256];
+  CborEncoder encoder, map_encoder;
+  const uint8_t three[3] = {1, 2, 3};
+  const uint8_t two[2] = {1, 2};
+  const uint16_t two16[2] = {1, 2};
+  ASSERT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer),
+                                   NETWORK_PORT_STATS_NUM_FIELDS),
+            CborNoError);
+  EXPECT_EQ(encode_key_value_uint8(&map_encoder, "num_ports", 2), CborNoError);
+  EXPECT_EQ(encode_key_value_uint8_typed_array(&map_encoder, "sqi", three, 3), CborNoError);
+  EXPECT_EQ(encode_key_value_uint16_typed_array(&map_encoder, "mse", two16, 2), CborNoError);
+  EXPECT_EQ(encode_key_value_uint8_typed_array(&map_encoder, "lq", two, 2), CborNoError);
+  for (const char *key : {"rxe", "sye", "fc", "len", "algn"}) {
+    EXPECT_EQ(encode_key_value_uint16_typed_array(&map_encoder, key, two16, 2), CborNoError);
+  }
+  ASSERT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+
+  NetworkPortStatsData got = make_port_stats(1);
+  EXPECT_EQ(network_port_stats_decode(&got, NULL, cbor_buffer, len), CborErrorImproperValue);
+  EXPECT_EQ(got.num_ports, 1); // untouched
+
+  // sqi as a uint16 array is the wrong element type
+  const uint16_t wide[2] = {1000, 2000};
+  ASSERT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer),
+                                   NETWORK_PORT_STATS_NUM_FIELDS),
+            CborNoError);
+  EXPECT_EQ(encode_key_value_uint8(&map_encoder, "num_ports", 2), CborNoError);
+  EXPECT_EQ(encode_key_value_uint16_typed_array(&map_encoder, "sqi", wide, 2), CborNoError);
+  EXPECT_EQ(encode_key_value_uint16_typed_array(&map_encoder, "mse", two16, 2), CborNoError);
+  EXPECT_EQ(encode_key_value_uint8_typed_array(&map_encoder, "lq", two, 2), CborNoError);
+  for (const char *key : {"rxe", "sye", "fc", "len", "algn"}) {
+    EXPECT_EQ(encode_key_value_uint16_typed_array(&map_encoder, key, two16, 2), CborNoError);
+  }
+  ASSERT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  EXPECT_EQ(network_port_stats_decode(&got, NULL, cbor_buffer,
+                                      cbor_encoder_get_buffer_size(&encoder, cbor_buffer)),
+            CborErrorInappropriateTagForType);
+}
+
+TEST_F(BmCommonTest, Uint16TypedArrayBigEndianAndNarrow) {
+  // tag 65 (uint16 big endian) from another producer
+  const uint8_t cbor[] = {0xa1, 0x61, 'a', 0xd8, 0x41, 0x44, 0x01, 0x02, 0xff, 0xfe};
+  CborParser parser;
+  CborValue map, value;
+  ASSERT_EQ(decoder_message_enter(&map, &value, &parser, (uint8_t *)cbor, sizeof(cbor), 1),
+            CborNoError);
+  uint16_t out[4];
+  size_t len = 4;
+  ASSERT_EQ(decode_key_value_uint16_typed_array(out, &len, &value, "a"), CborNoError);
+  ASSERT_EQ(len, 2u);
+  EXPECT_EQ(out[0], 0x0102);
+  EXPECT_EQ(out[1], 0xfffe);
+
+  // a narrow array widened in place, and a capacity that is too small
+  uint8_t cbor_buffer[64];
+  CborEncoder encoder, map_encoder;
+  const uint16_t small[5] = {0, 1, 2, 254, 255};
+  ASSERT_EQ(encoder_message_create(&encoder, &map_encoder, cbor_buffer, sizeof(cbor_buffer), 1),
+            CborNoError);
+  EXPECT_EQ(encode_key_value_uint16_typed_array(&map_encoder, "a", small, 5), CborNoError);
+  ASSERT_EQ(encoder_message_finish(&encoder, &map_encoder), CborNoError);
+  const size_t encoded_len = cbor_encoder_get_buffer_size(&encoder, cbor_buffer);
+  EXPECT_EQ(encoded_len, 1u + 2u + 2u + 1u + 5u); // map, key, tag 64, bytes(5)
+
+  uint16_t wide[5];
+  len = 4;
+  ASSERT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 1),
+            CborNoError);
+  EXPECT_EQ(decode_key_value_uint16_typed_array(wide, &len, &value, "a"), CborErrorOutOfMemory);
+  EXPECT_EQ(len, 5u);
+  ASSERT_EQ(decoder_message_enter(&map, &value, &parser, cbor_buffer, encoded_len, 1),
+            CborNoError);
+  ASSERT_EQ(decode_key_value_uint16_typed_array(wide, &len, &value, "a"), CborNoError);
+  EXPECT_EQ(memcmp(wide, small, sizeof(small)), 0);
+}
+
+TEST_F(BmCommonTest, NetworkPortStatsDeltaCounters) {
+  NetworkPortStatsData d = make_port_stats(3);
+  NetworkPortStatsDeltaState state;
+  network_port_stats_delta_init(&state, 2);
+
+  uint8_t cbor_buffer[256];
+  size_t full_len = 0, len = 0;
+  NetworkPortStatsData rx = {};
+  bool delta = true;
+  ASSERT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer),
+                                            &full_len),
+            CborNoError);
+  ASSERT_EQ(network_port_stats_decode(&rx, &delta, cbor_buffer, full_len), CborNoError);
+  EXPECT_FALSE(delta);
+
+  // counters move a little, rxe wraps around
+  for (size_t i = 0; i < 3; i++) {
+    d.rxe[i] += 10;
+    d.algn[i] += 3;
+  }
+  d.sqi[0] = 1;
+  ASSERT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_LT(len, full_len);
+  ASSERT_EQ(network_port_stats_decode(&rx, &delta, cbor_buffer, len), CborNoError);
+  EXPECT_TRUE(delta);
+  EXPECT_EQ(memcmp(&rx, &d, sizeof(d)), 0);
+
+  // a failed encode keeps the state
+  d.fc[2] = 9;
+  EXPECT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, 16, &len),
+            CborErrorOutOfMemory);
+  ASSERT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(network_port_stats_decode(&rx, &delta, cbor_buffer, len), CborNoError);
+  EXPECT_TRUE(delta);
+  EXPECT_EQ(rx.fc[2], 9);
+
+  // max_deltas reached
+  ASSERT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(network_port_stats_decode(&rx, &delta, cbor_buffer, len), CborNoError);
+  EXPECT_FALSE(delta);
+
+  // a port count change forces a full reply
+  d = make_port_stats(2);
+  ASSERT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(network_port_stats_decode(&rx, &delta, cbor_buffer, len), CborNoError);
+  EXPECT_FALSE(delta);
+  EXPECT_EQ(memcmp(&rx, &d, sizeof(d)), 0);
+
+  // a receiver that missed that full reply cannot apply the next delta
+  d.rxe[0] += 1;
+  ASSERT_EQ(network_port_stats_encode_delta(&d, &state, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  NetworkPortStatsData stale = make_port_stats(3);
+  const NetworkPortStatsData before = stale;
+  EXPECT_EQ(network_port_stats_decode(&stale, &delta, cbor_buffer, len), CborErrorImproperValue);
+  EXPECT_EQ(memcmp(&stale, &before, sizeof(before)), 0);
+  ASSERT_EQ(network_port_stats_decode(&rx, &delta, cbor_buffer, len), CborNoError);
+  EXPECT_TRUE(delta);
+  EXPECT_EQ(memcmp(&rx, &d, sizeof(d)), 0);
+}
+
+TEST_F(BmCommonTest, NetworkPortAggregatorTrend) {
+  NetworkPortSeries series[4];
+  NetworkPortAggregator agg;
+  ASSERT_TRUE(network_port_aggregator_init(&agg, series, 4));
+
+  NetworkPortTrend trend;
+  EXPECT_FALSE(network_port_aggregator_trend(&agg, 0x1234, 0, 60000, &trend));
+
+  // one sample a second, rxe wraps past 65535 along the way
+  NetworkPortStatsData d = make_port_stats(2);
+  for (uint32_t t = 0; t < 40; t++) {
+    d.sqi[0] = (uint8_t)(t % 8);
+    d.mse[1] = (uint16_t)(1000 + t);
+    ASSERT_EQ(network_port_aggregator_add(&agg, 0x1234, 1000 * t, &d), 2u);
+    d.rxe[0] += 2;
+    d.fc[1] += 1;
+  }
+  EXPECT_EQ(agg.count, 2u);
+
+  // the last 5 samples, t = 35..39
+  ASSERT_TRUE(network_port_aggregator_trend(&agg, 0x1234, 0, 4000, &trend));
+  EXPECT_EQ(trend.samples, 5u);
+  EXPECT_FLOAT_EQ(trend.sqi.min, 3);
+  EXPECT_FLOAT_EQ(trend.sqi.max, 7);
+  EXPECT_FLOAT_EQ(trend.sqi.mean, 5);
+  EXPECT_FLOAT_EQ(trend.lq.mean, 3);
+  EXPECT_FLOAT_EQ(trend.error_rate[0], 2);
+  EXPECT_FLOAT_EQ(trend.error_rate[2], 0);
+
+  // a window wider than the ring stops at the oldest sample held
+  ASSERT_TRUE(network_port_aggregator_trend(&agg, 0x1234, 1, 100000, &trend));
+  EXPECT_EQ(trend.samples, (uint32_t)NETWORK_PORT_SERIES_LEN);
+  EXPECT_FLOAT_EQ(trend.mse.min, 1008);
+  EXPECT_FLOAT_EQ(trend.mse.max, 1039);
+  EXPECT_FLOAT_EQ(trend.mse.mean, 1023.5f);
+  EXPECT_FLOAT_EQ(trend.error_rate[2], 1);
+
+  // a single sample has no rate
+  ASSERT_TRUE(network_port_aggregator_trend(&agg, 0x1234, 1, 0, &trend));
+  EXPECT_EQ(trend.samples, 1u);
+  EXPECT_FLOAT_EQ(trend.error_rate[2], 0);
+
+  // room for three series only
+  EXPECT_EQ(network_port_aggregator_add(&agg, 0x5678, 0, &d), 1u);
+  EXPECT_TRUE(network_port_aggregator_trend(&agg, 0x5678, 0, 0, &trend));
+  EXPECT_FALSE(network_port_aggregator_trend(&agg, 0x5678, 1, 0, &trend));
+
+  // the slot index is masked with capacity - 1, anything else is refused
+  EXPECT_FALSE(network_port_aggregator_init(&agg, series, 0));
+  EXPECT_EQ(network_port_aggregator_add(&agg, 0x1234, 0, &d), 0u);
+  EXPECT_FALSE(network_port_aggregator_trend(&agg, 0x1234, 0, 0, &trend));
+  EXPECT_FALSE(network_port_aggregator_init(&agg, series, 3));
+  EXPECT_EQ(network_port_aggregator_add(&agg, 0x1234, 0, &d), 0u);
+}
+
+static CborError utc_handler(const BmPubSubPayload *payload, void *ctx) {
+  const bm_common_pub_sub_utc_t *utc = (const bm_common_pub_sub_utc_t *)payload->payload;
+  *(uint64_t *)ctx = utc->utc_us;
+  return payload->cbor ? CborErrorInternalError : CborNoError;
+}
+
+static CborError cbor_handler(const BmPubSubPayload *payload, void *ctx) {
+  uint64_t value = 0;
+  if (!payload->cbor || !cbor_value_is_unsigned_integer(payload->cbor)) {
+    return CborErrorIllegalType;
+  }
+  cbor_value_get_uint64(payload->cbor, &value);
+  *(uint64_t *)ctx = value + payload->version;
+  return CborNoError;
+}
+
+BM_PUB_SUB_DISPATCH_TABLE(test_dispatch,
+                          {1, 1, sizeof(bm_common_pub_sub_utc_t), false, utc_handler},
+                          {2, 1, 1, true, cbor_handler}, {2, 2, 1, true, cbor_handler});
+
+TEST_F(BmCommonTest, PubSubDispatch) {
+  uint8_t pub[sizeof(bm_common_pub_sub_header_t) + sizeof(bm_common_pub_sub_utc_t)];
+  bm_common_pub_sub_header_t *header = (bm_common_pub_sub_header_t *)pub;
+  const bm_common_pub_sub_utc_t utc = {1700000000000000ull};
+  header->type = 1;
+  header->version = 1;
+  memcpy(header->payload, &utc, sizeof(utc));
+
+  uint64_t out = 0;
+  EXPECT_EQ(bm_pub_sub_dispatch(&test_dispatch, pub, sizeof(pub), &out), CborNoError);
+  EXPECT_EQ(out, utc.utc_us);
+
+  // short payloads and headers never reach the handler
+  EXPECT_EQ(bm_pub_sub_dispatch(&test_dispatch, pub, sizeof(pub) - 1, &out),
+            CborErrorUnexpectedEOF);
+  EXPECT_EQ(bm_pub_sub_dispatch(&test_dispatch, pub, 1, &out), CborErrorUnexpectedEOF);
+
+  // unknown type or version
+  header->version = 3;
+  EXPECT_EQ(bm_pub_sub_dispatch(&test_dispatch, pub, sizeof(pub), &out),
+            CborErrorUnsupportedType);
+
+  // CBOR payloads arrive parsed, routed by version
+  header->type = 2;
+  header->version = 2;
+  CborEncoder encoder;
+  cbor_encoder_init(&encoder, header->payload, sizeof(pub) - sizeof(*header), 0);
+  ASSERT_EQ(cbor_encode_uint(&encoder, 1000), CborNoError);
+  const size_t len = sizeof(*header) + cbor_encoder_get_buffer_size(&encoder, header->payload);
+  EXPECT_EQ(bm_pub_sub_dispatch(&test_dispatch, pub, len, &out), CborNoError);
+  EXPECT_EQ(out, 1002u);
+
+  // the handler's result is passed back
+  header->payload[0] = 0x60; // empty text string
+  EXPECT_EQ(bm_pub_sub_dispatch(&test_dispatch, pub, len, &out), CborErrorIllegalType);
+}
+
+TEST_F(BmCommonTest, PrintPublicationIovAndParse) {
+  const char fname[] = "log.txt";
+  const char data[] = "hello world\n";
+  BmPrintPublicationIov pub;
+  ASSERT_EQ(bm_print_publication_iov(&pub, 0xdeadbeefcafe, fname, strlen(fname), data,
+                                     strlen(data), 1),
+            CborNoError);
+
+  uint8_t buf[64];
+  const size_t len = bm_print_publication_size(strlen(fname), strlen(data));
+  EXPECT_EQ(bm_iov_gather(pub.iov, BM_PRINT_PUBLICATION_IOV_COUNT, buf, len - 1), 0u);
+  ASSERT_EQ(bm_iov_gather(pub.iov, BM_PRINT_PUBLICATION_IOV_COUNT, buf, sizeof(buf)), len);
+
+  // same layout as the struct the publishers fill in by hand
+  const bm_print_publication_t *p = (const bm_print_publication_t *)buf;
+  EXPECT_EQ(p->target_node_id, 0xdeadbeefcafeu);
+  EXPECT_EQ(p->fname_len, strlen(fname));
+  EXPECT_EQ(p->data_len, strlen(data));
+  EXPECT_EQ(memcmp(p->fnameAndData, "log.txthello world\n", len - sizeof(*p)), 0);
+
+  BmPrintPublicationView view;
+  ASSERT_EQ(bm_print_publication_parse(buf, len, &view), CborNoError);
+  EXPECT_EQ(view.target_node_id, 0xdeadbeefcafeu);
+  EXPECT_EQ(view.print_time, 1);
+  EXPECT_EQ(std::string(view.fname, view.fname_len), fname);
+  EXPECT_EQ(std::string(view.data, view.data_len), data);
+  EXPECT_EQ(view.fname, (const char *)buf + sizeof(*p));
+
+  EXPECT_EQ(bm_print_publication_parse(buf, len - 1, &view), CborErrorUnexpectedEOF);
+  EXPECT_EQ(bm_print_publication_parse(buf, 4, &view), CborErrorUnexpectedEOF);
+  EXPECT_EQ(bm_print_publication_parse(buf, len + 1, &view), CborErrorGarbageAtEnd);
+
+  // stdout prints have no file name
+  ASSERT_EQ(bm_print_publication_iov(&pub, 0, NULL, 0, data, strlen(data), 0), CborNoError);
+  const size_t stdout_len =
+      bm_iov_gather(pub.iov, BM_PRINT_PUBLICATION_IOV_COUNT, buf, sizeof(buf));
+  ASSERT_EQ(bm_print_publication_parse(buf, stdout_len, &view), CborNoError);
+  EXPECT_EQ(view.fname, nullptr);
+  EXPECT_EQ(std::string(view.data, view.data_len), data);
+
+  EXPECT_EQ(bm_print_publication_iov(&pub, 0, NULL, 0, data, 70000, 0), CborErrorDataTooLarge);
+}
+
+struct PrintBatchSink {
+  std::vector<std::vector<uint8_t>> batches;
+  CborError err = CborNoError;
+};
+
+static CborError print_batch_flush(const uint8_t *buf, size_t len, void *ctx) {
+  PrintBatchSink *sink = (PrintBatchSink *)ctx;
+  if (sink->err != CborNoError) {
+    return sink->err;
+  }
+  sink->batches.emplace_back(buf, buf + len);
+  return CborNoError;
+}
+
+struct PrintBatchSplit {
+  std::vector<std::string> prints;
+  std::string fname;
+};
+
+static CborError print_batch_handler(const BmPubSubPayload *payload, void *ctx) {
+  PrintBatchSplit *split = (PrintBatchSplit *)ctx;
+  BmPrintBatchReader reader;
+  BmPrintPublicationView view;
+  CborError err = bm_print_batch_reader_init(&reader, payload->payload, payload->payload_len);
+  while (err == CborNoError && bm_print_batch_reader_next(&reader, &view)) {
+    split->fname = std::string(view.fname ? view.fname : "", view.fname_len);
+    split->prints.emplace_back(view.data ? view.data : "", view.data_len);
+  }
+  return err;
+}
+
+BM_PUB_SUB_DISPATCH_TABLE(print_batch_dispatch,
+                          {BM_PRINT_BATCH_PUB_SUB_TYPE, BM_PRINT_BATCH_PUB_SUB_VERSION,
+                           sizeof(bm_print_batch_publication_t), false, print_batch_handler});
+
+// routes a publication from the batch topic and splits it
+static std::vector<std::string> split_print_batch(const std::vector<uint8_t> &pub,
+                                                  std::string *fname) {
+  PrintBatchSplit split;
+  EXPECT_EQ(bm_pub_sub_dispatch(&print_batch_dispatch, pub.data(), pub.size(), &split),
+            CborNoError);
+  *fname = split.fname;
+  return split.prints;
+}
+
+TEST_F(BmCommonTest, PrintBatchCoalesceAndSplit) {
+  uint8_t buffer[64];
+  PrintBatchSink sink;
+  BmPrintBatcher batcher;
+  bm_print_batcher_init(&batcher, buffer, sizeof(buffer), 1000, print_batch_flush, &sink);
+  std::string fname;
+
+  // prints to one file share a publication
+  ASSERT_EQ(bm_print_batcher_add(&batcher, 0, 7, "a.log", 5, "one\n", 4, 1), CborNoError);
+  ASSERT_EQ(bm_print_batcher_add(&batcher, 10, 7, "a.log", 5, "two\n", 4, 1), CborNoError);
+  ASSERT_EQ(bm_print_batcher_add(&batcher, 20, 7, "a.log", 5, "", 0, 0), CborNoError);
+  EXPECT_TRUE(sink.batches.empty());
+
+  // another file flushes the open batch
+  ASSERT_EQ(bm_print_batcher_add(&batcher, 30, 7, "b.log", 5, "three\n", 6, 1), CborNoError);
+  ASSERT_EQ(sink.batches.size(), 1u);
+  const bm_common_pub_sub_header_t *pub_sub =
+      (const bm_common_pub_sub_header_t *)sink.batches[0].data();
+  EXPECT_EQ(pub_sub->type, BM_PRINT_BATCH_PUB_SUB_TYPE);
+  EXPECT_EQ(pub_sub->version, BM_PRINT_BATCH_PUB_SUB_VERSION);
+  const bm_print_batch_publication_t *header =
+      (const bm_print_batch_publication_t *)pub_sub->payload;
+  EXPECT_EQ(header->target_node_id, 7u);
+  EXPECT_EQ(header->num_records, 3u);
+  EXPECT_EQ(split_print_batch(sink.batches[0], &fname),
+            std::vector<std::string>({"one\n", "two\n", ""}));
+  EXPECT_EQ(fname, "a.log");
+
+  // age
+  EXPECT_EQ(bm_print_batcher_poll(&batcher, 1029), CborNoError);
+  EXPECT_EQ(sink.batches.size(), 1u);
+  EXPECT_EQ(bm_print_batcher_poll(&batcher, 1030), CborNoError);
+  ASSERT_EQ(sink.batches.size(), 2u);
+  EXPECT_EQ(split_print_batch(sink.batches[1], &fname), std::vector<std::string>({"three\n"}));
+
+  // size: each stdout record takes 3 + 10 bytes after 2 + 12 bytes of
+  // headers, so three fit and the fourth opens a new batch
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(bm_print_batcher_add(&batcher, 2000, 9, NULL, 0, "0123456789", 10, 0),
+              CborNoError);
+  }
+  ASSERT_EQ(sink.batches.size(), 3u);
+  EXPECT_EQ(split_print_batch(sink.batches[2], &fname).size(), 3u);
+  EXPECT_EQ(fname, "");
+  ASSERT_EQ(bm_print_batcher_flush(&batcher), CborNoError);
+  ASSERT_EQ(sink.batches.size(), 4u);
+  EXPECT_EQ(split_print_batch(sink.batches[3], &fname).size(), 2u);
+  EXPECT_EQ(bm_print_batcher_flush(&batcher), CborNoError);
+  EXPECT_EQ(sink.batches.size(), 4u);
+
+  // too large for any batch
+  char big[64] = {};
+  EXPECT_EQ(bm_print_batcher_add(&batcher, 3000, 9, NULL, 0, big, sizeof(big), 0),
+            CborErrorDataTooLarge);
+
+  // a failed flush keeps the batch
+  ASSERT_EQ(bm_print_batcher_add(&batcher, 3000, 9, NULL, 0, "x", 1, 0), CborNoError);
+  sink.err = CborErrorIO;
+  EXPECT_EQ(bm_print_batcher_add(&batcher, 3000, 8, NULL, 0, "y", 1, 0), CborErrorIO);
+  sink.err = CborNoError;
+  ASSERT_EQ(bm_print_batcher_flush(&batcher), CborNoError);
+  EXPECT_EQ(split_print_batch(sink.batches.back(), &fname), std::vector<std::string>({"x"}));
+
+  // truncated and padded batches are rejected
+  PrintBatchSplit split;
+  std::vector<uint8_t> bad = sink.batches[0];
+  EXPECT_EQ(bm_pub_sub_dispatch(&print_batch_dispatch, bad.data(), bad.size() - 1, &split),
+            CborErrorUnexpectedEOF);
+  EXPECT_EQ(bm_pub_sub_dispatch(&print_batch_dispatch, bad.data(), 8, &split),
+            CborErrorUnexpectedEOF);
+  bad.push_back(0);
+  EXPECT_EQ(bm_pub_sub_dispatch(&print_batch_dispatch, bad.data(), bad.size(), &split),
+            CborErrorGarbageAtEnd);
+
+  // another type or version is not read as a batch
+  bad = sink.batches[0];
+  ((bm_common_pub_sub_header_t *)bad.data())->version = BM_PRINT_BATCH_PUB_SUB_VERSION + 1;
+  EXPECT_EQ(bm_pub_sub_dispatch(&print_batch_dispatch, bad.data(), bad.size(), &split),
+            CborErrorUnsupportedType);
+  EXPECT_TRUE(split.prints.empty());
+}
+
+static uint64_t bench_now_ns(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+TEST_F(BmCommonTest, DeviceTestSvcLoopbackBench) {
+  const uint32_t max_len = DeviceTestSvcBench::SWEEP_SIZES[DeviceTestSvcBench::NUM_SWEEP_SIZES - 1];
+  std::vector<uint8_t> request_frame(max_len + DeviceTestSvcBench::FRAME_OVERHEAD);
+  std::vector<uint8_t> reply_frame(request_frame.size());
+  std::vector<uint8_t> payload(max_len);
+  std::vector<uint64_t> latencies(20);
+
+  DeviceTestSvcBench::Config c = {};
+  c.request_frame = request_frame.data();
+  c.reply_frame = reply_frame.data();
+  c.frame_size = request_frame.size();
+  c.payload = payload.data();
+  c.payload_size = payload.size();
+  c.latencies_ns = latencies.data();
+  c.iterations = latencies.size();
+  c.now_ns = bench_now_ns;
+
+  DeviceTestSvcBench::Result results[DeviceTestSvcBench::NUM_SWEEP_SIZES];
+  ASSERT_EQ(DeviceTestSvcBench::sweep(c, DeviceTestSvcBench::SWEEP_SIZES,
+                                      DeviceTestSvcBench::NUM_SWEEP_SIZES, results),
+            CborNoError);
+  for (const DeviceTestSvcBench::Result &r : results) {
+    EXPECT_EQ(r.iterations, c.iterations);
+    EXPECT_LE(r.p50_ns, r.p99_ns);
+    EXPECT_GT(r.bytes_per_s, 0);
+    EXPECT_EQ(r.allocations, 2u); // request and reply payload copies
+  }
+
+  c.zero_copy = true;
+  ASSERT_EQ(DeviceTestSvcBench::sweep(c, DeviceTestSvcBench::SWEEP_SIZES,
+                                      DeviceTestSvcBench::NUM_SWEEP_SIZES, results),
+            CborNoError);
+  for (const DeviceTestSvcBench::Result &r : results) {
+    EXPECT_EQ(r.iterations, c.iterations);
+    EXPECT_LE(r.p50_ns, r.p99_ns);
+    EXPECT_EQ(r.allocations, 0u);
+  }
+
+  // the largest frame cannot carry more
+  DeviceTestSvcBench::Result r;
+  EXPECT_EQ(DeviceTestSvcBench::run(c, max_len + 1, r), CborErrorOutOfMemory);
+}
+
+TEST_F(BmCommonTest, DeviceTestSvcDecodeView) {
+  uint8_t payload[300];
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)i;
+  }
+  uint8_t cbor_buffer[400];
+  size_t len = 0;
+
+  DeviceTestSvcRequestMsg::Data request = {sizeof(payload), payload};
+  ASSERT_EQ(DeviceTestSvcRequestMsg::encode(request, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  DeviceTestSvcRequestMsg::Data request_view;
+  ASSERT_EQ(DeviceTestSvcRequestMsg::decode_view(request_view, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(request_view.data_len, sizeof(payload));
+  EXPECT_GT(request_view.data, cbor_buffer);
+  EXPECT_EQ(request_view.data + sizeof(payload), cbor_buffer + len);
+  EXPECT_EQ(memcmp(request_view.data, payload, sizeof(payload)), 0);
+
+  DeviceTestSvcReplyMsg::Data reply = {true, 4, payload};
+  ASSERT_EQ(DeviceTestSvcReplyMsg::encode(reply, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  DeviceTestSvcReplyMsg::Data reply_view;
+  ASSERT_EQ(DeviceTestSvcReplyMsg::decode_view(reply_view, cbor_buffer, len), CborNoError);
+  EXPECT_TRUE(reply_view.success);
+  EXPECT_EQ(reply_view.data_len, 4u);
+  EXPECT_EQ(reply_view.data, cbor_buffer + len - 4);
+  EXPECT_EQ(memcmp(reply_view.data, payload, 4), 0);
+
+  // a data_len that disagrees with the string is rejected
+  request.data_len = 0;
+  ASSERT_EQ(DeviceTestSvcRequestMsg::encode(request, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(DeviceTestSvcRequestMsg::decode_view(request_view, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(request_view.data, nullptr);
+  request.data_len = 2;
+  ASSERT_EQ(DeviceTestSvcRequestMsg::encode(request, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(cbor_buffer[10], 0x02);
+  cbor_buffer[10] = 0x01; // data_len 2 -> 1
+  EXPECT_EQ(DeviceTestSvcRequestMsg::decode_view(request_view, cbor_buffer, len),
+            CborErrorIllegalType);
+}
@@ -0,0 +1,190 @@
+#include "aanderaa_conductivity_msg.h"
+#include "columnar_archive.h"
+#include "pme_dissolved_oxygen_msg.h"
+#include "gtest/gtest.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+using namespace ColumnarArchive;
+
+// The fixture for testing class
+class ColumnarArchiveTest : public ::testing::Test {
+protected:
+  std::string path;
+  ColumnarArchiveTest() {}
+  ~ColumnarArchiveTest() override {}
+  void SetUp() override {
+    path = testing::TempDir() + "columnar_archive_ut.bmcol";
+    remove(path.c_str());
+  }
+
+  void TearDown() override { remove(path.c_str()); }
+
+  static AanderaaConductivityMsg::Data conductivity_row(uint32_t i) {
+    AanderaaConductivityMsg::Data d = {};
+    d.header.version = AanderaaConductivityMsg::VERSION;
+    d.header.reading_time_utc_ms = 1700000000000ULL + i * 1000ULL;
+    d.header.reading_uptime_millis = 5000 + i;
+    d.header.sensor_reading_time_ms = 0xdeadc0de;
+    d.conductivity_ms_cm = 40.0 + i * 0.001;
+    d.temperature_deg_c = 10.0 + (i % 100) * 0.1;
+    d.salinity_psu = 35.0;
+    d.water_density_kg_m3 = 1025.0;
+    d.sound_speed_m_s = 1500.0;
+    d.depth_m = static_cast<float>(i % 10);
+    return d;
+  }
+};
+
+TEST_F(ColumnarArchiveTest, AppendReopenAndScan) {
+  Writer w;
+  ASSERT_EQ(writer_open(w, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA, 1000), OK);
+  for (uint32_t i = 0; i < 2500; i++) {
+    AanderaaConductivityMsg::Data d = conductivity_row(i);
+    ASSERT_EQ(writer_append(w, &d), OK);
+  }
+  ASSERT_EQ(writer_close(w), OK);
+
+  // appending again continues the partially filled last block
+  ASSERT_EQ(writer_open(w, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA), OK);
+  for (uint32_t i = 2500; i < 2510; i++) {
+    AanderaaConductivityMsg::Data d = conductivity_row(i);
+    ASSERT_EQ(writer_append(w, &d), OK);
+  }
+  ASSERT_EQ(writer_close(w), OK);
+
+  Reader r;
+  ASSERT_EQ(reader_open(r, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA), OK);
+  EXPECT_EQ(r.num_blocks, 3u);
+  EXPECT_EQ(reader_num_rows(r), 2510u);
+  EXPECT_EQ(reader_block(r, 2)->num_rows, 510u);
+  EXPECT_EQ(reader_block(r, 3), nullptr);
+
+  const int time_col = reader_find_column(r, "reading_time_utc_ms");
+  const int cond_col = reader_find_column(r, "conductivity_ms_cm");
+  const int depth_col = reader_find_column(r, "depth_m");
+  ASSERT_GE(time_col, 0);
+  ASSERT_GE(cond_col, 0);
+  ASSERT_GE(depth_col, 0);
+  EXPECT_EQ(reader_find_column(r, "not_a_column"), -1);
+
+  uint64_t row = 0;
+  for (uint64_t b = 0; b < r.num_blocks; b++) {
+    const uint32_t n = reader_block(r, b)->num_rows;
+    const uint64_t *times = reader_column<uint64_t>(r, b, time_col);
+    const double *cond = reader_column<double>(r, b, cond_col);
+    const float *depth = reader_column<float>(r, b, depth_col);
+    for (uint32_t i = 0; i < n; i++, row++) {
+      AanderaaConductivityMsg::Data expected = conductivity_row(row);
+      ASSERT_EQ(times[i], expected.header.reading_time_utc_ms);
+      ASSERT_DOUBLE_EQ(cond[i], expected.conductivity_ms_cm);
+      ASSERT_FLOAT_EQ(depth[i], expected.depth_m);
+    }
+  }
+
+  // block min/max indexes
+  EXPECT_DOUBLE_EQ(reader_block(r, 0)->ranges[cond_col].min, 40.0);
+  EXPECT_DOUBLE_EQ(reader_block(r, 0)->ranges[cond_col].max, 40.0 + 999 * 0.001);
+  const double t = 1700000000000.0 + 2200 * 1000.0;
+  EXPECT_FALSE(reader_block_may_contain(r, 0, time_col, t, t));
+  EXPECT_FALSE(reader_block_may_contain(r, 1, time_col, t, t));
+  EXPECT_TRUE(reader_block_may_contain(r, 2, time_col, t, t));
+
+  reader_close(r);
+}
+
+TEST_F(ColumnarArchiveTest, SchemaMismatch) {
+  Writer w;
+  ASSERT_EQ(writer_open(w, path.c_str(), PME_DISSOLVED_OXYGEN_SCHEMA), OK);
+  PmeDissolvedOxygenMsg::Data d = {};
+  d.do_mg_per_l = 8.5;
+  ASSERT_EQ(writer_append(w, &d), OK);
+  ASSERT_EQ(writer_close(w), OK);
+
+  EXPECT_EQ(writer_open(w, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA), ERR_SCHEMA_MISMATCH);
+
+  Reader r;
+  EXPECT_EQ(reader_open(r, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA), ERR_SCHEMA_MISMATCH);
+  ASSERT_EQ(reader_open(r, path.c_str()), OK);
+  EXPECT_STREQ(r.header->message_type, "pme_dissolved_oxygen");
+  EXPECT_EQ(reader_num_rows(r), 1u);
+  const int col = reader_find_column(r, "do_mg_per_l");
+  ASSERT_GE(col, 0);
+  EXPECT_DOUBLE_EQ(reader_column<double>(r, 0, col)[0], 8.5);
+  reader_close(r);
+}
+
+TEST_F(ColumnarArchiveTest, RejectsGarbage) {
+  FILE *f = fopen(path.c_str(), "wb");
+  ASSERT_NE(f, nullptr);
+  char junk[2048] = "definitely not an archive";
+  fwrite(junk, 1, sizeof(junk), f);
+  fclose(f);
+
+  Reader r;
+  EXPECT_EQ(reader_open(r, path.c_str()), ERR_FORMAT);
+  Writer w;
+  EXPECT_EQ(writer_open(w, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA), ERR_FORMAT);
+}
+
+TEST_F(ColumnarArchiveTest, RejectsCorruptedHeader) {
+  Writer w;
+  ASSERT_EQ(writer_open(w, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA, 16), OK);
+  for (uint32_t i = 0; i < 3; i++) {
+    AanderaaConductivityMsg::Data d = conductivity_row(i);
+    ASSERT_EQ(writer_append(w, &d), OK);
+  }
+  ASSERT_EQ(writer_close(w), OK);
+
+  FileHeader good;
+  FILE *f = fopen(path.c_str(), "rb");
+  ASSERT_NE(f, nullptr);
+  ASSERT_EQ(fread(&good, sizeof(good), 1, f), 1u);
+  fclose(f);
+
+  auto rewrite = [&](const FileHeader &h) {
+    FILE *out = fopen(path.c_str(), "r+b");
+    ASSERT_NE(out, nullptr);
+    fwrite(&h, sizeof(h), 1, out);
+    fclose(out);
+  };
+  auto rejected = [&]() {
+    Reader r;
+    Writer wr;
+    return reader_open(r, path.c_str()) == ERR_FORMAT &&
+           writer_open(wr, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA) == ERR_FORMAT;
+  };
+
+  FileHeader h = good;
+  h.header_size = 1ULL << 40; // past the end of the file
+  rewrite(h);
+  EXPECT_TRUE(rejected());
+
+  h = good;
+  h.columns[0].offset = 0; // on top of the block header
+  rewrite(h);
+  EXPECT_TRUE(rejected());
+
+  h = good;
+  h.columns[1].offset = UINT64_MAX - 8; // offset + column length wraps
+  rewrite(h);
+  EXPECT_TRUE(rejected());
+
+  rewrite(good);
+  auto set_num_rows = [&](uint32_t num_rows) {
+    FILE *out = fopen(path.c_str(), "r+b");
+    ASSERT_NE(out, nullptr);
+    fseek(out, static_cast<long>(good.header_size + offsetof(BlockHeader, num_rows)), SEEK_SET);
+    fwrite(&num_rows, sizeof(num_rows), 1, out);
+    fclose(out);
+  };
+  set_num_rows(good.rows_per_block + 1); // more rows than the columns hold
+  EXPECT_TRUE(rejected());
+
+  set_num_rows(3);
+  Reader r;
+  ASSERT_EQ(reader_open(r, path.c_str(), AANDERAA_CONDUCTIVITY_SCHEMA), OK);
+  EXPECT_EQ(reader_num_rows(r), 3u);
+  reader_close(r);
+}
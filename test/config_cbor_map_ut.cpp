@@ -0,0 +1,377 @@
+#include "config_cbor_map_cache.h"
+#include "config_cbor_map_index.h"
+#include "config_cbor_map_transfer.h"
+#include "gtest/gtest.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+// The fixture for testing class
+class ConfigCborMapTest : public ::testing::Test {
+protected:
+  uint8_t map[1000];
+  uint8_t cbor_buffer[256];
+  ConfigCborMapTest() {}
+  ~ConfigCborMapTest() override {}
+  void SetUp() override {
+    for (size_t i = 0; i < sizeof(map); i++) {
+      map[i] = (uint8_t)(i * 13 + 1);
+    }
+  }
+  void TearDown() override {}
+
+  // serve a request the way a node would, through the wire encoding
+  CborError serve(const ConfigCborMapRequestData &request, ConfigCborMapReplyData &reply) {
+    size_t len = 0;
+    CborError err = config_cbor_map_request_encode_paged(
+        (ConfigCborMapRequestData *)&request, cbor_buffer, sizeof(cbor_buffer), &len);
+    if (err != CborNoError) {
+      return err;
+    }
+    ConfigCborMapRequestData received = {};
+    if ((err = config_cbor_map_request_decode(&received, cbor_buffer, len)) != CborNoError) {
+      return err;
+    }
+
+    ConfigCborMapReplyData send = {};
+    send.node_id = 0x1234;
+    send.success = true;
+    EXPECT_TRUE(config_cbor_map_reply_fill_chunk(&send, &received, map, sizeof(map), 100));
+    if ((err = config_cbor_map_reply_encode_chunk(&send, cbor_buffer, sizeof(cbor_buffer),
+                                                  &len)) != CborNoError) {
+      return err;
+    }
+    return config_cbor_map_reply_decode(&reply, cbor_buffer, len);
+  }
+};
+
+TEST_F(ConfigCborMapTest, RequestPaging) {
+  ConfigCborMapRequestData request = {7, 0, 0};
+  size_t len = 0;
+  ASSERT_EQ(config_cbor_map_request_encode(&request, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  const size_t unpaged_len = len;
+
+  ConfigCborMapRequestData decode = {0, 99, 99};
+  ASSERT_EQ(config_cbor_map_request_decode(&decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.partition_id, 7u);
+  EXPECT_EQ(decode.offset, 0u);
+  EXPECT_EQ(decode.length, 0u);
+
+  // stray paging fields do not page the plain encoding
+  request.offset = 300;
+  request.length = 100;
+  ASSERT_EQ(config_cbor_map_request_encode(&request, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_EQ(len, unpaged_len);
+  ASSERT_EQ(config_cbor_map_request_decode(&decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.offset, 0u);
+  EXPECT_EQ(decode.length, 0u);
+
+  ASSERT_EQ(
+      config_cbor_map_request_encode_paged(&request, cbor_buffer, sizeof(cbor_buffer), &len),
+      CborNoError);
+  EXPECT_GT(len, unpaged_len);
+  ASSERT_EQ(config_cbor_map_request_decode(&decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.partition_id, 7u);
+  EXPECT_EQ(decode.offset, 300u);
+  EXPECT_EQ(decode.length, 100u);
+}
+
+TEST_F(ConfigCborMapTest, WholeMapReplyUnchanged) {
+  ConfigCborMapReplyData reply = {};
+  reply.node_id = 0xdeadbeef;
+  reply.partition_id = 1;
+  reply.success = true;
+  reply.cbor_encoded_map_len = 50;
+  reply.cbor_data = map;
+  // garbage paging fields, as left by a caller that does not zero the struct
+  reply.offset = 0x7fff;
+  reply.chunk_len = 0xffffff;
+
+  size_t len = 0;
+  ASSERT_EQ(config_cbor_map_reply_encode(&reply, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+
+  ConfigCborMapReplyData decode = {};
+  ASSERT_EQ(config_cbor_map_reply_decode(&decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.node_id, 0xdeadbeefu);
+  EXPECT_EQ(decode.cbor_encoded_map_len, 50u);
+  EXPECT_EQ(decode.offset, 0u);
+  EXPECT_EQ(decode.chunk_len, 50u);
+  ASSERT_NE(decode.cbor_data, nullptr);
+  EXPECT_EQ(memcmp(decode.cbor_data, map, 50), 0);
+  free(decode.cbor_data);
+}
+
+TEST_F(ConfigCborMapTest, ChunkedTransferWithLoss) {
+  // the map is larger than any single message buffer
+  ASSERT_GT(sizeof(map), sizeof(cbor_buffer));
+
+  uint8_t assembled[1024];
+  ConfigCborMapAssembler assembler;
+  config_cbor_map_assembler_init(&assembler, 3, 100, assembled, sizeof(assembled));
+  EXPECT_FALSE(config_cbor_map_assembler_done(&assembler));
+
+  ConfigCborMapRequestData request;
+  int requests = 0;
+  while (config_cbor_map_assembler_next_request(&assembler, &request)) {
+    ASSERT_LT(++requests, 20);
+    ConfigCborMapReplyData reply = {};
+    ASSERT_EQ(serve(request, reply), CborNoError);
+    EXPECT_LE(reply.chunk_len, 100u);
+    // every third reply is lost and has to be asked for again
+    if (requests % 3 != 2) {
+      ASSERT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborNoError);
+      // a duplicate does no harm
+      ASSERT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborNoError);
+    }
+    free(reply.cbor_data);
+  }
+  EXPECT_TRUE(config_cbor_map_assembler_done(&assembler));
+  EXPECT_EQ(assembler.total_len, sizeof(map));
+  EXPECT_EQ(requests, 15);
+  EXPECT_EQ(memcmp(assembled, map, sizeof(map)), 0);
+}
+
+TEST_F(ConfigCborMapTest, AssemblerRejectsMismatches) {
+  uint8_t assembled[500];
+  ConfigCborMapAssembler assembler;
+  config_cbor_map_assembler_init(&assembler, 3, 100, assembled, sizeof(assembled));
+
+  ConfigCborMapRequestData request = {3, 0, 100};
+  ConfigCborMapReplyData reply = {};
+  reply.success = true;
+  ASSERT_TRUE(config_cbor_map_reply_fill_chunk(&reply, &request, map, sizeof(map), 100));
+  EXPECT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborErrorOutOfMemory);
+
+  config_cbor_map_assembler_init(&assembler, 3, 100, assembled, sizeof(assembled));
+  ASSERT_TRUE(config_cbor_map_reply_fill_chunk(&reply, &request, map, 450, 100));
+  ASSERT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborNoError);
+
+  // wrong partition, misaligned chunk, map changed in between
+  reply.partition_id = 4;
+  EXPECT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborErrorImproperValue);
+  request.offset = 150;
+  ASSERT_TRUE(config_cbor_map_reply_fill_chunk(&reply, &request, map, 450, 100));
+  EXPECT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborErrorImproperValue);
+  request.offset = 100;
+  ASSERT_TRUE(config_cbor_map_reply_fill_chunk(&reply, &request, map, 460, 100));
+  EXPECT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborErrorImproperValue);
+
+  request.offset = 451;
+  EXPECT_FALSE(config_cbor_map_reply_fill_chunk(&reply, &request, map, 450, 100));
+
+  // the short last chunk completes the map
+  for (uint32_t offset = 100; offset < 450; offset += 100) {
+    request.offset = offset;
+    ASSERT_TRUE(config_cbor_map_reply_fill_chunk(&reply, &request, map, 450, 100));
+    ASSERT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborNoError);
+  }
+  EXPECT_EQ(reply.chunk_len, 50u);
+  EXPECT_TRUE(config_cbor_map_assembler_done(&assembler));
+}
+
+TEST_F(ConfigCborMapTest, AssemblerRejectsWrappingChunk) {
+  uint8_t assembled[1000];
+  ConfigCborMapAssembler assembler;
+  config_cbor_map_assembler_init(&assembler, 3, 64, assembled, sizeof(assembled));
+
+  // offset + chunk_len wraps to 0x40, inside the map
+  ConfigCborMapReplyData reply = {};
+  reply.partition_id = 3;
+  reply.success = true;
+  reply.cbor_encoded_map_len = 1000;
+  reply.offset = 0xffffffc0;
+  reply.chunk_len = 0x80;
+  reply.cbor_data = map;
+  EXPECT_EQ(config_cbor_map_assembler_add(&assembler, &reply), CborErrorImproperValue);
+  EXPECT_FALSE(config_cbor_map_assembler_done(&assembler));
+
+  // the decoder refuses such a chunk before it gets that far
+  reply.offset = 960;
+  reply.chunk_len = 64;
+  size_t len = 0;
+  ASSERT_EQ(config_cbor_map_reply_encode_chunk(&reply, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ConfigCborMapReplyData decode = {};
+  EXPECT_EQ(config_cbor_map_reply_decode(&decode, cbor_buffer, len), CborErrorImproperValue);
+  EXPECT_EQ(decode.cbor_data, nullptr);
+}
+
+TEST_F(ConfigCborMapTest, CacheByCrc) {
+  // a config map as a node would send it
+  const std::string long_key(300, 'k');
+  uint8_t config[1024];
+  CborEncoder encoder, map_encoder;
+  cbor_encoder_init(&encoder, config, sizeof(config), 0);
+  ASSERT_EQ(cbor_encoder_create_map(&encoder, &map_encoder, 4), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "sampleIntervalMs"), CborNoError);
+  ASSERT_EQ(cbor_encode_uint(&map_encoder, 60000), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "a_key_longer_than_23_chars"), CborNoError);
+  ASSERT_EQ(cbor_encode_float(&map_encoder, 1.5f), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, long_key.c_str()), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "long"), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "sample"), CborNoError);
+  ASSERT_EQ(cbor_encode_int(&map_encoder, -3), CborNoError);
+  ASSERT_EQ(cbor_encoder_close_container(&encoder, &map_encoder), CborNoError);
+  const uint32_t config_len = (uint32_t)cbor_encoder_get_buffer_size(&encoder, config);
+
+  ConfigCborMapCacheEntry entries[4];
+  ConfigCborMapCache cache;
+  ASSERT_TRUE(config_cbor_map_cache_init(&cache, entries, 4));
+
+  ConfigCborMapRequestData request;
+  ASSERT_TRUE(config_cbor_map_cache_request(&cache, 0xabc, 1, 0x1111, &request));
+  EXPECT_EQ(request.partition_id, 1u);
+  ASSERT_EQ(config_cbor_map_cache_store(&cache, 0xabc, 1, 0x1111, config, config_len),
+            CborNoError);
+  // the reply buffer can go away
+  memset(config, 0, sizeof(config));
+
+  // same crc after a reboot, nothing to fetch
+  EXPECT_FALSE(config_cbor_map_cache_request(&cache, 0xabc, 1, 0x1111, &request));
+  EXPECT_TRUE(config_cbor_map_cache_request(&cache, 0xabc, 1, 0x2222, &request));
+  EXPECT_TRUE(config_cbor_map_cache_request(&cache, 0xabc, 0, 0x1111, &request));
+  EXPECT_TRUE(config_cbor_map_cache_request(&cache, 0xabd, 1, 0x1111, &request));
+
+  const ConfigCborMapCacheEntry *e = config_cbor_map_cache_find(&cache, 0xabc, 1);
+  ASSERT_NE(e, nullptr);
+  EXPECT_EQ(e->index.num_keys, 4u);
+
+  uint64_t u = 0;
+  ASSERT_EQ(config_cbor_map_index_get_uint(&e->index, "sampleIntervalMs", &u), CborNoError);
+  EXPECT_EQ(u, 60000u);
+  float f = 0;
+  ASSERT_EQ(config_cbor_map_index_get_float(&e->index, "a_key_longer_than_23_chars", &f),
+            CborNoError);
+  EXPECT_FLOAT_EQ(f, 1.5f);
+  const char *str = nullptr;
+  size_t str_len = 0;
+  ASSERT_EQ(config_cbor_map_index_get_string(&e->index, long_key.c_str(), &str, &str_len),
+            CborNoError);
+  EXPECT_EQ(std::string(str, str_len), "long");
+  int64_t i = 0;
+  ASSERT_EQ(config_cbor_map_index_get_int(&e->index, "sample", &i), CborNoError);
+  EXPECT_EQ(i, -3);
+  EXPECT_EQ(config_cbor_map_index_get_uint(&e->index, "sampleInterval", &u),
+            CborErrorImproperValue);
+
+  // a new crc replaces the map in place
+  uint8_t empty[] = {0xa0};
+  ASSERT_EQ(config_cbor_map_cache_store(&cache, 0xabc, 1, 0x2222, empty, sizeof(empty)),
+            CborNoError);
+  EXPECT_EQ(cache.count, 1u);
+  e = config_cbor_map_cache_find(&cache, 0xabc, 1);
+  EXPECT_EQ(e->crc, 0x2222u);
+  EXPECT_EQ(config_cbor_map_index_get_int(&e->index, "sample", &i), CborErrorImproperValue);
+
+  // bounded: one slot always stays free
+  ASSERT_EQ(config_cbor_map_cache_store(&cache, 0xabc, 2, 0, empty, sizeof(empty)), CborNoError);
+  ASSERT_EQ(config_cbor_map_cache_store(&cache, 0xabd, 1, 0, empty, sizeof(empty)), CborNoError);
+  EXPECT_EQ(config_cbor_map_cache_store(&cache, 0xabe, 1, 0, empty, sizeof(empty)),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(config_cbor_map_cache_find(&cache, 0xabe, 1), nullptr);
+  ASSERT_NE(config_cbor_map_cache_find(&cache, 0xabd, 1), nullptr);
+
+  uint8_t not_a_map[] = {0x01};
+  EXPECT_EQ(config_cbor_map_cache_store(&cache, 0xabc, 2, 0, not_a_map, sizeof(not_a_map)),
+            CborErrorIllegalType);
+
+  config_cbor_map_cache_deinit(&cache);
+  EXPECT_EQ(config_cbor_map_cache_find(&cache, 0xabc, 1), nullptr);
+
+  // the probe masks with capacity - 1, so only powers of two are accepted
+  EXPECT_FALSE(config_cbor_map_cache_init(&cache, entries, 0));
+  EXPECT_FALSE(config_cbor_map_cache_init(&cache, entries, 3));
+  EXPECT_EQ(config_cbor_map_cache_store(&cache, 0xabc, 1, 0, empty, sizeof(empty)),
+            CborErrorOutOfMemory);
+  EXPECT_EQ(config_cbor_map_cache_find(&cache, 0xabc, 1), nullptr);
+  EXPECT_TRUE(config_cbor_map_cache_request(&cache, 0xabc, 1, 0, &request));
+  config_cbor_map_cache_deinit(&cache);
+}
+
+TEST_F(ConfigCborMapTest, IndexTypedGetters) {
+  uint8_t config[512];
+  const uint8_t blob[] = {0xde, 0xad, 0xbe, 0xef};
+  CborEncoder encoder, map_encoder;
+  cbor_encoder_init(&encoder, config, sizeof(config), 0);
+  ASSERT_EQ(cbor_encoder_create_map(&encoder, &map_encoder, 40), CborNoError);
+  for (int k = 0; k < 34; k++) {
+    char key[16];
+    snprintf(key, sizeof(key), "key%d", k);
+    ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, key), CborNoError);
+    ASSERT_EQ(cbor_encode_uint(&map_encoder, k * 1000), CborNoError);
+  }
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "negative"), CborNoError);
+  ASSERT_EQ(cbor_encode_int(&map_encoder, -70000), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "huge"), CborNoError);
+  ASSERT_EQ(cbor_encode_uint(&map_encoder, UINT64_MAX), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "gain"), CborNoError);
+  ASSERT_EQ(cbor_encode_double(&map_encoder, 0.25), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "name"), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "hydrophone"), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, "calibration"), CborNoError);
+  ASSERT_EQ(cbor_encode_byte_string(&map_encoder, blob, sizeof(blob)), CborNoError);
+  ASSERT_EQ(cbor_encode_text_stringz(&map_encoder, ""), CborNoError);
+  ASSERT_EQ(cbor_encode_uint(&map_encoder, 7), CborNoError);
+  ASSERT_EQ(cbor_encoder_close_container(&encoder, &map_encoder), CborNoError);
+  const uint32_t len = (uint32_t)cbor_encoder_get_buffer_size(&encoder, config);
+
+  uint32_t slots = 0;
+  ASSERT_EQ(config_cbor_map_index_slots(config, len, &slots), CborNoError);
+  EXPECT_EQ(slots, 128u);
+
+  ConfigCborMapIndexKey keys[128];
+  ConfigCborMapIndex index;
+  EXPECT_EQ(config_cbor_map_index_build(&index, config, len, keys, 64), CborErrorOutOfMemory);
+  ASSERT_EQ(config_cbor_map_index_build(&index, config, len, keys, 128), CborNoError);
+  EXPECT_EQ(index.num_keys, 40u);
+
+  uint64_t u = 0;
+  for (int k = 0; k < 34; k++) {
+    char key[16];
+    snprintf(key, sizeof(key), "key%d", k);
+    ASSERT_EQ(config_cbor_map_index_get_uint(&index, key, &u), CborNoError) << key;
+    EXPECT_EQ(u, (uint64_t)k * 1000);
+  }
+  ASSERT_EQ(config_cbor_map_index_get_uint(&index, "", &u), CborNoError);
+  EXPECT_EQ(u, 7u);
+
+  int64_t i = 0;
+  ASSERT_EQ(config_cbor_map_index_get_int(&index, "negative", &i), CborNoError);
+  EXPECT_EQ(i, -70000);
+  ASSERT_EQ(config_cbor_map_index_get_int(&index, "key3", &i), CborNoError);
+  EXPECT_EQ(i, 3000);
+  EXPECT_EQ(config_cbor_map_index_get_int(&index, "huge", &i), CborErrorDataTooLarge);
+  EXPECT_EQ(config_cbor_map_index_get_uint(&index, "negative", &u), CborErrorIllegalType);
+
+  float f = 0;
+  ASSERT_EQ(config_cbor_map_index_get_float(&index, "gain", &f), CborNoError);
+  EXPECT_FLOAT_EQ(f, 0.25f);
+  EXPECT_EQ(config_cbor_map_index_get_float(&index, "name", &f), CborErrorIllegalType);
+
+  // views point into the map itself
+  const char *name = nullptr;
+  size_t name_len = 0;
+  ASSERT_EQ(config_cbor_map_index_get_string(&index, "name", &name, &name_len), CborNoError);
+  EXPECT_EQ(std::string(name, name_len), "hydrophone");
+  EXPECT_GE((const uint8_t *)name, config);
+  EXPECT_LT((const uint8_t *)name, config + len);
+  const uint8_t *bytes = nullptr;
+  size_t bytes_len = 0;
+  ASSERT_EQ(config_cbor_map_index_get_bytes(&index, "calibration", &bytes, &bytes_len),
+            CborNoError);
+  ASSERT_EQ(bytes_len, sizeof(blob));
+  EXPECT_EQ(memcmp(bytes, blob, sizeof(blob)), 0);
+  EXPECT_EQ(config_cbor_map_index_get_bytes(&index, "name", &bytes, &bytes_len),
+            CborErrorIllegalType);
+  EXPECT_EQ(config_cbor_map_index_get_string(&index, "nam", &name, &name_len),
+            CborErrorImproperValue);
+
+  // keys must be text
+  const uint8_t int_keys[] = {0xa1, 0x01, 0x02};
+  ASSERT_EQ(config_cbor_map_index_slots(int_keys, sizeof(int_keys), &slots), CborNoError);
+  EXPECT_EQ(config_cbor_map_index_build(&index, int_keys, sizeof(int_keys), keys, slots),
+            CborErrorIllegalType);
+}
@@ -32,3 +32,40 @@ TEST_F(PowerInfo, PowerInfoReply) {
   EXPECT_EQ(decode.remaining_on_s, encode.remaining_on_s);
   EXPECT_EQ(decode.upcoming_off_s, encode.upcoming_off_s);
 }
+
+TEST_F(PowerInfo, PowerInfoReplyTemplate) {
+  uint8_t template_buffer[128];
+  BmTemplateEncoder t;
+  EXPECT_EQ(bm_template_encoder_init(&t, power_info_reply_template_fields,
+                                     power_info_reply_msg_num_fields,
+                                     template_buffer, sizeof(template_buffer)),
+            CborNoError);
+
+  PowerInfoReplyData encode;
+  PowerInfoReplyData decode;
+  uint8_t cbor_buffer[128];
+  size_t len = 0;
+
+  // Same length whether values are small or large
+  encode.total_on_s = 0;
+  encode.remaining_on_s = 1;
+  encode.upcoming_off_s = 24;
+  EXPECT_EQ(bm_template_encode(&t, &encode, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_EQ(len, t.len);
+  EXPECT_EQ(power_info_reply_decode(&decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.total_on_s, encode.total_on_s);
+  EXPECT_EQ(decode.remaining_on_s, encode.remaining_on_s);
+  EXPECT_EQ(decode.upcoming_off_s, encode.upcoming_off_s);
+
+  encode.total_on_s = UINT32_MAX;
+  encode.remaining_on_s = 100000;
+  encode.upcoming_off_s = 3333333;
+  EXPECT_EQ(bm_template_encode(&t, &encode, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_EQ(len, t.len);
+  EXPECT_EQ(power_info_reply_decode(&decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.total_on_s, encode.total_on_s);
+  EXPECT_EQ(decode.remaining_on_s, encode.remaining_on_s);
+  EXPECT_EQ(decode.upcoming_off_s, encode.upcoming_off_s);
+}
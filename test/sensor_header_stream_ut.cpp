@@ -0,0 +1,160 @@
+#include "aanderaa_current_meter_msg.h"
+#include "bm_seapoint_turbidity_data_msg.h"
+#include "sensor_header_stream.h"
+#include "gtest/gtest.h"
+
+// The fixture for testing class
+class SensorHeaderStreamTest : public ::testing::Test {
+protected:
+  SensorHeaderStream tx;
+  SensorHeaderStream rx;
+  uint8_t cbor_buffer[512];
+
+  SensorHeaderStreamTest() {}
+  ~SensorHeaderStreamTest() override {}
+  void SetUp() override {
+    ASSERT_EQ(sensor_header_stream_init(&tx, BmSeapointTurbidityDataMsg::TEMPLATE_FIELDS,
+                                        BmSeapointTurbidityDataMsg::NUM_FIELDS, 8),
+              CborNoError);
+    ASSERT_EQ(sensor_header_stream_init(&rx, BmSeapointTurbidityDataMsg::TEMPLATE_FIELDS,
+                                        BmSeapointTurbidityDataMsg::NUM_FIELDS, 8),
+              CborNoError);
+  }
+
+  void TearDown() override {}
+
+  static BmSeapointTurbidityDataMsg::Data frame(uint32_t i) {
+    BmSeapointTurbidityDataMsg::Data d;
+    d.header.version = BmSeapointTurbidityDataMsg::VERSION;
+    d.header.reading_time_utc_ms = 1700000000000ULL + i * 50ULL;
+    d.header.reading_uptime_millis = 123456 + i * 50ULL;
+    // sensor clock is allowed to step backwards
+    d.header.sensor_reading_time_ms = 900000 + i * 50ULL - (i % 3) * 7;
+    d.s_signal = 0.25 * i;
+    d.r_signal = 4000.0 - i;
+    return d;
+  }
+
+  static void expect_equal(const BmSeapointTurbidityDataMsg::Data &a,
+                           const BmSeapointTurbidityDataMsg::Data &b) {
+    EXPECT_EQ(a.header.version, b.header.version);
+    EXPECT_EQ(a.header.reading_time_utc_ms, b.header.reading_time_utc_ms);
+    EXPECT_EQ(a.header.reading_uptime_millis, b.header.reading_uptime_millis);
+    EXPECT_EQ(a.header.sensor_reading_time_ms, b.header.sensor_reading_time_ms);
+    EXPECT_EQ(a.s_signal, b.s_signal);
+    EXPECT_EQ(a.r_signal, b.r_signal);
+  }
+};
+
+TEST_F(SensorHeaderStreamTest, RoundTripWithKeyframes) {
+  size_t plain_len = 0;
+  BmSeapointTurbidityDataMsg::Data first = frame(0);
+  ASSERT_EQ(BmSeapointTurbidityDataMsg::encode(first, cbor_buffer, sizeof(cbor_buffer),
+                                               &plain_len),
+            CborNoError);
+
+  for (uint32_t i = 0; i < 40; i++) {
+    BmSeapointTurbidityDataMsg::Data d = frame(i);
+    size_t len = 0;
+    ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+              CborNoError);
+    if (i % 8 == 0) {
+      // keyframe every 8 frames, still smaller than the four header keys
+      EXPECT_LT(len + 40, plain_len);
+    } else {
+      EXPECT_LT(len + 50, plain_len);
+    }
+
+    BmSeapointTurbidityDataMsg::Data decode;
+    ASSERT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len), CborNoError);
+    expect_equal(decode, d);
+  }
+}
+
+TEST_F(SensorHeaderStreamTest, LostFrameNeedsKeyframe) {
+  BmSeapointTurbidityDataMsg::Data d, decode;
+  size_t len = 0;
+
+  for (uint32_t i = 0; i < 3; i++) {
+    d = frame(i);
+    ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+              CborNoError);
+    ASSERT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len), CborNoError);
+  }
+
+  // frame 3 is lost
+  d = frame(3);
+  ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+
+  // deltas are rejected until the next keyframe (frame 8)
+  for (uint32_t i = 4; i < 8; i++) {
+    d = frame(i);
+    ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+              CborNoError);
+    EXPECT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len),
+              CborErrorImproperValue);
+  }
+  for (uint32_t i = 8; i < 12; i++) {
+    d = frame(i);
+    ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+              CborNoError);
+    ASSERT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len), CborNoError);
+    expect_equal(decode, d);
+  }
+
+  // A decoder joining mid-stream waits for a keyframe as well
+  SensorHeaderStream late;
+  ASSERT_EQ(sensor_header_stream_init(&late, BmSeapointTurbidityDataMsg::TEMPLATE_FIELDS,
+                                      BmSeapointTurbidityDataMsg::NUM_FIELDS, 8),
+            CborNoError);
+  EXPECT_EQ(sensor_header_stream_decode(&late, &decode, cbor_buffer, len),
+            CborErrorImproperValue);
+
+  // The sender can force a keyframe
+  sensor_header_stream_reset(&tx);
+  d = frame(12);
+  ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(sensor_header_stream_decode(&late, &decode, cbor_buffer, len), CborNoError);
+  expect_equal(decode, d);
+}
+
+TEST_F(SensorHeaderStreamTest, VersionChangeAndErrors) {
+  BmSeapointTurbidityDataMsg::Data d = frame(0), decode;
+  size_t len = 0, keyframe_len = 0;
+
+  ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer),
+                                        &keyframe_len),
+            CborNoError);
+  ASSERT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, keyframe_len),
+            CborNoError);
+
+  d = frame(1);
+  d.header.version++;
+  ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_EQ(len, keyframe_len);
+  ASSERT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len), CborNoError);
+  expect_equal(decode, d);
+
+  // A failed encode does not advance the stream
+  d = frame(2);
+  EXPECT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, 10, &len),
+            CborErrorOutOfMemory);
+  ASSERT_EQ(sensor_header_stream_encode(&tx, &d, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.header.reading_time_utc_ms, d.header.reading_time_utc_ms);
+
+  // Plain messages are not stream frames
+  ASSERT_EQ(BmSeapointTurbidityDataMsg::encode(d, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  EXPECT_NE(sensor_header_stream_decode(&rx, &decode, cbor_buffer, len), CborNoError);
+
+  // Tables must start with the sensor header
+  SensorHeaderStream s;
+  EXPECT_EQ(sensor_header_stream_init(&s, &AanderaaCurrentMeterMsg::TEMPLATE_FIELDS[1],
+                                      AanderaaCurrentMeterMsg::NUM_FIELDS - 1, 8),
+            CborErrorImproperValue);
+}
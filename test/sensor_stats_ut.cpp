@@ -0,0 +1,146 @@
+#include "aanderaa_conductivity_msg.h"
+#include "barometric_pressure_data_msg.h"
+#include "bm_seapoint_turbidity_data_msg.h"
+#include "pme_dissolved_oxygen_msg.h"
+#include "sensor_stats_msg.h"
+#include "gtest/gtest.h"
+#include <math.h>
+
+// The fixture for testing class
+class SensorStatsTest : public ::testing::Test {
+protected:
+  uint8_t cbor_buffer[1024];
+  SensorStatsTest() {}
+  ~SensorStatsTest() override {}
+  void SetUp() override {}
+  void TearDown() override {}
+};
+
+TEST_F(SensorStatsTest, ConductivitySummary) {
+  AanderaaConductivityMsg::StatsAccumulator acc;
+  SensorStatsMsg::accumulator_init(acc, AanderaaConductivityMsg::STATS_FIELDS);
+
+  const double conductivity[] = {40.0, 41.0, 42.0, 43.0, 44.0};
+  for (size_t i = 0; i < 5; i++) {
+    AanderaaConductivityMsg::Data d = {};
+    d.header.version = AanderaaConductivityMsg::VERSION;
+    d.header.reading_time_utc_ms = 1000 + i * 500;
+    d.header.reading_uptime_millis = 20 + i;
+    d.conductivity_ms_cm = conductivity[i];
+    d.temperature_deg_c = 12.5;
+    d.depth_m = static_cast<float>(i);
+    SensorStatsMsg::accumulator_add(acc, d);
+  }
+
+  SensorStatsMsg::Data summary;
+  SensorStatsMsg::accumulator_summary(acc, summary);
+  EXPECT_EQ(summary.num_fields, 6u);
+
+  size_t len = 0;
+  ASSERT_EQ(SensorStatsMsg::encode(summary, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+
+  SensorStatsMsg::Data decode;
+  ASSERT_EQ(SensorStatsMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.header.version, SensorStatsMsg::VERSION);
+  EXPECT_EQ(decode.header.reading_time_utc_ms, 3000u);
+  EXPECT_EQ(decode.header.reading_uptime_millis, 24u);
+  EXPECT_EQ(decode.num_samples, 5u);
+  EXPECT_EQ(decode.window_start_utc_ms, 1000u);
+  EXPECT_EQ(decode.num_fields, 6u);
+
+  const SensorStatsMsg::FieldStats *c = SensorStatsMsg::find(decode, "conductivity_ms_cm");
+  ASSERT_NE(c, nullptr);
+  EXPECT_FLOAT_EQ(c->mean, 42.0f);
+  EXPECT_FLOAT_EQ(c->min, 40.0f);
+  EXPECT_FLOAT_EQ(c->max, 44.0f);
+  EXPECT_FLOAT_EQ(c->stdev, static_cast<float>(sqrt(2.5)));
+
+  const SensorStatsMsg::FieldStats *t = SensorStatsMsg::find(decode, "temperature_deg_c");
+  ASSERT_NE(t, nullptr);
+  EXPECT_FLOAT_EQ(t->mean, 12.5f);
+  EXPECT_FLOAT_EQ(t->stdev, 0.0f);
+
+  // float members are summarized too
+  const SensorStatsMsg::FieldStats *depth = SensorStatsMsg::find(decode, "depth_m");
+  ASSERT_NE(depth, nullptr);
+  EXPECT_FLOAT_EQ(depth->max, 4.0f);
+
+  EXPECT_EQ(SensorStatsMsg::find(decode, "not_a_field"), nullptr);
+
+  // A summary is much smaller than the raw readings it replaces
+  AanderaaConductivityMsg::Data raw = {};
+  size_t raw_len = 0;
+  ASSERT_EQ(AanderaaConductivityMsg::encode(raw, cbor_buffer, sizeof(cbor_buffer), &raw_len),
+            CborNoError);
+  EXPECT_LT(len, 2 * raw_len);
+}
+
+TEST_F(SensorStatsTest, ResetAndEmptyWindow) {
+  BarometricPressureDataMsg::StatsAccumulator acc;
+  SensorStatsMsg::accumulator_init(acc, BarometricPressureDataMsg::STATS_FIELDS);
+
+  BarometricPressureDataMsg::Data d = {};
+  d.barometric_pressure_mbar = 1013.25;
+  SensorStatsMsg::accumulator_add(acc, d);
+
+  SensorStatsMsg::Data summary;
+  SensorStatsMsg::accumulator_summary(acc, summary);
+  EXPECT_EQ(summary.num_samples, 1u);
+  EXPECT_FLOAT_EQ(summary.fields[0].mean, 1013.25f);
+  EXPECT_FLOAT_EQ(summary.fields[0].stdev, 0.0f);
+
+  SensorStatsMsg::accumulator_reset(acc);
+  SensorStatsMsg::accumulator_summary(acc, summary);
+  EXPECT_EQ(summary.num_samples, 0u);
+  EXPECT_TRUE(isnan(summary.fields[0].mean));
+
+  size_t len = 0;
+  ASSERT_EQ(SensorStatsMsg::encode(summary, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  SensorStatsMsg::Data decode;
+  ASSERT_EQ(SensorStatsMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_STREQ(decode.fields[0].key, "barometric_pressure_mbar");
+  EXPECT_TRUE(isnan(decode.fields[0].max));
+}
+
+TEST_F(SensorStatsTest, OtherSensors) {
+  PmeDissolvedOxygenMsg::StatsAccumulator oxygen;
+  SensorStatsMsg::accumulator_init(oxygen, PmeDissolvedOxygenMsg::STATS_FIELDS);
+  BmSeapointTurbidityDataMsg::StatsAccumulator turbidity;
+  SensorStatsMsg::accumulator_init(turbidity, BmSeapointTurbidityDataMsg::STATS_FIELDS);
+
+  for (int i = 0; i < 10; i++) {
+    PmeDissolvedOxygenMsg::Data o = {};
+    o.do_mg_per_l = 8.0 + (i % 2);
+    o.salinity_ppt = 35.0f;
+    SensorStatsMsg::accumulator_add(oxygen, o);
+
+    BmSeapointTurbidityDataMsg::Data t = {};
+    t.s_signal = i;
+    t.r_signal = -i;
+    SensorStatsMsg::accumulator_add(turbidity, t);
+  }
+
+  SensorStatsMsg::Data summary, decode;
+  size_t len = 0;
+
+  SensorStatsMsg::accumulator_summary(oxygen, summary);
+  ASSERT_EQ(SensorStatsMsg::encode(summary, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(SensorStatsMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.num_fields, 5u);
+  EXPECT_FLOAT_EQ(SensorStatsMsg::find(decode, "do_mg_per_l")->mean, 8.5f);
+  EXPECT_FLOAT_EQ(SensorStatsMsg::find(decode, "salinity_ppt")->min, 35.0f);
+
+  SensorStatsMsg::accumulator_summary(turbidity, summary);
+  ASSERT_EQ(SensorStatsMsg::encode(summary, cbor_buffer, sizeof(cbor_buffer), &len),
+            CborNoError);
+  ASSERT_EQ(SensorStatsMsg::decode(decode, cbor_buffer, len), CborNoError);
+  EXPECT_EQ(decode.num_fields, 2u);
+  EXPECT_FLOAT_EQ(SensorStatsMsg::find(decode, "s_signal")->max, 9.0f);
+  EXPECT_FLOAT_EQ(SensorStatsMsg::find(decode, "r_signal")->min, -9.0f);
+
+  // truncated buffers are reported, not decoded
+  EXPECT_NE(SensorStatsMsg::decode(decode, cbor_buffer, len - 3), CborNoError);
+}